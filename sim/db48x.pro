@@ -46,6 +46,7 @@ SOURCES +=                                      \
         ../src/command.cc                       \
         ../src/comment.cc                       \
         ../src/compare.cc                       \
+        ../src/compiled.cc                      \
         ../src/complex.cc                       \
         ../src/conditionals.cc                  \
         ../src/constants.cc                     \
@@ -30,6 +30,7 @@
 #include "dmcp.h"
 
 #include "dmcp_fonts.c"
+#include "program.h"
 #include "recorder.h"
 #include "sim-dmcp.h"
 #include "target.h"
@@ -42,6 +43,7 @@
 #include <sys/select.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <thread>
 
 
 #pragma GCC diagnostic ignored "-Wunused-parameter"
@@ -851,6 +853,26 @@ void sys_delay(uint32_t ms_delay)
     ui_ms_sleep(ms_delay);
 }
 
+static struct ticker
+// ----------------------------------------------------------------------------
+//   Periodic tick telling running programs to poll keys, battery and display
+// ----------------------------------------------------------------------------
+{
+    ticker()
+    {
+        std::thread([]()
+        {
+            while (true)
+            {
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(program::TICK_PERIOD));
+                program::tick();
+            }
+        }).detach();
+    }
+} ticker;
+
+
 static struct timer
 {
     uint32_t deadline;
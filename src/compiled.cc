@@ -0,0 +1,388 @@
+// ****************************************************************************
+//  compiled.cc                                                   DB48X project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Expressions compiled to register code
+//
+//
+//
+//
+//
+//
+//
+//
+// ****************************************************************************
+//   (C) 2024 Christophe de Dinechin <christophe@dinechin.org>
+//   This software is licensed under the terms outlined in LICENSE.txt
+// ****************************************************************************
+//   This file is part of DB48X.
+//
+//   DB48X is free software: you can redistribute it and/or modify
+//   it under the terms outlined in the LICENSE.txt file
+//
+//   DB48X is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// ****************************************************************************
+
+#include "compiled.h"
+
+#include "arithmetic.h"
+#include "decimal.h"
+#include "expression.h"
+#include "functions.h"
+#include "hwfp.h"
+#include "integer.h"
+#include "settings.h"
+#include "variables.h"
+
+#include <cmath>
+
+RECORDER(compiled, 16, "Expressions compiled to register code");
+
+
+compiled_expression::compiled_expression(program_r eq)
+// ----------------------------------------------------------------------------
+//   Compile the expression if possible
+// ----------------------------------------------------------------------------
+    : count(0), native(false)
+{
+    native = (Settings.HardwareFloatingPoint() &&
+              Settings.Precision() > 7 && Settings.Precision() <= 16);
+    if (eq && !compile(+eq))
+        count = 0;
+    if (!count)
+        native = false;
+    record(compiled, "Expression %t %+s", +eq,
+           native ? "compiled to hardware floating-point"
+           : count ? "compiled" : "interpreted");
+}
+
+
+static bool constant_value(object_p obj, double &value)
+// ----------------------------------------------------------------------------
+//   Check if an object is a real constant that converts exactly to double
+// ----------------------------------------------------------------------------
+//   This follows what hwfp_promotion does with the same values
+{
+    const ularge exact = 1ULL << 53;
+    switch (obj->type())
+    {
+    case object::ID_integer:
+    case object::ID_neg_integer:
+    {
+        ularge v = integer_p(obj)->value<ularge>();
+        if (v >= exact)
+            return false;
+        value = obj->type() == object::ID_neg_integer ? -double(v) : double(v);
+        return true;
+    }
+    case object::ID_decimal:
+    case object::ID_neg_decimal:
+        value = decimal_p(obj)->to_double();
+        return std::isfinite(value);
+    case object::ID_hwdouble:
+        value = hwdouble_p(obj)->value();
+        return std::isfinite(value);
+    default:
+        return false;
+    }
+}
+
+
+bool compiled_expression::compile(program_p eq)
+// ----------------------------------------------------------------------------
+//   Compile an expression to register code, return false if not possible
+// ----------------------------------------------------------------------------
+//   To get the same results as the RPL evaluator, every operation must
+//   involve the independent variable, since operations between constants
+//   may be computed exactly, e.g. 1/3 as a fraction. Integer leaf values
+//   are remembered to compute X^N the same way as the evaluator does.
+//   Constants that do not convert exactly to double, e.g. fractions, only
+//   prevent running the code on hardware floating-point.
+{
+    expression_p expr = eq->as<expression>();
+    if (!expr || !expression::independent)
+        return false;
+    symbol_p indep = *expression::independent;
+    if (!indep)
+        return false;
+
+    byte  stack[MAX_CODE];      // Registers being computed
+    bool  varies[MAX_CODE];     // Register depends on independent variable
+    bool  isint[MAX_CODE];      // Register is an integer constant
+    uint  depth = 0;
+
+    for (object_p obj : *expr)
+    {
+        if (count >= MAX_CODE)
+            return false;
+
+        instruction &i = code[count];
+        object::id   ty = obj->type();
+        i.a = i.b = 0;
+        i.n = 0;
+        i.k = 0.0;
+
+        switch (ty)
+        {
+        case object::ID_symbol:
+            if (symbol_p(obj)->is_same_as(indep))
+            {
+                i.op = LOAD_X;
+                varies[depth] = true;
+                isint[depth] = false;
+                break;
+            }
+            obj = directory::recall_all(obj, false);
+            if (!obj)
+                return false;
+            ty = obj->type();
+            // Fall-through
+        case object::ID_integer:
+        case object::ID_neg_integer:
+        case object::ID_bignum:
+        case object::ID_neg_bignum:
+        case object::ID_fraction:
+        case object::ID_neg_fraction:
+        case object::ID_big_fraction:
+        case object::ID_neg_big_fraction:
+        case object::ID_decimal:
+        case object::ID_neg_decimal:
+        case object::ID_hwfloat:
+        case object::ID_hwdouble:
+            if (!object::is_real(ty))
+                return false;
+            if (native && !constant_value(obj, i.k))
+                native = false;
+            constants[count] = algebraic_p(obj);
+            i.op = LOAD_K;
+            varies[depth] = false;
+            isint[depth] = (ty == object::ID_integer ||
+                            ty == object::ID_neg_integer);
+            if (isint[depth])
+            {
+                ularge v = integer_p(obj)->value<ularge>();
+                i.n = ty == object::ID_neg_integer ? -large(v) : large(v);
+            }
+            break;
+
+        case object::ID_add:
+        case object::ID_sub:
+        case object::ID_mul:
+        case object::ID_div:
+        case object::ID_pow:
+        {
+            if (depth < 2)
+                return false;
+            uint ya = depth - 2, yb = depth - 1;
+            if (!varies[ya] && !varies[yb])
+                return false;
+            i.a = stack[ya];
+            i.b = stack[yb];
+            switch (ty)
+            {
+            case object::ID_add:        i.op = ADD; break;
+            case object::ID_sub:        i.op = SUB; break;
+            case object::ID_mul:        i.op = MUL; break;
+            case object::ID_div:        i.op = DIV; break;
+            default:
+                i.op = POW;
+                if (isint[yb])
+                {
+                    // X^0 is simplified as integer 1, leave it alone
+                    i.n = code[i.b].n;
+                    if (!i.n)
+                        return false;
+                    i.op = POWI;
+                }
+                break;
+            }
+            depth -= 2;
+            varies[depth] = true;
+            isint[depth] = false;
+            break;
+        }
+
+        case object::ID_neg:
+        case object::ID_inv:
+        case object::ID_sq:
+        case object::ID_abs:
+        case object::ID_sqrt:
+        case object::ID_exp:
+        case object::ID_log:
+        case object::ID_sin:
+        case object::ID_cos:
+        case object::ID_tan:
+            if (depth < 1 || !varies[depth - 1])
+                return false;
+            i.a = stack[depth - 1];
+            switch (ty)
+            {
+            case object::ID_neg:        i.op = NEG;  break;
+            case object::ID_inv:        i.op = INV;  break;
+            case object::ID_sq:         i.op = SQ;   break;
+            case object::ID_abs:        i.op = ABS;  break;
+            case object::ID_sqrt:       i.op = SQRT; break;
+            case object::ID_exp:        i.op = EXP;  break;
+            case object::ID_log:        i.op = LN;   break;
+            case object::ID_sin:        i.op = SIN;  break;
+            case object::ID_cos:        i.op = COS;  break;
+            default:                    i.op = TAN;  break;
+            }
+            depth -= 1;
+            varies[depth] = true;
+            isint[depth] = false;
+            break;
+
+        default:
+            record(compiled, "Cannot compile %+s", object::name(ty));
+            return false;
+        }
+
+        stack[depth++] = count++;
+    }
+
+    // We must end with exactly one value that depends on the variable
+    return depth == 1 && varies[0];
+}
+
+
+bool compiled_expression::run(double x, double &result) const
+// ----------------------------------------------------------------------------
+//   Run the compiled code, return false if the evaluator must take over
+// ----------------------------------------------------------------------------
+{
+    double reg[MAX_CODE] = { 0.0 };
+    for (uint r = 0; r < count; r++)
+    {
+        const instruction &i = code[r];
+        double a = reg[i.a];
+        double b = reg[i.b];
+        double v = 0.0;
+        switch (i.op)
+        {
+        case LOAD_X:    v = x;                                  break;
+        case LOAD_K:    v = i.k;                                break;
+        case ADD:       v = a + b;                              break;
+        case SUB:       v = a - b;                              break;
+        case MUL:       v = a * b;                              break;
+        case DIV:
+            if (b == 0.0)
+                return false;
+            v = a / b;
+            break;
+        case POW:
+            if (a == 0.0 && b == 0.0)
+                return false;
+            v = std::pow(a, b);
+            break;
+        case POWI:
+        {
+            // Same algorithm as pow(algebraic_r, ularge) in arithmetic.cc
+            ularge n = i.n < 0 ? -i.n : i.n;
+            v = 1.0;
+            while (n)
+            {
+                if (n & 1)
+                    v = v * a;
+                n /= 2;
+                a = a * a;
+                if (!std::isfinite(v) || !std::isfinite(a))
+                    return false;
+            }
+            if (i.n < 0)
+            {
+                if (v == 0.0)
+                    return false;
+                v = 1.0 / v;
+            }
+            break;
+        }
+        case NEG:       v = -a;                                 break;
+        case INV:
+            if (a == 0.0)
+                return false;
+            v = 1.0 / a;
+            break;
+        case SQ:        v = a * a;                              break;
+        case ABS:       v = std::abs(a);                        break;
+        case SQRT:      v = std::sqrt(a);                       break;
+        case EXP:       v = std::exp(a);                        break;
+        case LN:        v = std::log(a);                        break;
+        case SIN:       v = std::sin(hwdouble::from_angle(a));  break;
+        case COS:       v = std::cos(hwdouble::from_angle(a));  break;
+        case TAN:       v = std::tan(hwdouble::from_angle(a));  break;
+        }
+        if (!std::isfinite(v))
+            return false;
+        reg[r] = v;
+    }
+    result = reg[count - 1];
+    return true;
+}
+
+
+algebraic_p compiled_expression::run(algebraic_r x) const
+// ----------------------------------------------------------------------------
+//   Run the compiled code on algebraic values, nullptr if evaluator must run
+// ----------------------------------------------------------------------------
+//   This uses the same arithmetic and functions as the evaluator
+{
+    algebraic_g reg[MAX_CODE];
+    for (uint r = 0; r < count && !program::interrupted(); r++)
+    {
+        const instruction &i = code[r];
+        algebraic_r a = reg[i.a];
+        algebraic_r b = reg[i.b];
+        algebraic_g v;
+        switch (i.op)
+        {
+        case LOAD_X:    v = x;                                  break;
+        case LOAD_K:    v = constants[r];                       break;
+        case ADD:       v = a + b;                              break;
+        case SUB:       v = a - b;                              break;
+        case MUL:       v = a * b;                              break;
+        case DIV:       v = a / b;                              break;
+        case POW:
+        case POWI:      v = pow(a, b);                          break;
+        case NEG:       v = neg::run(a);                        break;
+        case INV:       v = inv::run(a);                        break;
+        case SQ:        v = sq::run(a);                         break;
+        case ABS:       v = abs::run(a);                        break;
+        case SQRT:      v = sqrt::run(a);                       break;
+        case EXP:       v = exp::run(a);                        break;
+        case LN:        v = log::run(a);                        break;
+        case SIN:       v = sin::run(a);                        break;
+        case COS:       v = cos::run(a);                        break;
+        case TAN:       v = tan::run(a);                        break;
+        }
+        if (!v || !v->is_real())
+            return nullptr;
+        reg[r] = v;
+    }
+    return count ? +reg[count - 1] : nullptr;
+}
+
+
+algebraic_p compiled_expression::evaluate(program_r eq, algebraic_r x) const
+// ----------------------------------------------------------------------------
+//   Evaluate using compiled code if possible, otherwise use the evaluator
+// ----------------------------------------------------------------------------
+{
+    if (native && x && x->type() == object::ID_hwdouble)
+    {
+        double y;
+        if (run(hwdouble_p(+x)->value(), y))
+            return hwdouble::make(y);
+    }
+    else if (count && x && x->is_real() && !rt.error())
+    {
+        if (algebraic_p y = run(x))
+            return y;
+        rt.clear_error();
+    }
+    return algebraic::evaluate_function(eq, x);
+}
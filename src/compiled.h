@@ -0,0 +1,94 @@
+#ifndef COMPILED_H
+#define COMPILED_H
+// ****************************************************************************
+//  compiled.h                                                    DB48X project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Expressions compiled to register code
+//
+//     Plotting, integration and solving evaluate the same expression many
+//     times for different values of the independent variable. When the
+//     expression is simple enough, it is compiled to a short register
+//     program, which avoids running the RPL evaluator and looking up names.
+//     The program runs on doubles in hardware floating-point mode, which
+//     also avoids allocating intermediate objects, and on the usual decimal
+//     values otherwise. Anything unusual falls back to the regular
+//     evaluation with algebraic::evaluate_function.
+//
+// ****************************************************************************
+//   (C) 2024 Christophe de Dinechin <christophe@dinechin.org>
+//   This software is licensed under the terms outlined in LICENSE.txt
+// ****************************************************************************
+//   This file is part of DB48X.
+//
+//   DB48X is free software: you can redistribute it and/or modify
+//   it under the terms outlined in the LICENSE.txt file
+//
+//   DB48X is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// ****************************************************************************
+
+#include "algebraic.h"
+#include "program.h"
+#include "recorder.h"
+
+RECORDER_DECLARE(compiled);
+
+
+struct compiled_expression
+// ----------------------------------------------------------------------------
+//   An expression compiled to register code
+// ----------------------------------------------------------------------------
+//   Each instruction computes one register from previous registers, so that
+//   register `i` holds the result of `code[i]`.
+//   The code runs on doubles in HardwareFloatingPoint mode with a precision
+//   that selects `hwdouble`, when the value of the independent variable is
+//   a `hwdouble`. If any intermediate result is not finite, or if a division
+//   by zero occurs, evaluation falls back to the RPL evaluator.
+//   For other real values, the code runs on algebraic values with the same
+//   arithmetic and functions as the evaluator. If any operation fails or
+//   gives a non-real result, evaluation also falls back to the evaluator,
+//   which reports errors or computes complex results as it would otherwise.
+{
+    compiled_expression(program_r eq);
+
+    algebraic_p evaluate(program_r eq, algebraic_r x) const;
+    bool        compiled() const        { return count != 0; }
+
+    enum opcode : byte
+    {
+        LOAD_X,                 // Value of the independent variable
+        LOAD_K,                 // Numerical constant
+        ADD, SUB, MUL, DIV,     // Arithmetic on two registers
+        POW,                    // Power with a real exponent
+        POWI,                   // Power with an integer constant exponent
+        NEG, INV, SQ, ABS,      // Simple functions
+        SQRT, EXP, LN,          // Transcendental functions
+        SIN, COS, TAN,          // Trigonometric functions, using angle mode
+    };
+    enum { MAX_CODE = 24 };
+
+    struct instruction
+    {
+        opcode op;
+        byte   a, b;            // Source registers
+        large  n;               // Integer exponent for POWI
+        double k;               // Value for LOAD_K
+    };
+
+protected:
+    bool        compile(program_p eq);
+    bool        run(double x, double &result) const;
+    algebraic_p run(algebraic_r x) const;
+
+protected:
+    instruction code[MAX_CODE];
+    algebraic_g constants[MAX_CODE];    // Values for LOAD_K
+    uint        count;
+    bool        native;                 // Can run on hardware floating-point
+};
+
+#endif // COMPILED_H
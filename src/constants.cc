@@ -439,60 +439,406 @@ const constant::config constant::constants =
 };
 
 
-object::result constant::do_parsing(config_r cfg, parser &p)
+
+// ============================================================================
+//
+//   Constant file index
+//
+// ============================================================================
+//
+//   Constants, equations and library entries used to be found by scanning
+//   the CSV file from the beginning for every lookup, name or value, which
+//   happens for instance each time a constant is rendered. Instead, each
+//   file is read once to build an index of its categories and entries,
+//   with the built-in definitions that follow them. Names are looked up
+//   with a binary search in a sorted table. The index is rebuilt when the
+//   file size changes or after the calculator wrote a file. The file size
+//   is checked at most once every RECHECK_MS milliseconds. If there is not
+//   enough memory for the index, the file is scanned like before.
+
+struct constant_index
 // ----------------------------------------------------------------------------
-//    Try to parse this as a constant
+//   Index of the categories and entries for one constant configuration
 // ----------------------------------------------------------------------------
 {
-    utf8    source = p.source;
-    size_t  max    = p.length;
-    size_t  parsed = 0;
+    enum { RECHECK_MS = 1000, FILES = 4 };
 
-    // First character must be a constant marker
-    unicode cp = utf8_codepoint(source);
-    if (cp != cfg.prefix)
-        return SKIP;
-    parsed = utf8_next(source, parsed, max);
-    size_t first = parsed;
+    struct category
+    {
+        uint32_t name;          // Offset of name in pool
+        uint     first;         // First entry in the category
+        uint     count;         // Number of entries in the category
+    };
+
+    static constant_index *get(constant::config_r cfg);
+
+    uint        find(utf8 name, size_t len);
+    cstring     name(uint idx, size_t *len = nullptr);
+    cstring     definition(uint idx, size_t *len = nullptr);
+    uint        categories()            { return ncategories; }
+    cstring     category_name(uint c)   { return pool + cats[c].name; }
+    uint        category_first(uint c)  { return cats[c].first; }
+    uint        category_count(uint c)  { return cats[c].count; }
+    uint        entries()               { return count + nbuiltins; }
+
+protected:
+    constant_index(constant::config_r cfg);
+    void        validate();
+    bool        rebuild(unit_file &cfile);
+    bool        append(char c);
+    template<typename T>
+    static bool grow(T *&table, uint &alloc, uint needed);
+
+    static int  sort_names(const void *l, const void *r);
+    static constant_index *sorting;
+    static constant_index *indexes[FILES];
+
+    constant::config_r cfg;
+    char     *pool;             // Names and definitions, NUL-terminated
+    size_t    used;             // Bytes used in pool
+    size_t    capacity;         // Bytes allocated for pool
+    uint32_t *offsets;          // Offset of each file entry name in pool
+    uint      count;            // Number of file entries
+    uint      nentalloc;        // Number of allocated file entries
+    category *cats;             // Categories in the file
+    uint      ncategories;      // Number of categories
+    uint      ncatalloc;        // Number of allocated categories
+    uint16_t *builtins;         // Index of built-in entries in cfg.builtins
+    uint      nbuiltins;        // Number of built-in entries
+    uint32_t *sorted;           // Entry numbers, sorted by name
+    bool      built;            // Index is up to date
+    bool      failed;           // Not enough memory for the index
+    uint      fsize;            // File size when the index was built
+    uint      writes;           // File writes when the index was built
+    uint      checked;          // Last time we checked the file
+};
 
-    // Other characters must be alphabetic
-    while (parsed < max && is_valid_in_constant_name(source + parsed))
-        parsed = utf8_next(source, parsed, max);
-    if (parsed <= first)
-        return SKIP;
+constant_index *constant_index::sorting        = nullptr;
+constant_index *constant_index::indexes[FILES] = { nullptr };
 
-    size_t     len = parsed - first;
-    constant_p cst = do_lookup(cfg, source + first, len, true);
-    p.length       = parsed;
-    p.out          = cst;
-    return cst ? OK : ERROR;
+
+constant_index::constant_index(constant::config_r cfg)
+// ----------------------------------------------------------------------------
+//   Create an empty index for the given configuration
+// ----------------------------------------------------------------------------
+    : cfg(cfg),
+      pool(nullptr), used(0), capacity(0),
+      offsets(nullptr), count(0), nentalloc(0),
+      cats(nullptr), ncategories(0), ncatalloc(0),
+      builtins(nullptr), nbuiltins(0),
+      sorted(nullptr),
+      built(false), failed(false), fsize(0), writes(0), checked(0)
+{
+    // Built-in entries never change, they follow entries from the file
+    size_t maxb = cfg.nbuiltins;
+    uint   n    = 0;
+    for (size_t b = 0; b < maxb; b += 2)
+        if (cfg.builtins[b+1] && *cfg.builtins[b+1])
+            n++;
+    builtins = (uint16_t *) malloc((n + 1) * sizeof(uint16_t));
+    if (builtins)
+        for (size_t b = 0; b < maxb; b += 2)
+            if (cfg.builtins[b+1] && *cfg.builtins[b+1])
+                builtins[nbuiltins++] = b;
 }
 
 
-size_t constant::do_rendering(config_r cfg, constant_p o, renderer &r)
+constant_index *constant_index::get(constant::config_r cfg)
 // ----------------------------------------------------------------------------
-//   Rendering of a constant
+//   Return an up-to-date index for the given configuration
 // ----------------------------------------------------------------------------
+//   This returns nullptr if the index cannot be built, in which case the
+//   caller must scan the file.
 {
-    constant_g cst = o;
-    size_t     len = 0;
-    utf8       txt = nullptr;
-    txt = cst->do_name(cfg, &len);
-    if (r.editing())
-        r.put(cfg.prefix);
-    r.put(txt, len);
-    return r.size();
+    uint i;
+    for (i = 0; i < FILES && indexes[i]; i++)
+        if (&indexes[i]->cfg == &cfg)
+            break;
+    if (i >= FILES)
+        return nullptr;
+    if (!indexes[i])
+    {
+        // Operator new support purposefully not linked in embedded versions
+        void *mem = malloc(sizeof(constant_index));
+        if (mem)
+            indexes[i] = new((constant_index *) mem) constant_index(cfg);
+    }
+    if (constant_index *ci = indexes[i])
+    {
+        ci->validate();
+        if (ci->built && ci->builtins)
+            return ci;
+    }
+    return nullptr;
 }
 
 
-constant_p constant::do_lookup(config_r cfg, utf8 txt, size_t len, bool error)
+bool constant_index::append(char c)
 // ----------------------------------------------------------------------------
-//   Scan the table and file to see if there is matching constant
+//   Append a character to the pool
 // ----------------------------------------------------------------------------
 {
-    if (unit::mode)
-        return nullptr;
+    if (used >= capacity)
+    {
+        size_t ncap = capacity ? 2 * capacity : 512;
+        char  *npool = (char *) realloc(pool, ncap);
+        if (!npool)
+            return false;
+        pool = npool;
+        capacity = ncap;
+    }
+    pool[used++] = c;
+    return true;
+}
+
+
+template<typename T>
+bool constant_index::grow(T *&table, uint &alloc, uint needed)
+// ----------------------------------------------------------------------------
+//   Make sure a table has room for the given number of elements
+// ----------------------------------------------------------------------------
+{
+    if (needed <= alloc)
+        return true;
+    uint ncount = alloc ? 2 * alloc : 16;
+    if (ncount < needed)
+        ncount = needed;
+    T *ntable = (T *) realloc(table, ncount * sizeof(T));
+    if (!ntable)
+        return false;
+    table = ntable;
+    alloc = ncount;
+    return true;
+}
+
+
+int constant_index::sort_names(const void *l, const void *r)
+// ----------------------------------------------------------------------------
+//   Sort entries by name, then by entry number
+// ----------------------------------------------------------------------------
+{
+    uint32_t li  = *((uint32_t *) l);
+    uint32_t ri  = *((uint32_t *) r);
+    int      cmp = strcmp(sorting->name(li), sorting->name(ri));
+    return cmp ? cmp : li < ri ? -1 : li > ri;
+}
+
+
+bool constant_index::rebuild(unit_file &cfile)
+// ----------------------------------------------------------------------------
+//   Read the file once and index its categories and entries
+// ----------------------------------------------------------------------------
+//   This follows the rules of unit_file::next: a row with a single column
+//   is a category, a row with more columns is an entry in the current
+//   category, and rows before the first category are ignored.
+{
+    used        = 0;
+    count       = 0;
+    ncategories = 0;
+    built       = false;
+
+    uint   column   = 0;
+    bool   quoted   = false;
+    size_t start    = 0;
+    bool   ok       = true;
+
+    cfile.seek(0);
+    while (ok)
+    {
+        char c = cfile.getchar();
+        if (!c)
+            break;
+        if (c == '"')
+        {
+            if (quoted && cfile.peek() == '"')
+            {
+                c = cfile.getchar();
+                if (column < 2)
+                    ok = append(c);
+            }
+            else
+            {
+                quoted = !quoted;
+                if (!quoted)
+                {
+                    if (column < 2)
+                        ok = append(0);
+                    column++;
+                }
+            }
+        }
+        else if (c == '\n')
+        {
+            if (column == 1)
+            {
+                // Category
+                ok = grow(cats, ncatalloc, ncategories + 1);
+                if (ok)
+                {
+                    cats[ncategories].name  = start;
+                    cats[ncategories].first = count;
+                    cats[ncategories].count = 0;
+                    ncategories++;
+                    start = used;
+                }
+            }
+            else if (column >= 2 && ncategories)
+            {
+                // Entry in the current category
+                ok = grow(offsets, nentalloc, count + 1);
+                if (ok)
+                {
+                    offsets[count++] = start;
+                    cats[ncategories - 1].count++;
+                    start = used;
+                }
+            }
+            else
+            {
+                used = start;
+            }
+            column = 0;
+            quoted = false;
+        }
+        else if (quoted && column < 2)
+        {
+            ok = append(c);
+        }
+    }
+    used = start;
+    if (!ok)
+    {
+        used        = 0;
+        count       = 0;
+        ncategories = 0;
+        return false;
+    }
+    built = true;
+    record(constants, "Indexed %u entries in %u categories from %s",
+           count, ncategories, cfg.file);
+    return true;
+}
+
+
+void constant_index::validate()
+// ----------------------------------------------------------------------------
+//   Check that the index is up to date, rebuild it if necessary
+// ----------------------------------------------------------------------------
+{
+    // Avoid checking the file on every lookup
+    uint now = sys_current_ms();
+    if ((built || failed) &&
+        writes == file::writes && now - checked < RECHECK_MS)
+        return;
+    checked = now;
 
+    unit_file cfile(cfg.file);
+    uint      sz = cfile.valid() ? cfile.size() + 1 : 0;
+    if (built && writes == file::writes && sz == fsize)
+        return;
+
+    writes = file::writes;
+    fsize = sz;
+    if (!sz || !rebuild(cfile))
+    {
+        used        = 0;
+        count       = 0;
+        ncategories = 0;
+        built       = !sz;
+    }
+
+    // Build the table of entries sorted by name
+    uint      n       = entries();
+    uint32_t *nsorted = (uint32_t *) realloc(sorted, (n+1) * sizeof(*sorted));
+    if (!nsorted)
+    {
+        built = false;
+        failed = true;
+        return;
+    }
+    sorted = nsorted;
+    for (uint i = 0; i < n; i++)
+        sorted[i] = i;
+    sorting = this;
+    qsort(sorted, n, sizeof(*sorted), sort_names);
+    failed = !built;
+    if (failed)
+        record(constants, "Not enough memory to index %s", cfg.file);
+}
+
+
+uint constant_index::find(utf8 txt, size_t len)
+// ----------------------------------------------------------------------------
+//   Find the first entry with the given name, return ~0U if not found
+// ----------------------------------------------------------------------------
+//   Constant name comparison is case-sensitive
+{
+    if (!sorted)
+        return ~0U;
+    uint lo = 0, hi = entries();
+    while (lo < hi)
+    {
+        uint    mid = (lo + hi) / 2;
+        cstring nm  = name(sorted[mid]);
+        int     cmp = strncmp(nm, cstring(txt), len);
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < entries())
+    {
+        uint    idx = sorted[lo];
+        cstring nm  = name(idx);
+        if (strncmp(nm, cstring(txt), len) == 0 && !nm[len])
+            return idx;
+    }
+    return ~0U;
+}
+
+
+cstring constant_index::name(uint idx, size_t *len)
+// ----------------------------------------------------------------------------
+//   Return the name of the given entry
+// ----------------------------------------------------------------------------
+{
+    cstring result = nullptr;
+    if (idx < count)
+        result = pool + offsets[idx];
+    else if (idx - count < nbuiltins)
+        result = cfg.builtins[builtins[idx - count]];
+    if (len)
+        *len = result ? strlen(result) : 0;
+    return result;
+}
+
+
+cstring constant_index::definition(uint idx, size_t *len)
+// ----------------------------------------------------------------------------
+//   Return the definition of the given entry
+// ----------------------------------------------------------------------------
+{
+    cstring result = nullptr;
+    if (idx < count)
+    {
+        result = pool + offsets[idx];
+        result += strlen(result) + 1;
+    }
+    else if (idx - count < nbuiltins)
+    {
+        result = cfg.builtins[builtins[idx - count] + 1];
+    }
+    if (len)
+        *len = result ? strlen(result) : 0;
+    return result;
+}
+
+
+static constant_p scan_lookup(constant::config_r cfg, utf8 txt, size_t len)
+// ----------------------------------------------------------------------------
+//   Scan the file and built-ins for a constant when there is no index
+// ----------------------------------------------------------------------------
+{
     unit_file cfile(cfg.file);
     size_t    maxb     = cfg.nbuiltins;
     auto      builtins = cfg.builtins;
@@ -529,23 +875,19 @@ constant_p constant::do_lookup(config_r cfg, utf8 txt, size_t len, bool error)
             idx++;
         }
     }
-
-    if (error)
-        cfg.error().source(txt, len);
     return nullptr;
 }
 
 
-utf8 constant::do_name(config_r cfg, size_t *len) const
+static utf8 scan_name(constant::config_r cfg, uint idx, size_t *len)
 // ----------------------------------------------------------------------------
-//   Return the name for the constant
+//   Scan the file and built-ins for the name of a constant
 // ----------------------------------------------------------------------------
 {
     unit_file cfile(cfg.file);
     size_t    maxb     = cfg.nbuiltins;
     auto      builtins = cfg.builtins;
     cstring   ctxt     = nullptr;
-    uint      idx      = index();
 
     // Check in-file constants
     if (cfile.valid())
@@ -581,18 +923,16 @@ utf8 constant::do_name(config_r cfg, size_t *len) const
 }
 
 
-object_p constant::do_value(config_r cfg) const
+static void scan_definition(constant::config_r cfg, uint idx,
+                            symbol_g &cname, symbol_g &csym)
 // ----------------------------------------------------------------------------
-//   Lookup a built-in constant
+//   Scan the file and built-ins for the name and definition of a constant
 // ----------------------------------------------------------------------------
 {
     unit_file cfile(cfg.file);
     size_t    maxb     = cfg.nbuiltins;
     auto      builtins = cfg.builtins;
-    symbol_g  csym     = nullptr;
-    symbol_g  cname    = nullptr;
     size_t    clen     = 0;
-    uint      idx      = index();
 
     // Check in-file constants
     if (cfile.valid())
@@ -633,6 +973,119 @@ object_p constant::do_value(config_r cfg) const
             idx--;
         }
     }
+}
+
+
+object::result constant::do_parsing(config_r cfg, parser &p)
+// ----------------------------------------------------------------------------
+//    Try to parse this as a constant
+// ----------------------------------------------------------------------------
+{
+    utf8    source = p.source;
+    size_t  max    = p.length;
+    size_t  parsed = 0;
+
+    // First character must be a constant marker
+    unicode cp = utf8_codepoint(source);
+    if (cp != cfg.prefix)
+        return SKIP;
+    parsed = utf8_next(source, parsed, max);
+    size_t first = parsed;
+
+    // Other characters must be alphabetic
+    while (parsed < max && is_valid_in_constant_name(source + parsed))
+        parsed = utf8_next(source, parsed, max);
+    if (parsed <= first)
+        return SKIP;
+
+    size_t     len = parsed - first;
+    constant_p cst = do_lookup(cfg, source + first, len, true);
+    p.length       = parsed;
+    p.out          = cst;
+    return cst ? OK : ERROR;
+}
+
+
+size_t constant::do_rendering(config_r cfg, constant_p o, renderer &r)
+// ----------------------------------------------------------------------------
+//   Rendering of a constant
+// ----------------------------------------------------------------------------
+{
+    constant_g cst = o;
+    size_t     len = 0;
+    utf8       txt = nullptr;
+    txt = cst->do_name(cfg, &len);
+    if (r.editing())
+        r.put(cfg.prefix);
+    r.put(txt, len);
+    return r.size();
+}
+
+
+constant_p constant::do_lookup(config_r cfg, utf8 txt, size_t len, bool error)
+// ----------------------------------------------------------------------------
+//   Search the index of file and built-in entries for a matching constant
+// ----------------------------------------------------------------------------
+{
+    if (unit::mode)
+        return nullptr;
+
+    if (constant_index *ci = constant_index::get(cfg))
+    {
+        uint idx = ci->find(txt, len);
+        if (idx != ~0U)
+            return constant::make(cfg.type, idx);
+    }
+    else if (constant_p cst = scan_lookup(cfg, txt, len))
+    {
+        return cst;
+    }
+
+    if (error)
+        cfg.error().source(txt, len);
+    return nullptr;
+}
+
+
+utf8 constant::do_name(config_r cfg, size_t *len) const
+// ----------------------------------------------------------------------------
+//   Return the name for the constant
+// ----------------------------------------------------------------------------
+//   The name points into the index pool, which is reallocated when the index
+//   is rebuilt. It must be used or copied before the next index lookup, e.g.
+//   before looking up another constant or the value of this one.
+{
+    if (constant_index *ci = constant_index::get(cfg))
+        return utf8(ci->name(index(), len));
+    return scan_name(cfg, index(), len);
+}
+
+
+object_p constant::do_value(config_r cfg) const
+// ----------------------------------------------------------------------------
+//   Lookup a built-in constant
+// ----------------------------------------------------------------------------
+{
+    symbol_g  csym     = nullptr;
+    symbol_g  cname    = nullptr;
+    size_t    clen     = 0;
+    uint      idx      = index();
+
+    // Find the definition in the index
+    if (constant_index *ci = constant_index::get(cfg))
+    {
+        if (cstring cdef = ci->definition(idx, &clen))
+        {
+            size_t nlen = 0;
+            cstring ntxt = ci->name(idx, &nlen);
+            cname = symbol::make(utf8(ntxt), nlen);
+            csym = symbol::make(utf8(cdef), clen);
+        }
+    }
+    else
+    {
+        scan_definition(cfg, idx, cname, csym);
+    }
 
     // If we found a definition, use that
     if (csym)
@@ -691,14 +1144,33 @@ utf8 constant_menu::do_name(constant::config_r cfg, id type, size_t &len)
 // ----------------------------------------------------------------------------
 {
     uint count = type - cfg.first_menu;
-    unit_file cfile(cfg.file);
 
     // List all preceding entries
-    if (cfile.valid())
-        while (symbol_p mname = cfile.next(true))
-            if (*mname->value() != '=')
+    if (constant_index *ci = constant_index::get(cfg))
+    {
+        for (uint c = 0; c < ci->categories(); c++)
+        {
+            cstring mname = ci->category_name(c);
+            if (*mname != '=')
+            {
                 if (!count--)
-                    return mname->value(&len);
+                {
+                    len = strlen(mname);
+                    return utf8(mname);
+                }
+            }
+        }
+    }
+    else
+    {
+        // Not indexed, scan the file
+        unit_file cfile(cfg.file);
+        if (cfile.valid())
+            while (symbol_p mname = cfile.next(true))
+                if (*mname->value() != '=')
+                    if (!count--)
+                        return mname->value(&len);
+    }
 
     if (cfg.show_builtins())
     {
@@ -727,27 +1199,26 @@ bool constant_menu::do_submenu(constant::config_r cfg, menu_info &mi) const
 // ----------------------------------------------------------------------------
 {
     // Use the constants loaded from the constants file
-    unit_file cfile(cfg.file);
-    size_t    matching = 0;
-    uint      position = 0;
-    uint      count    = 0;
-    id        type     = this->type();
-    id        menu     = cfg.first_menu;
-    id        lastm    = cfg.last_menu;
-    size_t    first    = 0;
-    size_t    last     = cfg.nbuiltins;
-
-    if (cfile.valid())
+    constant_index *ci       = constant_index::get(cfg);
+    size_t          matching = 0;
+    uint            position = 0;
+    uint            count    = 0;
+    id              type     = this->type();
+    id              menu     = cfg.first_menu;
+    id              lastm    = cfg.last_menu;
+    size_t          first    = 0;
+    size_t          last     = cfg.nbuiltins;
+
+    if (ci)
     {
-        while (symbol_p mname = cfile.next(true))
+        for (uint c = 0; c < ci->categories(); c++)
         {
-            if (*mname->value() == '=')
+            if (*ci->category_name(c) == '=')
                 continue;
             if (menu == type)
             {
-                position = cfile.position();
-                while (cfile.next(false))
-                    matching++;
+                position = ci->category_first(c);
+                matching = ci->category_count(c);
                 menu = id(menu + 1);
                 break;
             }
@@ -756,6 +1227,30 @@ bool constant_menu::do_submenu(constant::config_r cfg, menu_info &mi) const
                 break;
         }
     }
+    else
+    {
+        // Not indexed, scan the file
+        unit_file cfile(cfg.file);
+        if (cfile.valid())
+        {
+            while (symbol_p mname = cfile.next(true))
+            {
+                if (*mname->value() == '=')
+                    continue;
+                if (menu == type)
+                {
+                    position = cfile.position();
+                    while (cfile.next(false))
+                        matching++;
+                    menu = id(menu + 1);
+                    break;
+                }
+                menu = id(menu + 1);
+                if (menu > lastm)
+                    break;
+            }
+        }
+    }
 
     // Disable built-in constants if we loaded a file
     if (!matching || cfg.show_builtins())
@@ -802,8 +1297,30 @@ bool constant_menu::do_submenu(constant::config_r cfg, menu_info &mi) const
         mi.skip   = skip;
         id type = ids[plane];
 
-        if (matching)
+        for (uint e = 0; ci && e < matching; e++)
+        {
+            if (plane == 1)
+            {
+                size_t   mlen   = 0;
+                cstring  mtxt   = ci->definition(position + e, &mlen);
+                symbol_g mentry = symbol::make(utf8(mtxt), mlen);
+                if (cfg.label)
+                    mentry = cfg.label(mentry);
+                if (mentry)
+                    items(mi, mentry, type);
+            }
+            else
+            {
+                size_t   mlen   = 0;
+                cstring  mtxt   = ci->name(position + e, &mlen);
+                symbol_g mentry = symbol::make(utf8(mtxt), mlen);
+                items(mi, mentry, type);
+            }
+        }
+        if (!ci && matching)
         {
+            // Not indexed, read the entries from the file
+            unit_file cfile(cfg.file);
             cfile.seek(position);
             if (plane == 1)
             {
@@ -866,19 +1383,29 @@ bool constant::do_collection_menu(constant::config_r cfg, menu_info &mi)
 //   Build the collection menu for the given config
 // ----------------------------------------------------------------------------
 {
-    uint      infile   = 0;
-    uint      count    = 0;
-    uint      maxmenus = cfg.last_menu - cfg.first_menu;
-    size_t    maxb     = cfg.nbuiltins;
-    auto      builtins = cfg.builtins;
-    unit_file cfile(cfg.file);
+    uint            infile   = 0;
+    uint            count    = 0;
+    uint            maxmenus = cfg.last_menu - cfg.first_menu;
+    size_t          maxb     = cfg.nbuiltins;
+    auto            builtins = cfg.builtins;
+    constant_index *ci       = constant_index::get(cfg);
+    uint            ncats    = ci ? ci->categories() : 0;
 
     // List all menu entries in the file (up to 100)
-    if (cfile.valid())
-        while (symbol_p mname = cfile.next(true))
-            if (*mname->value() != '=')
-                if (infile++ >= maxmenus)
-                    break;
+    for (uint c = 0; c < ncats; c++)
+        if (*ci->category_name(c) != '=')
+            if (infile++ >= maxmenus)
+                break;
+    if (!ci)
+    {
+        // Not indexed, scan the file
+        unit_file cfile(cfg.file);
+        if (cfile.valid())
+            while (symbol_p mname = cfile.next(true))
+                if (*mname->value() != '=')
+                    if (infile++ >= maxmenus)
+                        break;
+    }
 
     // Count built-in constant menu titles
     if (!infile || cfg.show_builtins())
@@ -892,16 +1419,28 @@ bool constant::do_collection_menu(constant::config_r cfg, menu_info &mi)
 
     menu::items_init(mi, infile + count);
     infile = 0;
-    if (cfile.valid())
+    for (uint c = 0; c < ncats; c++)
     {
-        cfile.seek(0);
-        while (symbol_p mname = cfile.next(true))
+        cstring mname = ci->category_name(c);
+        if (*mname == '=')
+            continue;
+        if (infile >= maxmenus)
+            break;
+        menu::items(mi, mname, id(cfg.first_menu + infile++));
+    }
+    if (!ci)
+    {
+        unit_file cfile(cfg.file);
+        if (cfile.valid())
         {
-            if (*mname->value() == '=')
-                continue;
-            if (infile >= maxmenus)
-                break;
-            menu::items(mi, mname, id(cfg.first_menu + infile++));
+            while (symbol_p mname = cfile.next(true))
+            {
+                if (*mname->value() == '=')
+                    continue;
+                if (infile >= maxmenus)
+                    break;
+                menu::items(mi, mname, id(cfg.first_menu + infile++));
+            }
         }
     }
     if (!infile || cfg.show_builtins())
@@ -997,24 +1536,37 @@ object_p constant::lookup_menu(config_r cfg, utf8 name, size_t len)
 //   Find the menu in the current configuratoin
 // ----------------------------------------------------------------------------
 {
-    unit_file cfile(cfg.file);
     size_t    maxb     = cfg.nbuiltins;
     auto      builtins = cfg.builtins;
     uint      idx      = cfg.first_menu;
 
     // Check in-file constants
-    if (cfile.valid())
+    if (constant_index *ci = constant_index::get(cfg))
     {
-        cfile.seek(0);
-        while (symbol_g category = cfile.next(true))
+        for (uint c = 0; c < ci->categories(); c++)
         {
-            size_t clen = 0;
-            utf8 ctxt = category->value(&clen);
-            if (len == clen && memcmp(name, ctxt, len) == 0)
+            cstring ctxt = ci->category_name(c);
+            if (strncmp(ctxt, cstring(name), len) == 0 && !ctxt[len])
                 return object::static_object(id(idx));
             idx++;
         }
     }
+    else
+    {
+        // Not indexed, scan the file
+        unit_file cfile(cfg.file);
+        if (cfile.valid())
+        {
+            while (symbol_p mname = cfile.next(true))
+            {
+                size_t  clen = 0;
+                cstring ctxt = cstring(mname->value(&clen));
+                if (clen == len && memcmp(ctxt, name, len) == 0)
+                    return object::static_object(id(idx));
+                idx++;
+            }
+        }
+    }
 
     // Check built-in constants
     for (size_t b = 0; b < maxb; b += 2)
@@ -108,6 +108,7 @@ struct constant : algebraic
 
     utf8        name(size_t *size = nullptr) const
     {
+        // Only valid until the next lookup, see constant::do_name
         return do_name(constants, size);
     }
     algebraic_p value() const
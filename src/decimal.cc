@@ -1459,6 +1459,14 @@ int decimal::compare(decimal_r x, decimal_r y, uint epsilon)
     id   xty = x->type();
     id   yty = y->type();
 
+    // Zero has no meaningful exponent, compare with the sign of the other
+    bool xz = x->is_zero();
+    bool yz = y->is_zero();
+    if (xz || yz)
+        return xz == yz ? 0
+            : xz        ? (yty == ID_decimal ? -1 : 1)
+                        : (xty == ID_decimal ? 1 : -1);
+
     // Check negative vs. positive
     if (xty != yty)
         return (xty == ID_decimal) - (yty == ID_decimal);
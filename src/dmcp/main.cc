@@ -559,6 +559,9 @@ extern "C" void program_main()
             process_test_key(key);
 #endif // SIMULATOR && !WASM
 
+            // Ignore ticks from idle time, they would steal type-ahead keys
+            program::ticked = false;
+
             record(main, "Handle key %d last %d", key, last_key);
             handle_key(key, repeating, transalpha);
             record(main, "Did key %d last %d", key, last_key);
@@ -663,6 +666,12 @@ void process_test_commands()
     {
         record(tests_rpl, "Key sync requested");
     }
+    else if (test_command == tests::IMAGE)
+    {
+        record(tests_rpl, "Saving and reloading state image for tests");
+        if (!state_image_round_trip("state/ImageTest.48S"))
+            rt.error("State image was not reloaded");
+    }
     if (!ui.showing_graphics())
         redraw_lcd(true);
     record(tests_rpl, "Done redrawing LCD after command %u, last=%d",
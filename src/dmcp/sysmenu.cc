@@ -31,6 +31,7 @@
 
 #include "dmcp.h"
 #include "file.h"
+#include "hash.h"
 #include "main.h"
 #include "object.h"
 #include "program.h"
@@ -232,6 +233,97 @@ static bool state_save_variable(object_p name, object_p obj, void *renderer_ptr)
 }
 
 
+static bool is_valid_state_file(cstring filename);
+
+
+static bool state_image_name(char *image, size_t size, cstring path)
+// ----------------------------------------------------------------------------
+//   Build the name of the binary image that goes with a state file
+// ----------------------------------------------------------------------------
+//   The image for "/state/Foo.48S" is "/state/Foo.48B"
+{
+    size_t len = strlen(path);
+    if (len >= size || !is_valid_state_file(path))
+        return false;
+    memcpy(image, path, len + 1);
+    image[len - 1] = path[len - 1] == 's' ? 'b' : 'B';
+    return true;
+}
+
+
+static uint32_t state_source_hash(cstring path)
+// ----------------------------------------------------------------------------
+//   Hash the contents of a state file to match it with its binary image
+// ----------------------------------------------------------------------------
+//   If the state file is edited on a computer, the image is ignored
+{
+    file src(path, file::READING);
+    if (!src.valid())
+        return 0;
+
+    char     buf[256];
+    uint     size = src.size();
+    uint32_t h    = FNV_BASIS;
+    for (uint done = 0; done < size; )
+    {
+        uint len = size - done < sizeof(buf) ? size - done : sizeof(buf);
+        if (!src.read(buf, len))
+            return 0;
+        h = fnv1a(h, buf, len);
+        done += len;
+    }
+    return h ^ size;
+}
+
+
+static void state_image_save(cstring path)
+// ----------------------------------------------------------------------------
+//   Save a binary image next to the state file we just wrote
+// ----------------------------------------------------------------------------
+//   The image is only an accelerator, so failing to write it is not an error
+{
+    char     name[80];
+    uint32_t source = state_source_hash(path);
+    if (!source || !state_image_name(name, sizeof(name), path))
+        return;
+
+    bool ok = false;
+    {
+        file image(name, file::WRITING);
+        ok = image.valid() && rt.save_image(image, source, ui.menu());
+    }
+    if (!ok)
+        file::unlink(name);
+}
+
+
+static bool state_image_load(cstring path)
+// ----------------------------------------------------------------------------
+//   Load the binary image for a state file if it matches the file
+// ----------------------------------------------------------------------------
+{
+    char     name[80];
+    uint32_t source = state_source_hash(path);
+    if (!source || !state_image_name(name, sizeof(name), path))
+        return false;
+
+    // Loading the keymap may garbage-collect, so protect the menu early
+    object_g menu;
+    {
+        file     image(name, file::READING);
+        object_p loaded = nullptr;
+        if (!image.valid() || !rt.load_image(image, source, loaded))
+            return false;
+        menu = loaded;
+    }
+
+    load_saved_keymap();
+    if (menu)
+        menu->evaluate();
+    return true;
+}
+
+
 static int state_save_callback(cstring fpath, cstring fname, void *)
 // ----------------------------------------------------------------------------
 //   Callback when a file is selected
@@ -289,6 +381,10 @@ static int state_save_callback(cstring fpath, cstring fname, void *)
     // Restore the settings we had
     Settings = saved;
 
+    // Save a binary image for faster loading once the state file is closed
+    prog.close();
+    state_image_save(fpath);
+
     // Store the state file name so that we automatically reload it
     set_reset_state_file(fpath);
 
@@ -365,6 +461,14 @@ static int state_load_callback(cstring path, cstring name, void *merge)
                                   "WARNING: Current state will be lost"))
             return 0;
 
+        // Use the binary image if it was saved with this state file
+        ui.draw_message("Load state", "Loading state...", name);
+        if (state_image_load(path))
+        {
+            set_reset_state_file(path);
+            return MRET_EXIT;
+        }
+
         // Clear the state
         rt.reset();
         Settings = settings();
@@ -625,6 +729,21 @@ bool save_state_file(cstring path)
 }
 
 
+#if SIMULATOR
+bool state_image_round_trip(cstring path)
+// ----------------------------------------------------------------------------
+//   Save a state file with its image, then reload the image, for tests
+// ----------------------------------------------------------------------------
+{
+    char reset[256];
+    snprintf(reset, sizeof(reset), "%s", get_reset_state_file());
+    state_save_callback(path, path, nullptr);
+    set_reset_state_file(reset);
+    return state_image_load(path);
+}
+#endif // SIMULATOR
+
+
 bool load_system_state()
 // ----------------------------------------------------------------------------
 //   Load the default system state file
@@ -637,7 +756,7 @@ bool load_system_state()
         // legitimately return a .f42 file if we just switched from DM42.
         char *state = get_reset_state_file();
         if (is_valid_state_file(state))
-            return load_state_file(state);
+            return state_image_load(state) || load_state_file(state);
     }
     return false;
 }
@@ -87,6 +87,7 @@ void                  redraw_lcd(bool force);
 #if SIMULATOR
 void                  process_test_key(int key);
 void                  process_test_commands();
+bool                  state_image_round_trip(cstring path);
 #endif
 
 #endif // SYSMENU_H
@@ -34,6 +34,7 @@
 #include "equations.h"
 #include "functions.h"
 #include "grob.h"
+#include "hash.h"
 #include "integer.h"
 #include "parser.h"
 #include "polynomial.h"
@@ -49,6 +50,7 @@ RECORDER(expression,            16, "Expressions and algebraic objects");
 RECORDER(expression_error,      16, "Errors with expressions");
 RECORDER(rewrites,              16, "Expression rewrites");
 RECORDER(rewrites_done,         16, "Successful expression rewrites");
+RECORDER(rewrites_stats,        16, "Rules tried and matched per pass");
 
 
 symbol_g *expression::independent                   = nullptr;
@@ -1061,16 +1063,451 @@ static size_t check_match(size_t eq, size_t eqsz,
 }
 
 
-static algebraic_p build_expr(expression_p eqin,
-                              uint         eqst,
-                              expression_r to,
-                              uint         matchsz,
-                              uint         locals,
-                              uint        &rwcount,
-                              bool        &replaced)
+struct pattern_matcher;
+static algebraic_p build_expr(expression_p           eqin,
+                              uint                   eqst,
+                              expression_r           to,
+                              uint                   matchsz,
+                              uint                   locals,
+                              uint                  &rwcount,
+                              bool                  &replaced,
+                              const pattern_matcher *matcher = nullptr);
+
+
+struct pattern_matcher
+// ----------------------------------------------------------------------------
+//   A rewrite pattern compiled into matching steps with binding slots
+// ----------------------------------------------------------------------------
+//   Wildcards are bound to slots in the matcher instead of locals. Their
+//   kind and the rule condition are checked while matching, so that a
+//   failed attempt does not push or pop any local. Values are only built
+//   from the expanded expression when a check needs them, or on success.
+//   Patterns that do not fit are matched by `check_match` using locals.
+{
+    enum opcode : byte
+    {
+        LITERAL,                // Object must be identical
+        BIND,                   // First occurrence of a wildcard, check kind
+        SAME,                   // Repeated wildcard, must match its binding
+    };
+    enum { MAX_STEPS = 40, MAX_SLOTS = 12 };
+
+    struct step
+    {
+        opcode op;
+        byte   slot;            // Binding slot for BIND and SAME
+    };
+
+    struct binding
+    {
+        symbol_g name;          // Wildcard name
+        object_g value;         // Bound value, null until needed
+        size_t   start;         // Position of the argument on the stack
+        size_t   length;        // Number of objects in the argument
+        char     kind;          // Wildcard category
+        bool     bound;         // Bound in the current attempt
+    };
+
+    pattern_matcher(): count(0), slots(0), linear(false) {}
+
+    bool     compile(size_t from, size_t fromsz);
+    size_t   match(size_t eq, size_t eqsz, size_t from, expression_r cond);
+    object_p lookup(symbol_p name) const;
+
+    static size_t argument(size_t eq, size_t eqsz);
+
+private:
+    bool     bind(binding &b, size_t eq, size_t len);
+    bool     same(const binding &b, size_t eq, size_t len) const;
+    object_p value(binding &b);
+
+public:
+    step     steps[MAX_STEPS];
+    size_t   count;                     // Steps in the pattern, 0 if none
+    binding  bindings[MAX_SLOTS + 2];   // Two more for `A` and `B` of `l`
+    uint     slots;                     // Wildcards in the pattern
+    bool     linear;                    // Pattern has a linear wildcard
+};
+
+
+static bool is_named(symbol_p sym, cstring name)
+// ----------------------------------------------------------------------------
+//   Check if a symbol has exactly the given name
+// ----------------------------------------------------------------------------
+{
+    size_t len = 0;
+    utf8   txt = sym->value(&len);
+    return len == strlen(name) && memcmp(txt, name, len) == 0;
+}
+
+
+bool pattern_matcher::compile(size_t from, size_t fromsz)
+// ----------------------------------------------------------------------------
+//   Compile the pattern expanded on the stack at `from`
+// ----------------------------------------------------------------------------
+{
+    count  = 0;
+    slots  = 0;
+    linear = false;
+    if (fromsz > MAX_STEPS)
+        return false;
+
+    bool explicit_wildcards = Settings.ExplicitWildcards();
+    bool named_ab           = false;
+    for (size_t p = 0; p < fromsz; p++)
+    {
+        object_p obj = rt.stack(from + p);
+        if (!obj)
+            return false;
+        step &s = steps[p];
+        s.op = LITERAL;
+        s.slot = 0;
+        if (obj->type() == object::ID_symbol &&
+            symbol_p(obj)->starts_with("&") == explicit_wildcards)
+        {
+            symbol_p name = symbol_p(obj);
+            uint     slot = 0;
+            while (slot < slots && !bindings[slot].name->is_same_as(name))
+                slot++;
+            if (slot < slots)
+            {
+                s.op = SAME;
+            }
+            else
+            {
+                if (slots >= MAX_SLOTS)
+                    return false;
+                binding &b = bindings[slots++];
+                b.name = name;
+                b.kind = wildcard_category(name);
+                if (must_be_linear_function_of_independent_variable(b.kind))
+                    linear = true;
+                if (is_named(name, "A") || is_named(name, "B"))
+                    named_ab = true;
+                s.op = BIND;
+            }
+            s.slot = slot;
+        }
+    }
+
+    // A linear wildcard binds `A` and `B`, which must not be in the pattern
+    if (linear)
+    {
+        if (named_ab)
+            return false;
+        bindings[slots].name = symbol::make("A");
+        bindings[slots].kind = 'A';
+        bindings[slots + 1].name = symbol::make("B");
+        bindings[slots + 1].kind = 'B';
+        if (!bindings[slots].name || !bindings[slots + 1].name)
+            return false;
+    }
+
+    count = fromsz;
+    return true;
+}
+
+
+size_t pattern_matcher::argument(size_t eq, size_t eqsz)
+// ----------------------------------------------------------------------------
+//   Return the number of objects in the argument at `eq`, 0 if incomplete
+// ----------------------------------------------------------------------------
+//   This follows the same logic as `grab_arguments`
+{
+    size_t len   = 0;
+    size_t arity = 1;
+    while (arity && len < eqsz)
+    {
+        arity--;
+        arity += rt.stack(eq + len)->arity();
+        len++;
+    }
+    return arity ? 0 : len;
+}
+
+
+object_p pattern_matcher::value(binding &b)
+// ----------------------------------------------------------------------------
+//   Build the value bound to a wildcard if it was not built yet
+// ----------------------------------------------------------------------------
+{
+    if (!b.value)
+    {
+        size_t eq   = b.start;
+        size_t eqsz = b.length;
+        bool   ivar = expression::contains_independent_variable;
+        b.value = grab_arguments(eq, eqsz);
+        expression::contains_independent_variable = ivar;
+    }
+    return b.value;
+}
+
+
+bool pattern_matcher::same(const binding &b, size_t eq, size_t len) const
+// ----------------------------------------------------------------------------
+//   Check if the argument at `eq` is the same as what is bound in `b`
+// ----------------------------------------------------------------------------
+//   This gives the same result as comparing `b.value` with the object that
+//   `grab_arguments` would build, without building it
+{
+    if (b.value)
+    {
+        if (len == 1)
+            return b.value->is_same_as(rt.stack(eq));
+        if (b.value->type() != object::ID_expression)
+            return false;
+        size_t n = len;
+        for (object_p obj : *expression_p(+b.value))
+            if (!n-- || !obj->is_same_as(rt.stack(eq + n)))
+                return false;
+        return n == 0;
+    }
+
+    if (b.length != len)
+        return false;
+    for (size_t i = 0; i < len; i++)
+        if (!rt.stack(eq + i)->is_same_as(rt.stack(b.start + i)))
+            return false;
+    return true;
+}
+
+
+bool pattern_matcher::bind(binding &b, size_t eq, size_t len)
+// ----------------------------------------------------------------------------
+//   Bind a wildcard to the argument at `eq` if it has the expected kind
+// ----------------------------------------------------------------------------
+//   This performs the same checks as `check_match` in the same order
+{
+    b.start  = eq;
+    b.length = len;
+    b.value  = nullptr;
+
+    // Check if the argument contains the independent variable
+    bool ivar = false;
+    if (symbol_g *ref = expression::independent)
+        if (symbol_p sym = *ref)
+            for (size_t i = 0; !ivar && i < len; i++)
+                ivar = sym->found_in(rt.stack(eq + i));
+    expression::contains_independent_variable = ivar;
+
+    char wcat     = b.kind;
+    char cat      = tolower(wcat);
+    bool want_cst = must_be_constant(cat);
+    bool want_int = must_be_integer(cat);
+    bool want_var = must_be_non_constant(cat);
+    if (want_cst || want_int || want_var)
+    {
+        // Numbers evaluate as themselves, anything else is evaluated
+        object_p obj = rt.stack(eq);
+        if (len != 1 || !object::is_real(obj->type()))
+        {
+            object_g arg = value(b);
+            if (!arg)
+                return false;
+            size_t depth = rt.depth();
+            if (program::run(+arg) != object::OK)
+                return false;
+            if (rt.depth() != depth + 1)
+            {
+                if (rt.depth() > depth)
+                    rt.drop(rt.depth() - depth);
+                return false;
+            }
+            obj = rt.pop();
+        }
+        b.value = obj;
+
+        object::id ty = obj->type();
+        if ((want_int && ty != object::ID_integer)         ||
+            (want_cst && !object::is_real(ty))             ||
+            (want_var && object::is_real(ty))              ||
+            (must_be_nonzero(cat) && obj->is_zero(false)))
+            return false;
+    }
+    else if (must_be_unique(cat))
+    {
+        for (const binding &e : bindings)
+            if (e.bound && same(e, eq, len))
+                return false;
+    }
+    else if (must_be_symbol(cat))
+    {
+        if (len != 1 || !rt.stack(eq)->as_quoted<symbol>())
+            return false;
+    }
+    else if (must_be_the_independent_variable(cat))
+    {
+        bool isvar = false;
+        if (len == 1 && expression::independent)
+            if (symbol_p ivar = *expression::independent)
+                if (symbol_p sym = rt.stack(eq)->as_quoted<symbol>())
+                    isvar = sym->is_same_as(ivar);
+        if (!isvar)
+            return false;
+    }
+    else if (must_contain_the_independent_variable(cat))
+    {
+        if (!ivar)
+            return false;
+    }
+    else if (must_not_contain_the_independent_variable(cat))
+    {
+        if (ivar)
+            return false;
+        if (must_be_nonzero(cat))
+        {
+            object_p obj = len == 1 ? rt.stack(eq) : value(b);
+            if (!obj || obj->is_zero(false))
+                return false;
+        }
+    }
+    else if (must_be_linear_function_of_independent_variable(cat))
+    {
+        if (!ivar || !expression::independent)
+            return false;
+        symbol_g ivsym = *expression::independent;
+        object_g arg   = value(b);
+        if (!ivsym || !arg)
+            return false;
+        bool        isok = false;
+        algebraic_g a, b0;
+        if (symbol_p s = arg->as_quoted<symbol>())
+        {
+            isok = s->is_same_as(ivsym);
+            if (isok)
+            {
+                a = integer::make(1);
+                b0 = integer::make(0);
+            }
+        }
+        expression_p x = expression::get(arg);
+        if (x && x->is_linear(ivsym, a, b0))
+            isok = true;
+        if (!isok || !a || !b0)
+            return false;
+        binding &ab = bindings[slots];
+        binding &bb = bindings[slots + 1];
+        ab.value = +a;
+        bb.value = +b0;
+        ab.bound = bb.bound = true;
+    }
+
+    // Check if things must be sorted
+    if (must_be_sorted(wcat))
+    {
+        for (binding &e : bindings)
+        {
+            if (!e.bound || !must_be_sorted(e.kind))
+                continue;
+            object_g existing = value(e);
+            object_g mine     = value(b);
+            if (!existing || !mine)
+                return false;
+
+            // Check if order of names and values match
+            int cmpnames = b.name->compare_to(+e.name);
+            int cmpvals  = mine->compare_to(existing);
+            if (cmpnames * cmpvals < 0)
+                return false;
+        }
+    }
+
+    b.bound = true;
+    return true;
+}
+
+
+size_t pattern_matcher::match(size_t eq, size_t eqsz, size_t from,
+                              expression_r cond)
+// ----------------------------------------------------------------------------
+//   Match the sub-expression at `eq`, return the number of objects matched
+// ----------------------------------------------------------------------------
+{
+    size_t eqs = eq;
+    for (binding &b : bindings)
+        b.bound = false;
+
+    for (size_t p = 0; p < count; p++)
+    {
+        if (!eqsz || program::interrupted())
+            return 0;
+        const step &s = steps[p];
+        if (s.op == LITERAL)
+        {
+            object_p pat = rt.stack(from + p);
+            object_p top = rt.stack(eq);
+            if (pat->type() == object::ID_funcall)
+            {
+                if (top->type() != object::ID_funcall ||
+                    !expression::funcall_match ||
+                    !expression::funcall_match(funcall_p(pat), funcall_p(top)))
+                    return 0;
+            }
+            else if (!top->is_same_as(pat))
+            {
+                return 0;
+            }
+            eq++;
+            eqsz--;
+            continue;
+        }
+
+        size_t len = argument(eq, eqsz);
+        if (!len)
+            return 0;
+        binding &b = bindings[s.slot];
+        if (s.op == SAME ? !same(b, eq, len) : !bind(b, eq, len))
+            return 0;
+        eq += len;
+        eqsz -= len;
+    }
+
+    // Build the bound values, which conditions and replacement need
+    for (binding &b : bindings)
+        if (b.bound && !value(b))
+            return 0;
+
+    // Check the condition with the bound values
+    if (cond)
+    {
+        uint        condrw   = 0;
+        bool        condrepl = false;
+        algebraic_g cval     = build_expr(cond, 0, cond, ~0U, 0,
+                                          condrw, condrepl, this);
+        if (!cval)
+            return 0;
+        cval = cval->evaluate();
+        if (!cval || cval->as_truth(false) <= 0)
+            return 0;
+    }
+    return eq - eqs;
+}
+
+
+object_p pattern_matcher::lookup(symbol_p name) const
+// ----------------------------------------------------------------------------
+//   Return the value bound to a wildcard name in the last match
+// ----------------------------------------------------------------------------
+{
+    for (const binding &b : bindings)
+        if (b.bound && b.name->is_same_as(name))
+            return b.value;
+    return nullptr;
+}
+
+
+static algebraic_p build_expr(expression_p           eqin,
+                              uint                   eqst,
+                              expression_r           to,
+                              uint                   matchsz,
+                              uint                   locals,
+                              uint                  &rwcount,
+                              bool                  &replaced,
+                              const pattern_matcher *matcher)
 // ----------------------------------------------------------------------------
 //   Build an expression by rewriting
 // ----------------------------------------------------------------------------
+//   Wildcard values come from `matcher` if given, otherwise from locals
 {
     scribble     scr;
     expression_g eq       = eqin;
@@ -1133,6 +1570,11 @@ static algebraic_p build_expr(expression_p eqin,
                             nvars++;
                         }
                     }
+                    else if (matcher)
+                    {
+                        found = matcher->lookup(name);
+                        nvars++;
+                    }
                     else
                     {
                         size_t   symbols = rt.locals() - locals;
@@ -1217,11 +1659,15 @@ static algebraic_p build_expr(expression_p eqin,
 
 static size_t check_match(size_t eq, size_t eqsz,
                           size_t from, size_t fromsz,
-                          expression_r cond, uint locals)
+                          expression_r cond, uint locals,
+                          pattern_matcher &matcher)
 // ----------------------------------------------------------------------------
-//   Check if the condition applies
+//   Check if the pattern and condition match, using locals if not compiled
 // ----------------------------------------------------------------------------
 {
+    if (matcher.count)
+        return matcher.match(eq, eqsz, from, cond);
+
     size_t match = check_match(eq, eqsz, from, fromsz);
     if (!match || !cond)
         return match;
@@ -1242,21 +1688,89 @@ static size_t check_match(size_t eq, size_t eqsz,
 }
 
 
+void expression::rwheads::index(size_t size)
+// ----------------------------------------------------------------------------
+//   Index the expansion at the top of the stack by outermost object type
+// ----------------------------------------------------------------------------
+{
+    count = 0;
+    valid = false;
+    if (size > MAX_POSITIONS)
+        return;
+
+    // Go backwards so that each position links to the next one
+    for (size_t pos = size; pos--; )
+    {
+        id   ty = rt.stack(pos)->type();
+        uint h  = 0;
+        while (h < count && type[h] != ty)
+            h++;
+        if (h == count)
+        {
+            if (count >= MAX_HEADS)
+                return;
+            type[count] = ty;
+            start[count++] = NONE;
+        }
+        link[pos] = start[h];
+        start[h] = pos;
+    }
+    valid = true;
+}
+
+
+size_t expression::rwheads::first(id ty) const
+// ----------------------------------------------------------------------------
+//   First position with the given outermost type, ID_object for any
+// ----------------------------------------------------------------------------
+{
+    if (!valid || ty == ID_object)
+        return 0;
+    for (uint h = 0; h < count; h++)
+        if (type[h] == ty)
+            return start[h];
+    return NONE;
+}
+
+
+static object::id pattern_head(object_p pattern)
+// ----------------------------------------------------------------------------
+//   Outermost type a sub-expression needs to match a pattern, or ID_object
+// ----------------------------------------------------------------------------
+{
+    object::id ty = pattern->type();
+    if (ty == object::ID_symbol &&
+        symbol_p(pattern)->starts_with("&") == Settings.ExplicitWildcards())
+    {
+        // Symbol wildcards only match symbols, others match anything
+        char cat = tolower(wildcard_category(symbol_p(pattern)));
+        return must_be_symbol(cat) ? object::ID_symbol : object::ID_object;
+    }
+    return ty;
+}
+
+
 expression_p expression::rewrite(expression_r from,
                                  expression_r to,
                                  expression_r cond,
                                  uint        *count,
-                                 bool         down) const
+                                 bool         down,
+                                 rwtarget    *target) const
 // ----------------------------------------------------------------------------
 //   If we match pattern in `from`, then rewrite using pattern in `to`
 // ----------------------------------------------------------------------------
 //   For example, if this equation is `3 + sin(X + Y)`, from is `A + B` and
 //   to is `B + A`, then the output will be `sin(Y + X) + 3`.
 //
+//   If `target` is given, the expression may already be expanded on the
+//   stack by a previous rule, and the expansion of the result is left there
+//   for the next rule. The pattern is expanded on top of the expression.
 {
     // Remember the current stack depth and locals
     size_t       locals   = rt.locals();
-    size_t       depth    = rt.depth();
+    size_t       depth    = target ? target->depth : rt.depth();
+    size_t       expanded = target ? target->size : 0;
+    bool         keep     = false;
 
     // Need a GC pointer since stack operations may move us
     expression_g eq       = this;
@@ -1265,57 +1779,93 @@ expression_p expression::rewrite(expression_r from,
     // Information about part we replace
     bool         replaced = false;
     size_t       matchsz  = 0;
+    size_t       changed  = 0;
     uint         rewrites = Settings.MaxRewrites();
     uint         rwcount  = 0;
+    pattern_matcher matcher;
+    rwheads      local;
+    rwheads     &heads    = target ? target->heads : local;
 
     record(rewrites, "Rewrite %t applying %t->%t cond %t",
            +eq, +from, +to, +cond);
 
     settings::PrepareForProgramEvaluation willRunPrograms;
 
+    // Check that a target left by the previous rule is still there
+    if (expanded && rt.depth() != depth + expanded)
+    {
+        ASSERT(rt.depth() >= depth);
+        rt.drop(rt.depth() - depth);
+        expanded = 0;
+    }
+    if (!expanded)
+        heads.valid = false;
+
     // Loop while there are replacements found
     do
     {
-        // Location of expanded equation
+        // Location of expanded equation, relative to its first object
         size_t eqsz = 0, fromsz = 0;
         size_t eqst = 0, fromst = 0;
 
         replaced = false;
 
-        // Expand 'from' on the stack and remember where it starts
-        if (!from->expand_without_size())
-            goto err;
-        fromsz = rt.depth() - depth;
+        // Expand this equation on the stack unless it is already there
+        if (!expanded)
+        {
+            if (!eq->expand_without_size())
+                goto err;
+            expanded = rt.depth() - depth;
+            heads.index(expanded);
+        }
 
-        // Expand this equation on the stack, and remember where it starts
-        if (!eq->expand_without_size())
+        // Expand 'from' on top of the equation
+        if (!from->expand_without_size())
             goto err;
-        eqsz = rt.depth() - depth - fromsz;
+        fromsz = rt.depth() - depth - expanded;
 
         // Keep checking sub-expressions until we find a match
-        size_t eqlen = eqsz;
-        fromst = eqst + eqsz;
+        size_t eqlen  = expanded;
+        size_t eqbase = fromst + fromsz;
+        id     head   = pattern_head(rt.stack(fromst));
+        matcher.compile(fromst, fromsz);
         if (down)
         {
-            // Check if there is a match in sub-equations going down
-            for (eqsz = eqlen; eqsz; eqst++, eqsz--)
+            // Check if there is a match in sub-equations going down.
+            // Only sub-expressions with the outermost object of the pattern
+            // are checked. The `changed` first positions are those that follow
+            // the last replacement. Sub-expressions there that do not contain
+            // it are unchanged, and we already know that they do not match.
+            for (eqst = heads.first(head);
+                 eqst < eqlen;
+                 eqst = heads.next(eqst, head))
             {
-                matchsz = check_match(eqst, eqsz, fromst, fromsz,
-                                      cond, locals);
+                eqsz = eqlen - eqst;
+                if (eqst < changed &&
+                    eqst + pattern_matcher::argument(eqbase + eqst, eqsz)
+                    <= changed)
+                    continue;
+                if (target)
+                    target->checked++;
+                matchsz = check_match(eqbase + eqst, eqsz, fromst, fromsz,
+                                      cond, locals, matcher);
                 if (matchsz || interrupted())
                     break;
             }
         }
         else
         {
-            size_t eqstart = eqst;
             // Check if there is a match in sub-equations going up
             for (eqsz = fromsz; eqsz <= eqlen; eqsz++)
             {
-                for (eqst = eqstart; eqst + eqsz <= eqlen; eqst++)
+                for (eqst = heads.first(head);
+                     eqst + eqsz <= eqlen;
+                     eqst = heads.next(eqst, head))
                 {
-                    matchsz = check_match(eqst, eqsz, fromst, fromsz,
-                                          cond, locals);
+                    if (target)
+                        target->checked++;
+                    matchsz = check_match(eqbase + eqst, eqsz, fromst, fromsz,
+                                          cond, locals, matcher);
                     if (matchsz || interrupted())
                         break;
                 }
@@ -1326,18 +1876,27 @@ expression_p expression::rewrite(expression_r from,
         if (interrupted())
             break;
 
-        // We don't need the on-stack copies of 'eq' and 'to' anymore
-        ASSERT(rt.depth() >= depth);
-        rt.drop(rt.depth() - depth);
+        // We don't need the on-stack copy of 'from' anymore
+        ASSERT(rt.depth() >= depth + expanded);
+        rt.drop(rt.depth() - depth - expanded);
 
         // If we matched a sub-equation, perform replacement
         if (matchsz)
         {
+            // The expanded equation is about to change
+            rt.drop(expanded);
+            expanded = 0;
+            heads.valid = false;
+
+            // Objects following the match keep their position on the stack
+            changed = down ? eqst : 0;
+
             // We matched from the back of the equation object
             eqst = eqlen - matchsz - eqst;
 
             algebraic_g eqa = build_expr(eq, eqst, to, matchsz, locals,
-                                         rwcount, replaced);
+                                         rwcount, replaced,
+                                         matcher.count ? &matcher : nullptr);
             if (!eqa)
                 goto err;
 
@@ -1361,10 +1920,20 @@ expression_p expression::rewrite(expression_r from,
     if (count)
         *count += rwcount;
 
+    // Leave the expansion of the result for the next rule
+    keep = target != nullptr;
+
 err:
-    ASSERT(rt.depth() >= depth);
-    rt.drop(rt.depth() - depth);
+    if (!keep)
+    {
+        expanded = 0;
+        heads.valid = false;
+    }
+    ASSERT(rt.depth() >= depth + expanded);
+    rt.drop(rt.depth() - depth - expanded);
     rt.unlocals(rt.locals() - locals);
+    if (target)
+        target->size = expanded;
 
     record(rewrites, "%+s rewritten as %t", rwcount ? "Was" : "Not", +eq);
     if (rwcount)
@@ -1375,6 +1944,95 @@ err:
 }
 
 
+// Object types required by rule patterns, each with its own bit in masks.
+// Types are only assigned a bit while indexing rules. Once all bits but
+// the last one are taken, the last bit stands for all other types.
+static object::id rwtypes[expression::RWBITS - 1];
+static byte       rwbits[expression::RWBITS - 1];
+static uint       rwtcount = 0;
+
+
+static expression::rwmask operator_bit(object::id ty, bool assign)
+// ----------------------------------------------------------------------------
+//   Return the mask bit for a given type, assigning one if necessary
+// ----------------------------------------------------------------------------
+{
+    typedef expression::rwmask rwmask;
+    const rwmask other = rwmask(1) << (expression::RWBITS - 1);
+
+    uint lo = 0, hi = rwtcount;
+    while (lo < hi)
+    {
+        uint mid = (lo + hi) / 2;
+        if (rwtypes[mid] < ty)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < rwtcount && rwtypes[lo] == ty)
+        return rwmask(1) << rwbits[lo];
+
+    // A type not in the table is never required by a rule, unless the
+    // table is full, in which case the last bit covers it
+    bool full = rwtcount >= expression::RWBITS - 1;
+    if (!assign || full)
+        return full ? other : 0;
+
+    // Keep types sorted, but bits already given out do not change
+    for (uint i = rwtcount; i > lo; i--)
+    {
+        rwtypes[i] = rwtypes[i - 1];
+        rwbits[i] = rwbits[i - 1];
+    }
+    rwtypes[lo] = ty;
+    rwbits[lo] = rwtcount++;
+    return rwmask(1) << rwbits[lo];
+}
+
+
+expression::rwmask expression::operators(object_p eq, bool pattern)
+// ----------------------------------------------------------------------------
+//   Compute the set of object types present in an expression
+// ----------------------------------------------------------------------------
+//   For a pattern, wildcards are ignored, since they can match anything.
+//   Every other object in a pattern must be found as is in the expression,
+//   so a rule cannot match if one of its bits is missing in the expression.
+//   Each type used in patterns has its own bit, so the only false positives
+//   are for identical types with different values, e.g. 0 and 1.
+{
+    rwmask mask = 0;
+    if (expression_p expr = eq->as<expression>())
+    {
+        bool explicit_wildcards = Settings.ExplicitWildcards();
+        for (object_p obj : *expr)
+        {
+            id ty = obj->type();
+            if (pattern && ty == ID_symbol &&
+                symbol_p(obj)->starts_with("&") == explicit_wildcards)
+                continue;
+            mask |= operator_bit(ty, pattern);
+        }
+    }
+    return mask;
+}
+
+
+void expression::index_rewrites(size_t       size,
+                                const byte_p rewrites[],
+                                uint         stride,
+                                rwmask       masks[])
+// ----------------------------------------------------------------------------
+//   Build the operator index for a set of rewrite rules
+// ----------------------------------------------------------------------------
+//   Rules are indexed while explicit wildcards are disabled, like in
+//   `do_rewrites`, so that all plain symbols in patterns are wildcards
+{
+    settings::SaveExplicitWildcards ewc(false);
+    for (size_t i = 0; i < size; i += stride)
+        masks[i / stride] = operators(object_p(rewrites[i]), true);
+}
+
+
 algebraic_p expression::factor_out(algebraic_g expr,
                                    algebraic_g factor,
                                    algebraic_g &scale,
@@ -3151,12 +3809,289 @@ expression_p expression::as_difference_for_solve() const
 }
 
 
+// ============================================================================
+//
+//   Memoization of expression transformations
+//
+// ============================================================================
+//
+//   The same sub-expressions tend to be simplified or differentiated over
+//   and over, e.g. when isolating or integrating. Results are remembered in
+//   a small direct-mapped table indexed by a content hash of the input.
+//   An entry is only valid for the same transformation, argument, settings
+//   and rewrite hooks. Since rewrites may evaluate variables, storing or
+//   purging a variable forgets the entries that mention its name, and
+//   changing directory forgets the entries that mention a name defined in
+//   the directories entered or left. Expressions referencing local
+//   variables are never memoized. The whole table is flushed when running
+//   low on memory, so that it does not keep objects alive.
+
+struct memo
+// ----------------------------------------------------------------------------
+//   Remember the result of a transformation for a given input
+// ----------------------------------------------------------------------------
+{
+    enum kind : byte { NONE, EXPAND, COLLECT, SIMPLIFY, DERIVATIVE, PRIMITIVE };
+    enum { ENTRIES = 16, MAX_SIZE = 256 };
+
+    struct entry
+    {
+        uint32_t     hash;
+        uint32_t     settings;
+        kind         op;
+        expression_g input;
+        object_g     arg;
+        expression_g output;
+    };
+
+    memo(kind op, expression_p input, object_p arg = nullptr);
+    expression_p lookup() const;
+    expression_p store(expression_p result) const;
+    static bool  flush();
+    static bool  forget(symbol_p name);
+    static bool  forget(directory_p dir);
+
+    kind         op;
+    uint32_t     key;
+    uint32_t     settings;
+    expression_g input;
+    object_g     arg;
+
+    static entry *table;
+};
+
+memo::entry *memo::table = nullptr;
+
+
+memo::memo(kind op, expression_p input, object_p arg)
+// ----------------------------------------------------------------------------
+//   Compute the key for a transformation, NONE if it cannot be memoized
+// ----------------------------------------------------------------------------
+    : op(NONE), key(0), settings(0), input(input), arg(arg)
+{
+    // Evaluating for a specific value of the independent variable (units)
+    if (expression::independent_value)
+        return;
+
+    // For other transformations, the independent variable is an argument
+    if (!arg && expression::independent)
+        this->arg = arg = +*expression::independent;
+
+    size_t isize = input->size();
+    if (isize > MAX_SIZE)
+        return;
+
+    uint32_t h = FNV_BASIS;
+    for (object_p obj : *input)
+    {
+        object::id ty = obj->type();
+        if (ty == object::ID_local || ty == object::ID_funcall)
+            return;
+        h = fnv1a(h, obj, obj->size());
+    }
+    if (arg)
+        h = fnv1a(h, arg, arg->size());
+    h = fnv1a(h, &op, sizeof(op));
+    h = fnv1a(h, &expression::funcall_match, sizeof(expression::funcall_match));
+    h = fnv1a(h, &expression::funcall_build, sizeof(expression::funcall_build));
+
+    this->op = op;
+    this->key = h;
+    this->settings = Settings.hash();
+}
+
+
+expression_p memo::lookup() const
+// ----------------------------------------------------------------------------
+//   Return the memoized result if there is one
+// ----------------------------------------------------------------------------
+{
+    if (!op || !table)
+        return nullptr;
+    entry &e = table[(key ^ settings) % ENTRIES];
+    if (e.op != op || e.hash != key || e.settings != settings)
+        return nullptr;
+    if (!e.input || !e.input->is_same_as(+input))
+        return nullptr;
+    if (+e.arg != +arg && (!e.arg || !arg || !e.arg->is_same_as(+arg)))
+        return nullptr;
+    record(expression, "Memoized %t -> %t", +input, +e.output);
+    return e.output;
+}
+
+
+expression_p memo::store(expression_p result) const
+// ----------------------------------------------------------------------------
+//   Memoize a successful result
+// ----------------------------------------------------------------------------
+{
+    if (!op || !result || rt.error() || program::halted)
+        return result;
+    if (result->size() > MAX_SIZE)
+        return result;
+    if (!table)
+    {
+        // No operator new[] nor operator delete[] in embedded runtime
+        table = (entry *) calloc(ENTRIES, sizeof(entry));
+        if (!table)
+            return result;
+        for (uint i = 0; i < ENTRIES; i++)
+            new(table + i) entry();
+    }
+    entry &e = table[(key ^ settings) % ENTRIES];
+    e.op = op;
+    e.hash = key;
+    e.settings = settings;
+    e.input = input;
+    e.arg = arg;
+    e.output = result;
+    return result;
+}
+
+
+bool memo::flush()
+// ----------------------------------------------------------------------------
+//   Forget all memoized results, return true if anything was freed
+// ----------------------------------------------------------------------------
+{
+    if (!table)
+        return false;
+    bool freed = false;
+    for (uint i = 0; i < ENTRIES; i++)
+    {
+        entry &e = table[i];
+        freed = freed || e.op != NONE;
+        e.op = NONE;
+        e.input = nullptr;
+        e.arg = nullptr;
+        e.output = nullptr;
+    }
+    return freed;
+}
+
+
+static bool mentions(object_p obj, symbol_p name)
+// ----------------------------------------------------------------------------
+//   Check if a memoized object mentions a name
+// ----------------------------------------------------------------------------
+{
+    return obj && name->found_in(obj);
+}
+
+
+static bool mentions(object_p obj, directory_p dir)
+// ----------------------------------------------------------------------------
+//   Check if a memoized object mentions a name defined in a directory
+// ----------------------------------------------------------------------------
+{
+    if (!obj)
+        return false;
+    if (obj->type() == object::ID_symbol)
+        return dir->lookup(obj);
+    if (obj->type() == object::ID_expression)
+        for (object_p item : *expression_p(obj))
+            if (item->type() == object::ID_symbol && dir->lookup(item))
+                return true;
+    return false;
+}
+
+
+bool memo::forget(symbol_p name)
+// ----------------------------------------------------------------------------
+//   Forget memoized results that mention a name
+// ----------------------------------------------------------------------------
+//   Derivatives and primitives with respect to the name do not use its
+//   value, so they are kept when the solver or integration store it.
+{
+    if (!table)
+        return false;
+    bool freed = false;
+    for (uint i = 0; i < ENTRIES; i++)
+    {
+        entry &e = table[i];
+        bool calculus = e.op == DERIVATIVE || e.op == PRIMITIVE;
+        if (calculus && e.arg && e.arg->type() == object::ID_symbol &&
+            symbol_p(+e.arg)->is_same_as(name))
+            continue;
+        if (e.op != NONE && (mentions(+e.input, name) ||
+                             mentions(+e.arg, name)   ||
+                             mentions(+e.output, name)))
+        {
+            freed = true;
+            e.op = NONE;
+            e.input = nullptr;
+            e.arg = nullptr;
+            e.output = nullptr;
+        }
+    }
+    return freed;
+}
+
+
+bool memo::forget(directory_p dir)
+// ----------------------------------------------------------------------------
+//   Forget memoized results that mention a name defined in a directory
+// ----------------------------------------------------------------------------
+{
+    if (!table || !dir)
+        return false;
+    bool freed = false;
+    for (uint i = 0; i < ENTRIES; i++)
+    {
+        entry &e = table[i];
+        if (e.op != NONE && (mentions(+e.input, dir) ||
+                             mentions(+e.arg, dir)   ||
+                             mentions(+e.output, dir)))
+        {
+            freed = true;
+            e.op = NONE;
+            e.input = nullptr;
+            e.arg = nullptr;
+            e.output = nullptr;
+        }
+    }
+    return freed;
+}
+
+
+bool expression::memo_flush()
+// ----------------------------------------------------------------------------
+//   Forget memoized transformations, e.g. when running low on memory
+// ----------------------------------------------------------------------------
+{
+    return memo::flush();
+}
+
+
+bool expression::memo_forget(object_p name)
+// ----------------------------------------------------------------------------
+//   Forget memoized transformations that may depend on a variable
+// ----------------------------------------------------------------------------
+{
+    if (symbol_p sym = name->as_quoted<symbol>())
+        return memo::forget(sym);
+    return memo::flush();
+}
+
+
+bool expression::memo_forget(directory_p dir)
+// ----------------------------------------------------------------------------
+//   Forget memoized transformations that may depend on a directory
+// ----------------------------------------------------------------------------
+{
+    return memo::forget(dir);
+}
+
+
 expression_p expression::expand() const
 // ----------------------------------------------------------------------------
 //   Run various rewrites to expand terms
 // ----------------------------------------------------------------------------
 {
-    return rewrites<DOWN>(
+    memo m(memo::EXPAND, this);
+    if (expression_p cached = m.lookup())
+        return cached;
+    return m.store(rewrites<DOWN>(
         // Compute constants
         A+B,            A+B,
         A-B,            A-B,
@@ -3224,7 +4159,7 @@ expression_p expression::expand() const
         X^one,          X,
 
         // Expansion of powers
-        X^K,            (X^(K-one))*X);
+        X^K,            (X^(K-one))*X));
 }
 
 
@@ -3233,7 +4168,10 @@ expression_p expression::collect() const
 //    Run various rewrites to collect terms (inverse of expand)
 // ----------------------------------------------------------------------------
 {
-    return rewrites<UP>(
+    memo m(memo::COLLECT, this);
+    if (expression_p cached = m.lookup())
+        return cached;
+    return m.store(rewrites<UP>(
         // Collection of powers
         (X^K)*X,        X^(K+one),
         X*(X^K),        X^(K+one),
@@ -3299,7 +4237,7 @@ expression_p expression::collect() const
         A/B,         A/B,
         A*B,         A*B,
         A-B,         A-B,
-        A+B,         A+B);
+        A+B,         A+B));
 }
 
 
@@ -3370,7 +4308,10 @@ expression_p expression::simplify() const
 {
     if (!is_simplifiable())
         return this;
-    return rewrites(
+    memo m(memo::SIMPLIFY, this);
+    if (expression_p cached = m.lookup())
+        return cached;
+    return m.store(rewrites(
         // Compute constant sub-expressions
         A+B,            A+B,
         A*B,            A*B,
@@ -3468,7 +4409,7 @@ expression_p expression::simplify() const
         exp(log(X)),    X,
         log10(exp10(X)),X,
         exp10(log10(X)),X
-        );
+        ));
 }
 
 
@@ -3884,6 +4825,9 @@ expression_p expression::derivative(symbol_r sym) const
 //   Compute the derivative of the
 // ----------------------------------------------------------------------------
 {
+    memo m(memo::DERIVATIVE, this, +sym);
+    if (expression_p cached = m.lookup())
+        return cached;
     save<symbol_g *>       sindep(independent, (symbol_g *) &sym);
     save<object_g *>       sindval(independent_value, nullptr);
     save<uint>             sconstant(constant_index, 0);
@@ -3960,7 +4904,7 @@ expression_p expression::derivative(symbol_r sym) const
     }
     if (result && Settings.AutoSimplify())
         result = result->simplify();
-    return result;
+    return m.store(result);
 }
 
 
@@ -4040,6 +4984,9 @@ expression_p expression::primitive(symbol_r sym) const
 //   Compute the primitive of the
 // ----------------------------------------------------------------------------
 {
+    memo m(memo::PRIMITIVE, this, +sym);
+    if (expression_p cached = m.lookup())
+        return cached;
     save<symbol_g *>       sindep(independent, (symbol_g *) &sym);
     save<object_g *>       sindval(independent_value, nullptr);
     save<uint>             sconstant(constant_index, 0);
@@ -4159,7 +5106,7 @@ expression_p expression::primitive(symbol_r sym) const
     }
     if (result && Settings.AutoSimplify())
         result = result->simplify();
-    return result;
+    return m.store(result);
 }
 
 
@@ -39,6 +39,7 @@ GCP(expression);
 GCP(funcall);
 GCP(grob);
 struct grapher;
+RECORDER_DECLARE(rewrites_stats);
 
 struct expression : program
 // ----------------------------------------------------------------------------
@@ -156,22 +157,26 @@ struct expression : program
                             count);
     }
 
+    struct rwtarget;
     expression_p rewrite(expression_r from,
                          expression_r to,
                          expression_r cond,
                          uint        *count,
-                         bool         down) const;
+                         bool         down,
+                         rwtarget    *target = nullptr) const;
     expression_p rewrite(expression_p from,
                          expression_p to,
                          expression_p cond,
                          uint        *count,
-                         bool         down) const
+                         bool         down,
+                         rwtarget    *target = nullptr) const
     {
         return rewrite(expression_g(from),
                        expression_g(to),
                        expression_g(cond),
                        count,
-                       down);
+                       down,
+                       target);
     }
     static expression_p rewrite(expression_r eq,
                                 expression_r from,
@@ -187,36 +192,122 @@ struct expression : program
     enum rwconds        { ALWAYS,       CONDITIONAL };
     enum rwdir          { DOWN,         UP };
 
+    // Index of the operators and literals that appear in an expression
+    typedef uint64_t rwmask;
+    enum { RWBITS = 8 * sizeof(rwmask) };
+    static rwmask operators(object_p eq, bool pattern);
+    static void   index_rewrites(size_t size, const byte_p rewrites[],
+                                 uint stride, rwmask masks[]);
+
+    struct rwheads
+    // ------------------------------------------------------------------------
+    //   Sub-expressions of an expanded target, indexed by outermost object
+    // ------------------------------------------------------------------------
+    //   In the expansion, each object is the outermost operator of the
+    //   sub-expression that ends with it. Positions are counted from the
+    //   outermost operator of the whole target, like `eqst` in `rewrite`.
+    //   Positions sharing the same type are chained in increasing order.
+    //   Targets too large to index are scanned sequentially.
+    {
+        enum { MAX_POSITIONS = 128, MAX_HEADS = 24, NONE = 0xFFFF };
+
+        rwheads(): count(0), valid(false) {}
+        void   index(size_t size);
+        size_t first(id ty) const;
+        size_t next(size_t pos, id ty) const
+        {
+            return !valid || ty == ID_object ? pos + 1 : link[pos];
+        }
+
+        id       type[MAX_HEADS];       // Outermost types in the target
+        uint16_t start[MAX_HEADS];      // First position for each type
+        uint16_t link[MAX_POSITIONS];   // Next position with the same type
+        uint     count;                 // Number of types
+        bool     valid;                 // Index matches the expansion
+    };
+
+    struct rwtarget
+    // ------------------------------------------------------------------------
+    //   Target of a rule set, kept expanded on the stack between rules
+    // ------------------------------------------------------------------------
+    {
+        rwtarget(): depth(rt.depth()), size(0), checked(0) {}
+        ~rwtarget()
+        {
+            if (rt.depth() > depth)
+                rt.drop(rt.depth() - depth);
+        }
+        size_t  depth;          // Stack depth below the expanded target
+        size_t  size;           // Objects in the expansion, 0 if not expanded
+        uint    checked;        // Sub-expressions checked against rules
+        rwheads heads;          // Index of the expansion by outermost type
+    };
+
     template<rwdir down=DOWN, rwconds conds=ALWAYS, rwrepeat rep=REPEAT>
     expression_p do_rewrites(size_t       size,
                              const byte_p rewrites[],
-                             uint        *count = nullptr) const
+                             uint        *count = nullptr,
+                             const rwmask masks[] = nullptr) const
     // ------------------------------------------------------------------------
     //   Apply a series of rewrites
     // ------------------------------------------------------------------------
+    //   If `masks` is given, it holds for each rule the operators that must
+    //   be present in the expression for the rule to possibly match.
+    //   Rules that cannot match are skipped without expanding anything.
+    //   The expression is only expanded again after a successful rewrite,
+    //   and its index by outermost object is kept with the expansion, so
+    //   that each rule only checks sub-expressions with its outermost object.
     {
+        const uint   stride  = conds ? 3 : 2;
         uint         rwcount = rep ? Settings.MaxRewrites() : 1;
         expression_g eq      = this;
         expression_g last    = nullptr;
         bool         intr    = false;
+        rwmask       present = masks ? operators(this, false) : 0;
+        uint         pass    = 0;
+        rwtarget     target;
         settings::SaveExplicitWildcards ewc(false);
         settings::SaveAutoSimplify as(false);
         do
         {
+            uint tried = 0, matched = 0, rewritten = 0;
             last = eq;
+            target.checked = 0;
 
-            for (size_t i = 0; i < size; i += conds ? 3 : 2)
+            for (size_t i = 0; i < size; i += stride)
             {
+                if (masks)
+                {
+                    rwmask need = masks[i / stride];
+                    if ((need & present) != need)
+                        continue;
+                }
+                tried++;
+                uint done = 0;
                 eq = eq->rewrite(expression_p(rewrites[i+0]),
                                  expression_p(rewrites[i+1]),
                                  expression_p(conds ? rewrites[i+2] : nullptr),
-                                 count, down);
+                                 &done, down, &target);
                 if (!eq)
                     return nullptr;
+                if (done)
+                {
+                    matched++;
+                    rewritten += done;
+                    if (count)
+                        *count += done;
+                    if (masks)
+                        present = operators(eq, false);
+                }
                 intr = program::interrupted();
                 if (intr)
                     break;
             }
+            record(rewrites_stats,
+                   "Pass %u: %u rules, tried %u, matched %u, %u rewrites, "
+                   "%u sub-expressions checked",
+                   ++pass, size / stride, tried, matched, rewritten,
+                   target.checked);
             if (+eq == +last || intr)
                 break;
         } while (--rwcount);
@@ -230,8 +321,17 @@ struct expression : program
               typename ...args>
     expression_p rewrites(args... rest) const
     {
+        const uint stride = conds ? 3 : 2;
         static constexpr byte_p rwdata[] = { rest.as_bytes()... };
-        return do_rewrites<down,conds,rep>(sizeof...(rest), rwdata, nullptr);
+        static rwmask           rwindex[sizeof...(rest) / stride];
+        static bool             indexed = false;
+        if (!indexed)
+        {
+            index_rewrites(sizeof...(rest), rwdata, stride, rwindex);
+            indexed = true;
+        }
+        return do_rewrites<down,conds,rep>(sizeof...(rest), rwdata,
+                                           nullptr, rwindex);
     }
 
 
@@ -265,6 +365,9 @@ struct expression : program
     expression_p isolate(symbol_r sym) const;
     expression_p derivative(symbol_r sym) const;
     expression_p primitive(symbol_r sym) const;
+    static bool  memo_flush();
+    static bool  memo_forget(object_p name);
+    static bool  memo_forget(directory_p dir);
 
     expression_p where(algebraic_r args) const
     {
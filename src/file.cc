@@ -44,6 +44,7 @@ RECORDER(file_error,    16, "File errors");
 
 // The one and only open file in DMCP...
 file *file::current = nullptr;
+uint  file::writes  = 0;
 
 
 // ============================================================================
@@ -140,6 +141,8 @@ void file::open(cstring path, mode wrmode)
     bool reading = wrmode == READING;
     bool append  = wrmode == APPEND;
     writing      = append || wrmode == WRITING;
+    if (writing)
+        writes++;
     previous     = current;
     if (previous)
         previous->close(false);
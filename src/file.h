@@ -68,6 +68,7 @@ struct file
     void    seek(uint offset);
     unicode peek();
     uint    position();
+    uint    size();
     uint    find(unicode cp);
     uint    find(unicode cp1, unicode cp2);
     uint    rfind(unicode cp);
@@ -78,6 +79,7 @@ struct file
 
     static bool    unlink(text_p path);
     static bool    unlink(cstring path);
+    static uint    writes;  // Incremented when a file is opened for writing
     static cstring extension(cstring path);
     static cstring basename(cstring path);
 
@@ -179,4 +181,21 @@ inline bool file::eof()
     return feof(data);
 }
 
+
+inline uint file::size()
+// ----------------------------------------------------------------------------
+//   Return the size of the file
+// ----------------------------------------------------------------------------
+{
+#if SIMULATOR
+    long pos = ftell(data);
+    fseek(data, 0, SEEK_END);
+    long result = ftell(data);
+    fseek(data, pos, SEEK_SET);
+    return result;
+#else
+    return f_size(&data);
+#endif // SIMULATOR
+}
+
 #endif // FILE_H
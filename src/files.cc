@@ -30,6 +30,7 @@
 #include "files.h"
 
 #include "array.h"
+#include "decimal.h"
 #include "dmcp.h"
 #include "file.h"
 #include "grob.h"
@@ -427,37 +428,240 @@ text_p files::recall_text(text_p name) const
 }
 
 
-list_p files::recall_list(text_p name, bool as_array) const
+// ============================================================================
+//
+//   Streaming CSV import
+//
+// ============================================================================
+//   CSV files are read in chunks, and the resulting list or array is built
+//   in place in the scratchpad, then turned into a temporary. Numbers, texts
+//   and empty cells are encoded directly, other cells use the object parser.
+//   Each row is built after the previous ones, and is only moved by the size
+//   of its header once complete, so that memory usage beyond the result is
+//   bounded by about one row.
+
+static const uint CSV_CELL    = 96; // Longer cells are spilled to scratchpad
+static const uint CSV_COLUMNS = 32; // Maximum number of selected columns
+
+
+static inline bool csv_space(byte c)
 // ----------------------------------------------------------------------------
-//  Recall list from a CSV file
+//   Spaces around cells, including the '\r' in DOS files
 // ----------------------------------------------------------------------------
 {
-    file f(filename(name), file::READING);
-    if (!f.valid())
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+static bool csv_header(object::id type, size_t len)
+// ----------------------------------------------------------------------------
+//   Append the header of a text or symbol at end of scratchpad
+// ----------------------------------------------------------------------------
+{
+    byte *p = rt.allocate(leb128size(type) + leb128size(len));
+    if (!p)
+        return false;
+    p = leb128(p, type);
+    p = leb128(p, len);
+    return true;
+}
+
+
+static bool csv_number(utf8 s, size_t len)
+// ----------------------------------------------------------------------------
+//   Encode a simple integer or decimal number directly in scratchpad
+// ----------------------------------------------------------------------------
+//   This returns false for anything that the parser should deal with,
+//   e.g. based numbers, fractions, or more digits than fit in a ularge.
+//   Decimal numbers are built like decimal::do_parse would. The decimal
+//   separator is always '.', even with DecimalComma: a ',' always separates
+//   cells, as in configuration files like config/constants.csv, so it never
+//   reaches this point, and the parser accepts '.' in both modes anyway.
+{
+    bool   neg    = false;
+    bool   dot    = false;
+    bool   isdec  = false;
+    uint   digits = 0;
+    ularge mant   = 0;
+    large  exp    = 0;
+    size_t i      = 0;
+
+    if (len && (s[0] == '-' || s[0] == '+'))
     {
-        if (!rt.error())
-            rt.error(f.error());
-        return nullptr;
+        neg = s[0] == '-';
+        i++;
     }
+    size_t first = i;
+    for (; i < len; i++)
+    {
+        byte c = s[i];
+        if (c >= '0' && c <= '9')
+        {
+            if (mant || c != '0')
+            {
+                if (++digits > 18)
+                    return false;
+                mant = mant * 10 + (c - '0');
+            }
+            if (dot)
+                exp--;
+        }
+        else if (c == '.' && !dot)
+        {
+            dot = isdec = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (i == first || (dot && i == first + 1))
+        return false;
 
-    id       ty     = as_array ? ID_array : ID_list;
-    list_g   result = list::make(ty, nullptr, 0);
-    object_g item   = nullptr;
-    list_g   row    = nullptr;
-    int      cols   = 0;
-    int      kcols  = -1;
-    bool     intxt  = false;
-    bool     ineqn  = false;
-    uint     paren  = 0;
-    uint     brack  = 0;
-    uint     curly  = 0;
-    uint     nonsp  = 0;
+    // Exponent, e.g. 1.5E-3
+    if (i < len)
+    {
+        if (s[i] != 'E' && s[i] != 'e')
+            return false;
+        isdec = true;
+        bool   eneg  = false;
+        large  ev    = 0;
+        size_t estart;
+        if (++i < len && (s[i] == '-' || s[i] == '+'))
+            eneg = s[i++] == '-';
+        for (estart = i; i < len && s[i] >= '0' && s[i] <= '9'; i++)
+            if ((ev = ev * 10 + (s[i] - '0')) > 999999)
+                return false;
+        if (i == estart || i < len)
+            return false;
+        exp += eneg ? -ev : ev;
+    }
 
-    // Loop on the input file and process it as if it was being typed
-    size_t   bytes  = 0;
-    rt.clear();
-    for (unicode c = f.get(); c; c = f.get())
+    if (!isdec)
+    {
+        if (!mant && neg)
+            return false;
+        object::id type = neg ? object::ID_neg_integer : object::ID_integer;
+        byte *p = rt.allocate(leb128size(type) + leb128size(mant));
+        if (!p)
+            return false;
+        p = leb128(p, type);
+        p = leb128(p, mant);
+        return true;
+    }
+
+    // Leave zeros and values exceeding precision to the decimal parser
+    if (!mant || digits > Settings.Precision())
+        return false;
+    while (mant % 10 == 0)
+    {
+        mant /= 10;
+        exp++;
+    }
+    object::id type = neg ? object::ID_neg_decimal : object::ID_decimal;
+    size_t size = decimal::required_memory(type, mant, exp);
+    byte *p = rt.allocate(size);
+    if (!p)
+        return false;
+    new(p) decimal(type, mant, exp);
+    return true;
+}
+
+
+static bool csv_text(utf8 s, size_t len)
+// ----------------------------------------------------------------------------
+//   Encode a quoted text with no embedded quotes directly in scratchpad
+// ----------------------------------------------------------------------------
+{
+    if (len < 2 || s[0] != '"' || s[len-1] != '"')
+        return false;
+    s++;
+    len -= 2;
+    if (memchr(s, '"', len))
+        return false;
+    if (!csv_header(object::ID_text, len))
+        return false;
+    memcpy(rt.scratchpad() - len, s, len);
+    return true;
+}
+
+
+static bool csv_cell(utf8 s, size_t len)
+// ----------------------------------------------------------------------------
+//   Append the object for a cell held in a local buffer to the scratchpad
+// ----------------------------------------------------------------------------
+{
+    while (len && csv_space(s[len-1]))
+        len--;
+    while (len && csv_space(*s))
     {
+        s++;
+        len--;
+    }
+
+    // Empty cells are represented as empty names
+    if (!len)
+        return csv_header(object::ID_symbol, 0);
+    if (csv_number(s, len) || csv_text(s, len))
+        return true;
+    if (rt.error())
+        return false;
+    object_p obj = object::parse(s, len);
+    return obj && rt.append(obj);
+}
+
+
+struct csv_import
+// ----------------------------------------------------------------------------
+//   State of a CSV import, built directly in the scratchpad
+// ----------------------------------------------------------------------------
+{
+    csv_import(object::id type, const uint16_t *select, uint nsel, bool flat)
+        : scr(), type(type), select(select), nsel(nsel), flat(flat),
+          cellsz(0), spill(0), row(0), col(0), kcols(-1), rectangular(true),
+          intxt(false), ineqn(false), paren(0), brack(0), curly(0)
+    {}
+
+    bool     put(byte c);
+    bool     end();
+    list_p   result();
+
+private:
+    bool     selected(uint column) const;
+    bool     store();
+    bool     line();
+    bool     reorder(uint cols);
+    bool     wrap(size_t start, object::id type);
+
+private:
+    scribble        scr;            // Result being built
+    object::id      type;           // Type of the result
+    const uint16_t *select;         // Columns to select, or null
+    uint            nsel;           // Number of columns to select
+    bool            flat;           // Selecting a single column as a vector
+    char            cell[CSV_CELL]; // Current cell
+    uint            cellsz;         // Size in cell buffer
+    size_t          spill;          // Size of cell spilled to scratchpad
+    size_t          row;            // Start of current row in scratchpad
+    uint            col;            // Current column in the file
+    int             kcols;          // Columns in first row
+    bool            rectangular;    // All rows have the same columns
+    bool            intxt;          // Inside a text
+    bool            ineqn;          // Inside an expression
+    uint            paren;          // Nesting of ()
+    uint            brack;          // Nesting of []
+    uint            curly;          // Nesting of {}
+};
+
+
+bool csv_import::put(byte c)
+// ----------------------------------------------------------------------------
+//   Process one input byte
+// ----------------------------------------------------------------------------
+{
+    if (c == '"')
+        intxt = !intxt;
+    else if (!intxt)
         switch(c)
         {
         case '(':       paren++; break;
@@ -466,91 +670,304 @@ list_p files::recall_list(text_p name, bool as_array) const
         case ']':       brack--; break;
         case '{':       curly++; break;
         case '}':       curly--; break;
-        case '"':       intxt = !intxt; break;
         case '\'':      ineqn = !ineqn; break;
         }
-        bool sepok = !paren && !brack && !curly && !intxt && !ineqn;
+    bool sepok = !paren && !brack && !curly && !intxt && !ineqn;
 
-        if (!isspace(c))
-            nonsp++;
-        if (sepok && (c == ',' || c == ';' || c == '\n'))
+    if (sepok && (c == ',' || c == ';' || c == '\n'))
+    {
+        // Blank lines are ignored
+        if (c == '\n' && !col && !spill)
         {
-            text_p parsed = rt.close_editor(true);
-            size_t len    = 0;
-            utf8   txt    = parsed->value(&len);
-            if (nonsp)
-                item = object::parse(txt, len);
-            else
-                item = +symbol::make("");;
-            nonsp = 0;
-            if (!item)
-                break;
-            byte_p b  = byte_p(+item);
-            size_t sz = item->size();
-            list_g li = rt.make<list>(ty, b, sz);
-
-            if (row || c == ';' || c == ',')
+            uint i = 0;
+            while (i < cellsz && csv_space(cell[i]))
+                i++;
+            if (i == cellsz)
             {
-                row = row ? row + li : li;
-                if (c == ';' || c == ',')
-                    cols++;
+                cellsz = 0;
+                return true;
             }
-            if (c == '\n')
+        }
+        if (!store())
+            return false;
+        col++;
+        return c != '\n' || line();
+    }
+
+    // Cells that are too long for the buffer go to the scratchpad
+    if (cellsz >= CSV_CELL)
+    {
+        if (!rt.append(cellsz, byte_p(cell)))
+            return false;
+        spill += cellsz;
+        cellsz = 0;
+    }
+    cell[cellsz++] = c;
+    return true;
+}
+
+
+bool csv_import::end()
+// ----------------------------------------------------------------------------
+//   Process the end of the file, which may lack a final newline
+// ----------------------------------------------------------------------------
+{
+    if (cellsz || spill || col)
+        return put('\n');
+    return true;
+}
+
+
+bool csv_import::selected(uint column) const
+// ----------------------------------------------------------------------------
+//   Check if we keep a given column
+// ----------------------------------------------------------------------------
+{
+    if (!select)
+        return true;
+    for (uint i = 0; i < nsel; i++)
+        if (select[i] == column)
+            return true;
+    return false;
+}
+
+
+bool csv_import::store()
+// ----------------------------------------------------------------------------
+//   Append the object for the current cell, unless it is not selected
+// ----------------------------------------------------------------------------
+{
+    bool keep = selected(col);
+    bool ok   = true;
+    if (spill)
+    {
+        // Long cell: parse it in place, then replace it with the object
+        if (cellsz && !rt.append(cellsz, byte_p(cell)))
+            return false;
+        spill += cellsz;
+        if (keep)
+        {
+            size_t   len = spill;
+            gcutf8   src = rt.scratchpad() - spill;
+            object_g obj = object::parse(src, len);
+            rt.free(spill);
+            ok = obj && rt.append(obj);
+        }
+        else
+        {
+            rt.free(spill);
+        }
+    }
+    else if (keep)
+    {
+        ok = csv_cell(byte_p(cell), cellsz);
+    }
+    cellsz = 0;
+    spill  = 0;
+    return ok;
+}
+
+
+bool csv_import::line()
+// ----------------------------------------------------------------------------
+//   Process the end of a line
+// ----------------------------------------------------------------------------
+{
+    uint cols = col;
+    col = 0;
+
+    if (select)
+    {
+        if (!reorder(cols))
+            return false;
+        cols = nsel;
+    }
+    if (cols > 1 || (select && !flat))
+        if (!wrap(row, type))
+            return false;
+
+    // Check if we have a rectangular input
+    if (kcols < 0)
+        kcols = cols;
+    else if (int(cols) != kcols)
+        rectangular = false;
+    row = scr.growth();
+    return true;
+}
+
+
+bool csv_import::reorder(uint cols)
+// ----------------------------------------------------------------------------
+//   Put the selected cells of a row in the requested order
+// ----------------------------------------------------------------------------
+//   Selected cells were stored in file order, once for each column.
+//   Missing cells in a short row are filled with empty names.
+{
+    bool ordered = select[nsel-1] < cols;
+    for (uint i = 1; ordered && i < nsel; i++)
+        ordered = select[i-1] < select[i];
+    if (ordered)
+        return true;
+
+    size_t old = scr.growth();
+    for (uint i = 0; i < nsel; i++)
+    {
+        uint column = select[i];
+        if (column >= cols)
+        {
+            if (!csv_header(object::ID_symbol, 0))
+                return false;
+            continue;
+        }
+
+        // Rank of the column among the distinct selected columns
+        uint rank = 0;
+        for (uint j = 0; j < nsel; j++)
+        {
+            bool first = true;
+            for (uint k = 0; first && k < j; k++)
+                first = select[k] != select[j];
+            if (first && select[j] < column)
+                rank++;
+        }
+
+        byte_p base = scr.scratch();
+        object_p obj = object_p(base + row);
+        while (rank--)
+            obj = obj->skip();
+        size_t offset = byte_p(obj) - base;
+        size_t size   = obj->size();
+        byte  *copy   = rt.allocate(size);
+        if (!copy)
+            return false;
+        memmove(copy, scr.scratch() + offset, size);
+    }
+
+    byte *base = scr.scratch();
+    memmove(base + row, base + old, scr.growth() - old);
+    rt.free(old - row);
+    return true;
+}
+
+
+bool csv_import::wrap(size_t start, object::id ty)
+// ----------------------------------------------------------------------------
+//   Turn the objects from start to end of scratchpad into a list or array
+// ----------------------------------------------------------------------------
+{
+    size_t payload = scr.growth() - start;
+    size_t hsize   = leb128size(ty) + leb128size(payload);
+    if (!rt.allocate(hsize))
+        return false;
+    byte *p = scr.scratch() + start;
+    memmove(p + hsize, p, payload);
+    p = leb128(p, ty);
+    p = leb128(p, payload);
+    return true;
+}
+
+
+list_p csv_import::result()
+// ----------------------------------------------------------------------------
+//   Build the resulting list or array
+// ----------------------------------------------------------------------------
+{
+    // Rows of different sizes are returned as a list of lists
+    if (!rectangular && type == object::ID_array)
+    {
+        type = object::ID_list;
+        byte *p   = scr.scratch();
+        byte *end = p + scr.growth();
+        while (p < end)
+        {
+            object_p obj = object_p(p);
+            // Both IDs are encoded in a single byte
+            if (obj->type() == object::ID_array)
+                *p = object::ID_list;
+            p = (byte *) obj->skip();
+        }
+    }
+
+    // If the scratchpad holds only our data, convert it in place
+    size_t payload = scr.growth();
+    if (payload == rt.allocated() && !rt.editing())
+    {
+        if (!wrap(0, type))
+            return nullptr;
+        return list_p(rt.temporary());
+    }
+    return rt.make<list>(type, gcbytes(scr.scratch()), payload);
+}
+
+
+list_p files::recall_list(text_p name, bool as_array, object_p columns) const
+// ----------------------------------------------------------------------------
+//  Recall list from a CSV file, optionally selecting some columns
+// ----------------------------------------------------------------------------
+//  Columns can be given as a single 1-based index, which returns a vector,
+//  or as a list of indexes, which returns rows with these columns in order
+{
+    uint16_t select[CSV_COLUMNS];
+    uint     nsel = 0;
+    bool     flat = false;
+    if (columns)
+    {
+        list_p cols = columns->as_array_or_list();
+        flat = !cols;
+        size_t count = flat ? 1 : cols->items();
+        if (!count || count > CSV_COLUMNS)
+        {
+            rt.dimension_error();
+            return nullptr;
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            object_p c     = flat ? columns : cols->at(i);
+            uint32_t index = c ? c->as_uint32(0, true) : 0;
+            if (rt.error())
+                return nullptr;
+            if (!index || index > 0xFFFF)
             {
-                // Check if we have a rectangular input
-                if (kcols < 0)
-                    kcols = cols;
-                if (cols != kcols)
-                {
-                    if (ty != ID_list)
-                    {
-                        ty = ID_list;
-                        list_g copy = list::make(ty, nullptr, 0);
-                        for (object_p obj : *result)
-                        {
-                            list_g ci;
-                            if (list_p li = obj->as_array_or_list())
-                            {
-                                b = byte_p(li->objects(&sz));
-                                ci = list::make(b, sz);
-                                obj = ci;
-                            }
-                            b = byte_p(obj);
-                            ci = list::make(b, obj->size());
-                            copy = copy + ci;
-                        }
-                        if (row)
-                        {
-                            b = byte_p(row->objects(&sz));
-                            row = list::make(b, sz);
-                        }
-                        result = copy;
-                    }
-                }
-                if (row)
-                {
-                    b = byte_p(+row);
-                    sz = row->size();
-                    li = rt.make<list>(ty, b, sz);
-                }
-                result = result + li;
-                row = nullptr;
-                cols = 0;
+                rt.index_error();
+                return nullptr;
             }
-            rt.clear();
-            bytes = 0;
+            select[nsel++] = index - 1;
         }
-        else
+    }
+
+    file f(filename(name), file::READING);
+    if (!f.valid())
+    {
+        if (!rt.error())
+            rt.error(f.error());
+        return nullptr;
+    }
+
+    // Read the file in chunks and process it byte by byte
+    rt.clear();
+    id         ty = as_array ? ID_array : ID_list;
+    csv_import csv(ty, columns ? select : nullptr, nsel, flat);
+    char       buf[64];
+    uint       size = f.size();
+    bool       ok   = true;
+    for (uint done = 0; ok && done < size; )
+    {
+        uint len = size - done < sizeof(buf) ? size - done : sizeof(buf);
+        if (!f.read(buf, len))
         {
-            byte buffer[4];
-            size_t count = utf8_encode(c, buffer);
-            rt.insert(bytes, buffer, count);
-            bytes += count;
+            rt.error(f.error());
+            return nullptr;
         }
+        for (uint i = 0; ok && i < len; i++)
+            ok = csv.put(buf[i]);
+        done += len;
     }
-    if (row)
-        result = result + row;
+    if (ok)
+        ok = csv.end();
 
+    list_p result = ok ? csv.result() : nullptr;
+    if (!result && !rt.error())
+        rt.out_of_memory_error();
     return result;
 }
 
@@ -77,7 +77,8 @@ struct files : text
     object_p recall_binary(text_p name) const;
     object_p recall_source(text_p name) const;
     text_p   recall_text(text_p name) const;
-    list_p   recall_list(text_p name, bool as_array = false) const;
+    list_p   recall_list(text_p name, bool as_array = false,
+                         object_p columns = nullptr) const;
     grob_p   recall_grob(text_p name) const;
 
     // Purge (unlink) a file
@@ -0,0 +1,68 @@
+#ifndef HASH_H
+#define HASH_H
+// ****************************************************************************
+//  hash.h                                                        DB48X project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     FNV-1a hashing, used for cache keys, index files and image checksums
+//
+//     This header only depends on the standard C headers, so that host
+//     tools such as tools/helpindex can share it with the firmware.
+//
+//
+//
+//
+//
+// ****************************************************************************
+//   (C) 2024 Christophe de Dinechin <christophe@dinechin.org>
+//   This software is licensed under the terms outlined in LICENSE.txt
+// ****************************************************************************
+//   This file is part of DB48X.
+//
+//   DB48X is free software: you can redistribute it and/or modify
+//   it under the terms outlined in the LICENSE.txt file
+//
+//   DB48X is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// ****************************************************************************
+
+#include <stddef.h>
+#include <stdint.h>
+
+const uint32_t FNV_BASIS = 2166136261U;
+const uint32_t FNV_PRIME = 16777619U;
+
+
+inline uint32_t fnv1a(uint32_t h, uint8_t c)
+// ----------------------------------------------------------------------------
+//   Add one byte to a FNV-1a hash
+// ----------------------------------------------------------------------------
+{
+    return (h ^ c) * FNV_PRIME;
+}
+
+
+inline uint32_t fnv1a(uint32_t h, const void *data, size_t size)
+// ----------------------------------------------------------------------------
+//   Add some data to a FNV-1a hash
+// ----------------------------------------------------------------------------
+{
+    const uint8_t *p = (const uint8_t *) data;
+    for (size_t i = 0; i < size; i++)
+        h = fnv1a(h, p[i]);
+    return h;
+}
+
+
+inline uint32_t fnv1a(const void *data, size_t size)
+// ----------------------------------------------------------------------------
+//   FNV-1a hash of some data
+// ----------------------------------------------------------------------------
+{
+    return fnv1a(FNV_BASIS, data, size);
+}
+
+#endif // HASH_H
@@ -0,0 +1,79 @@
+#ifndef HELP_INDEX_H
+#define HELP_INDEX_H
+// ****************************************************************************
+//  help_index.h                                                  DB48X project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Format of the binary help index generated by tools/helpindex
+//
+//     The index begins with a header containing a magic number and the
+//     number of entries. Each entry is the hash of a topic followed by
+//     its offset in the help file, with the heading level in the top bits.
+//     Entries are sorted by hash, then by offset, for a binary search.
+//     All values are stored as little-endian 32-bit words.
+//
+// ****************************************************************************
+//   (C) 2024 Christophe de Dinechin <christophe@dinechin.org>
+//   This software is licensed under the terms outlined in LICENSE.txt
+// ****************************************************************************
+//   This file is part of DB48X.
+//
+//   DB48X is free software: you can redistribute it and/or modify
+//   it under the terms outlined in the LICENSE.txt file
+//
+//   DB48X is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// ****************************************************************************
+
+#include "hash.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum help_index_format
+// ----------------------------------------------------------------------------
+//   Layout of the help index file
+// ----------------------------------------------------------------------------
+{
+    HELP_INDEX_MAGIC    = 0x58444948,   // "HIDX" as little-endian
+    HELP_INDEX_HEADER   = 8,            // Magic and number of entries
+    HELP_INDEX_ENTRY    = 8,            // Hash and position
+    HELP_INDEX_LEVEL    = 28,           // Shift for the heading level
+    HELP_INDEX_OFFSET   = (1 << HELP_INDEX_LEVEL) - 1,
+    HELP_INDEX_TOPIC    = 80,           // Maximum topic length
+};
+
+
+inline uint32_t help_index_word(const uint8_t *p)
+// ----------------------------------------------------------------------------
+//   Read a little-endian 32-bit word
+// ----------------------------------------------------------------------------
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+
+inline uint32_t help_index_hash(const uint8_t *topic, size_t len)
+// ----------------------------------------------------------------------------
+//   Hash a topic the way help links are compared
+// ----------------------------------------------------------------------------
+//   Links are case-insensitive and a '-' in a link matches a space in
+//   the topic, so hash lowercase letters and turn '-' into a space.
+{
+    uint32_t h = FNV_BASIS;
+    for (size_t i = 0; i < len; i++)
+    {
+        uint8_t c = topic[i];
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        else if (c == '-')
+            c = ' ';
+        h = fnv1a(h, c);
+    }
+    return h;
+}
+
+#endif // HELP_INDEX_H
@@ -32,6 +32,7 @@
 #include "algebraic.h"
 #include "arithmetic.h"
 #include "compare.h"
+#include "compiled.h"
 #include "equations.h"
 #include "expression.h"
 #include "functions.h"
@@ -96,28 +97,56 @@ NFUNCTION_BODY(Integrate)
 }
 
 
+static uint evaluations = 0;
+
+
+struct integrator
+// ----------------------------------------------------------------------------
+//   State shared by the various integration algorithms
+// ----------------------------------------------------------------------------
+{
+    integrator(program_r eq, algebraic_r eps)
+        : eq(eq), code(eq), eps(eps), max(Settings.IntegrationIterations()),
+          converged(true)
+    {
+        evaluations = 0;
+    }
+
+    algebraic_p f(algebraic_r x)
+    {
+        evaluations++;
+        return code.evaluate(eq, x);
+    }
+
+    algebraic_p romberg(algebraic_r lx, algebraic_r hx);
+    algebraic_p gauss_kronrod(algebraic_r lx, algebraic_r hx);
+    algebraic_p tanh_sinh(algebraic_r lx, algebraic_r hx);
+
+protected:
+    algebraic_p kronrod(algebraic_r lx, algebraic_r hx, algebraic_g &err);
+    algebraic_p adapt(algebraic_r lx, algebraic_r hx, algebraic_r tol,
+                      uint depth);
+
+protected:
+    program_g           eq;
+    compiled_expression code;
+    algebraic_g         eps;
+    uint                max;
+    bool                converged;
+    algebraic_g         xgk[8], wgk[8], wg[4];
+};
+
+
 algebraic_p integrate(program_g   eq,
                       symbol_g    name,
                       algebraic_g lx,
                       algebraic_g hx)
 // ----------------------------------------------------------------------------
-//   Romberg algorithm - The core of the integration function
+//   The core of the integration function, select the algorithm to use
 // ----------------------------------------------------------------------------
-//   The Romberg algorithm uses two buffers, one keeping the approximations
-//   from the previous loop, called P, and one for the current loop, called C.
-//   At each step, the size of C is one more than P.
-//   In the implementation below, those arrays are on the stack, P above C.
 {
     // We will run commands below, do not save stack while doing it
     settings::PrepareForProgramEvaluation wilLRunPrograms;
-
-    // Check if the guess is an algebraic or if we need to extract one
-    algebraic_g x, dx, dx2;
-    algebraic_g y, dy, sy, sy2;
-    algebraic_g one  = integer::make(1);
-    algebraic_g two  = integer::make(2);
-    algebraic_g four = integer::make(4);
-    algebraic_g pow4;
     record(integrate, "Initial range %t-%t", +lx, +hx);
 
     // Set independent variable
@@ -129,17 +158,52 @@ algebraic_p integrate(program_g   eq,
     // Select numerical computations (doing this with fraction is slow)
     settings::SaveNumericalResults snr(true);
 
+    // Select the integration algorithm
+    integrator  integ(eq, eps);
+    algebraic_g result;
+    switch (Settings.IntegrationMethod())
+    {
+    case object::ID_GaussKronrodIntegration:
+        result = integ.gauss_kronrod(lx, hx);
+        break;
+    case object::ID_TanhSinhIntegration:
+        result = integ.tanh_sinh(lx, hx);
+        break;
+    default:
+        result = integ.romberg(lx, hx);
+        break;
+    }
+    record(integrate, "Result %t after %u evaluations", +result, evaluations);
+    return result;
+}
+
+
+algebraic_p integrator::romberg(algebraic_r lx, algebraic_r hx)
+// ----------------------------------------------------------------------------
+//   Romberg algorithm
+// ----------------------------------------------------------------------------
+//   The Romberg algorithm uses two buffers, one keeping the approximations
+//   from the previous loop, called P, and one for the current loop, called C.
+//   At each step, the size of C is one more than P.
+//   In the implementation below, those arrays are on the stack, P above C.
+{
+    algebraic_g x, dx, dx2;
+    algebraic_g y, dy, sy, sy2;
+    algebraic_g one  = integer::make(1);
+    algebraic_g two  = integer::make(2);
+    algebraic_g four = integer::make(4);
+    algebraic_g pow4;
+
     // Initial integration step and first trapezoidal step
     dx              = hx - lx;
-    sy              = algebraic::evaluate_function(eq, lx);
-    sy2             = algebraic::evaluate_function(eq, hx);
+    sy              = f(lx);
+    sy2             = f(hx);
     sy              = (sy + sy2) * dx / two;
     if (!dx || !sy)
         return nullptr;
 
     // Loop for a maximum number of conversion iterations
     size_t loops = 1;
-    uint   max   = Settings.IntegrationIterations();
 
     // Depth of the original stack, to return to after computation
     size_t depth = rt.depth();
@@ -161,7 +225,7 @@ algebraic_p integrate(program_g   eq,
                 goto error;
 
             // Evaluate equation
-            y  = algebraic::evaluate_function(eq, x);
+            y  = f(x);
 
             // Sum elements, and approximate when necessary
             sy = sy + y;
@@ -240,3 +304,329 @@ error:
     rt.drop(rt.depth() - depth);
     return nullptr;
 }
+
+
+// Gauss-Kronrod 7-15 nodes and weights, symmetric around 0, to 40 digits
+static cstring gk_nodes[8] =
+{
+    "0.9914553711208126392068546975263285166420",
+    "0.9491079123427585245261896840478512624008",
+    "0.8648644233597690727897127886409262012110",
+    "0.7415311855993944398638647732807884070741",
+    "0.5860872354676911302941448382587295984368",
+    "0.4058451513773971669066064120769614633474",
+    "0.2077849550078984676006894037732449134798",
+    "0",
+};
+
+static cstring gk_weights[8] =
+{
+    "0.0229353220105292249637320080589695919936",
+    "0.0630920926299785532907006631892042866651",
+    "0.1047900103222501838398763225415180174438",
+    "0.1406532597155259187451895905102379203999",
+    "0.1690047266392679028265834265985502841062",
+    "0.1903505780647854099132564024210136828261",
+    "0.2044329400752988924141619992346490847165",
+    "0.2094821410847278280129991748917142636978",
+};
+
+// Weights of the 7-point Gauss rule, which uses the odd Kronrod nodes
+static cstring gauss_weights[4] =
+{
+    "0.1294849661688696932706114326790820183286",
+    "0.2797053914892766679014677714237795824869",
+    "0.3818300505051189449503697754889751338784",
+    "0.4179591836734693877551020408163265306122",
+};
+
+// Beyond that precision, the tables above are not precise enough
+static const uint GK_PRECISION = 38;
+
+
+static algebraic_p gk_constant(cstring text)
+// ----------------------------------------------------------------------------
+//   Parse one of the constants in the tables above
+// ----------------------------------------------------------------------------
+{
+    size_t len = strlen(text);
+    if (object_p obj = object::parse(utf8(text), len))
+        return obj->as_algebraic();
+    return nullptr;
+}
+
+
+algebraic_p integrator::gauss_kronrod(algebraic_r lx, algebraic_r hx)
+// ----------------------------------------------------------------------------
+//   Adaptive Gauss-Kronrod integration with interval bisection
+// ----------------------------------------------------------------------------
+//   Each interval is integrated with the 15-point Kronrod rule, and the
+//   embedded 7-point Gauss rule reuses half of the same evaluations to give
+//   an error estimate. Intervals where the two disagree are split in two.
+{
+    if (Settings.Precision() > GK_PRECISION)
+        return tanh_sinh(lx, hx);
+
+    for (uint i = 0; i < 8; i++)
+    {
+        xgk[i] = gk_constant(gk_nodes[i]);
+        wgk[i] = gk_constant(gk_weights[i]);
+        if (!xgk[i] || !wgk[i])
+            return nullptr;
+    }
+    for (uint i = 0; i < 4; i++)
+        if (!(wg[i] = gk_constant(gauss_weights[i])))
+            return nullptr;
+
+    algebraic_g err;
+    algebraic_g result = kronrod(lx, hx, err);
+    if (!result || !err)
+        return nullptr;
+    if (!err->is_zero(false))
+    {
+        algebraic_g tol = abs::run(result) * eps;
+        if (!tol || !smaller_magnitude(err, tol))
+            result = adapt(lx, hx, tol, 0);
+    }
+    if (result && !converged)
+    {
+        rt.precision_loss_error();
+        result = nullptr;
+    }
+    return result;
+}
+
+
+algebraic_p integrator::kronrod(algebraic_r lx,
+                                algebraic_r hx,
+                                algebraic_g &err)
+// ----------------------------------------------------------------------------
+//   Apply the Gauss-Kronrod 7-15 rule on an interval, return error estimate
+// ----------------------------------------------------------------------------
+{
+    algebraic_g two = integer::make(2);
+    algebraic_g c   = (lx + hx) / two;
+    algebraic_g h   = (hx - lx) / two;
+    algebraic_g y   = f(c);
+    if (!c || !h || !y)
+        return nullptr;
+
+    algebraic_g k = wgk[7] * y;
+    algebraic_g g = wg[3] * y;
+    algebraic_g dx, s;
+    for (uint j = 0; j < 7; j++)
+    {
+        dx = h * xgk[j];
+        dx = c - dx;
+        s  = f(dx);
+        dx = c + h * xgk[j];
+        y  = f(dx);
+        s  = s + y;
+        k  = k + wgk[j] * s;
+        if (j & 1)
+            g = g + wg[j / 2] * s;
+        if (!k || !g)
+            return nullptr;
+    }
+    k = k * h;
+    g = g * h;
+    err = k - g;
+    err = abs::run(err);
+    record(integrate, "Kronrod %t-%t = %t error %t", +lx, +hx, +k, +err);
+    return k;
+}
+
+
+algebraic_p integrator::adapt(algebraic_r lx,
+                              algebraic_r hx,
+                              algebraic_r tol,
+                              uint        depth)
+// ----------------------------------------------------------------------------
+//   Split the interval in two and integrate each half to half the tolerance
+// ----------------------------------------------------------------------------
+{
+    if (program::interrupted())
+    {
+        converged = false;
+        return nullptr;
+    }
+
+    algebraic_g two  = integer::make(2);
+    algebraic_g mid  = (lx + hx) / two;
+    algebraic_g htol = tol / two;
+    algebraic_g lerr, herr;
+    if (!mid || !htol || !algebraic::to_decimal_if_big(mid))
+        return nullptr;
+
+    algebraic_g low  = kronrod(lx, mid, lerr);
+    if (!low)
+        return nullptr;
+    algebraic_g high = kronrod(mid, hx, herr);
+    if (!high)
+        return nullptr;
+
+    bool last = depth + 1 >= max;
+    if (!smaller_magnitude(lerr, htol) && !lerr->is_zero(false))
+    {
+        if (last)
+            converged = false;
+        else if (!(low = adapt(lx, mid, htol, depth + 1)))
+            return nullptr;
+    }
+    if (!smaller_magnitude(herr, htol) && !herr->is_zero(false))
+    {
+        if (last)
+            converged = false;
+        else if (!(high = adapt(mid, hx, htol, depth + 1)))
+            return nullptr;
+    }
+    return low + high;
+}
+
+
+algebraic_p integrator::tanh_sinh(algebraic_r lx, algebraic_r hx)
+// ----------------------------------------------------------------------------
+//   Tanh-sinh (double exponential) quadrature
+// ----------------------------------------------------------------------------
+//   The variable change x = tanh(π/2·sinh t) clusters the samples near the
+//   ends of the interval with weights decreasing double-exponentially, which
+//   deals well with singularities at the end points. With q = exp(-π·sinh t),
+//   the distance to the end point is (b-a)·q/(1+q), and the weight of the
+//   two points at ±t is π·h·(b-a)·cosh t·q/(1+q)^2.
+//   Each level halves the step h, and only evaluates the new odd points,
+//   reusing the sum computed at the previous levels.
+//   Sampling stops when a sample would land on an end point, or when the
+//   terms become negligible, which may require q to be well below 10^-prec
+//   for integrands like 1/sqrt(x). Samples closer to the end points than
+//   10^-(prec/2) are computed with twice the precision, so that x=b-d does
+//   not round to b and 1-x² in 1/sqrt(1-x²) does not lose all its digits.
+//   When samples would still land on an end point while terms are still
+//   significant, the result cannot be more precise than the missing terms.
+{
+    algebraic_g one   = integer::make(1);
+    algebraic_g two   = integer::make(2);
+    algebraic_g pi    = algebraic::pi();
+    algebraic_g width = hx - lx;
+    uint        prec  = Settings.Precision();
+    uint        xprec = 2 * prec < DB48X_MAXDIGITS ? 2 * prec : DB48X_MAXDIGITS;
+    algebraic_g qmin  = decimal::make(1, -3 * int(prec));
+    algebraic_g qnear = decimal::make(1, -int(prec / 2));
+    algebraic_g h     = one;
+    algebraic_g mid   = (lx + hx) / two;
+    algebraic_g sum   = f(mid);
+    algebraic_g last, result, t, et, q, d, w, x, y, tail;
+    algebraic_g term[2];
+    if (!pi || !width || !qmin || !qnear || !sum)
+        return nullptr;
+
+    // The middle point has weight 1/4 with the normalization above
+    sum = sum / integer::make(4);
+
+    for (uint level = 0; level <= max; level++)
+    {
+        if (program::interrupted())
+            break;
+
+        // At level 0, use all t=k·h, then only odd multiples of h
+        uint step   = level ? 2 : 1;
+        uint active = 3;                        // Left and right sides
+        tail = integer::make(0);
+        term[0] = term[1] = tail;
+        for (uint k = 1; active; k += step)
+        {
+            t  = integer::make(k) * h;
+            et = exp::run(t);
+            if (!et)
+                return nullptr;
+            y  = one / et;
+            q  = pi * (et - y) / two;           // π·sinh t
+            w  = (et + y) / two;                // cosh t
+            q  = exp::run(-q);
+            if (!q || !w)
+                return nullptr;
+            if (smaller_magnitude(q, qmin))
+                break;
+            d  = one + q;
+            w  = w * q / (d * d);
+            d  = width * q / d;
+            if (!w || !d)
+                return nullptr;
+            bool near = smaller_magnitude(q, qnear);
+
+            for (uint side = 0; side < 2; side++)
+            {
+                uint bit = 1 << side;
+                if (~active & bit)
+                    continue;
+
+                // Compute samples close to the end points with more digits
+                {
+                    settings::SavePrecision sprec(near ? xprec : prec);
+
+                    // Stop if we would evaluate at one of the end points
+                    algebraic_r end = side ? hx : lx;
+                    x = side ? end - d : end + d;
+                    y = x - end;
+                    if (!y)
+                        return nullptr;
+                    if (y->is_zero(false))
+                    {
+                        // Remember the size of the terms we could not add
+                        if (smaller_magnitude(tail, term[side]))
+                            tail = term[side];
+                        active &= ~bit;
+                        continue;
+                    }
+
+                    y = f(x);
+                    if (!y)
+                        return nullptr;
+                }
+                y = w * y;
+                term[side] = y;
+                sum = sum + y;
+                if (!sum || !algebraic::to_decimal_if_big(sum))
+                    return nullptr;
+
+                // Stop when far enough and terms do not contribute anymore
+                if (smaller_magnitude(q, eps) &&
+                    smaller_magnitude(y, sum * eps))
+                    active &= ~bit;
+            }
+        }
+
+        // Scale the sum to get the estimate at this level
+        result = pi * h * width * sum;
+        record(integrate, "Tanh-sinh level %u h=%t result %t",
+               level, +h, +result);
+        if (!result)
+            return nullptr;
+        if (level > 0)
+        {
+            // The achievable accuracy is limited by the size of the terms
+            // we could not compute because they are too close to the ends
+            x = result - last;
+            y = pi * h * width * tail * two;
+            if (x->is_zero(false) || smaller_magnitude(x, result * eps) ||
+                smaller_magnitude(x, y))
+                return result;
+        }
+        last = result;
+        h = h / two;
+    }
+
+    rt.precision_loss_error();
+    return nullptr;
+}
+
+
+COMMAND_BODY(IntegrationEvaluations)
+// ----------------------------------------------------------------------------
+//   Return the number of evaluations for the last numerical integration
+// ----------------------------------------------------------------------------
+{
+    if (integer_p count = integer::make(evaluations))
+        if (rt.push(count))
+            return OK;
+    return ERROR;
+}
@@ -45,4 +45,6 @@ NFUNCTION(Integrate, 4,
           }
     );
 
+COMMAND_DECLARE(IntegrationEvaluations, 0);
+
 #endif // INTEGRATE_H
@@ -1265,7 +1265,204 @@ COMMAND_BODY(Tail)
 }
 
 
-static object::result map_reduce_filter(object_p (list::*cmd)(object_p) const)
+// ============================================================================
+//
+//   Fused list pipelines
+//
+// ============================================================================
+//   A sequence like `« f » MAP « g » FILTER « h » REDUCE` in a program would
+//   normally build a complete intermediate list for each step. When such a
+//   sequence is found in the running program, MAP or FILTER absorbs the
+//   following `« ... » MAP|FILTER|REDUCE` pairs, and each element is streamed
+//   through all the stages, so that only the final result is built.
+
+struct list_pipeline
+// ----------------------------------------------------------------------------
+//   A sequence of MAP and FILTER stages, optionally terminated by REDUCE
+// ----------------------------------------------------------------------------
+{
+    enum stage_kind { MAP, FILTER, REDUCE };
+    enum { MAX_STAGES = 8 };
+
+    list_pipeline(): stages(0), kind(), programs() {}
+
+    void        add(stage_kind k, object_p prg);
+    void        absorb();
+    object_p    run(list_p source);
+
+private:
+    bool        transform(object_g &obj, uint first, uint last);
+    list_p      collect(list_p source, uint first, uint last);
+
+private:
+    uint        stages;
+    stage_kind  kind[MAX_STAGES];
+    object_g    programs[MAX_STAGES];
+};
+
+
+void list_pipeline::add(stage_kind k, object_p prg)
+// ----------------------------------------------------------------------------
+//   Add a stage to the pipeline
+// ----------------------------------------------------------------------------
+{
+    kind[stages] = k;
+    programs[stages] = prg;
+    stages++;
+}
+
+
+void list_pipeline::absorb()
+// ----------------------------------------------------------------------------
+//   Absorb the `« ... » MAP` sequences that immediately follow in the program
+// ----------------------------------------------------------------------------
+//   We only do this if the command being executed comes right before the
+//   next object in the current code block, i.e. it was fetched by run_loop
+{
+    if (!Settings.ListPipelines() || program::stepping || program::halted)
+        return;
+    object_p cmd = rt.command();
+    if (!cmd || cmd->skip() != rt.run_peek())
+        return;
+
+    while (stages < MAX_STAGES && kind[stages - 1] != REDUCE)
+    {
+        object_p prg  = rt.run_peek(0);
+        object_p next = rt.run_peek(1);
+        if (!prg || !next || prg->type() != object::ID_program)
+            return;
+
+        stage_kind k;
+        switch(next->type())
+        {
+        case object::ID_Map:    k = MAP;        break;
+        case object::ID_Filter: k = FILTER;     break;
+        case object::ID_Reduce: k = REDUCE;     break;
+        default:                return;
+        }
+        record(list, "Pipeline stage %u %+s %t",
+               stages, k == MAP ? "map" : k == FILTER ? "filter" : "reduce",
+               prg);
+        add(k, prg);
+        if (!rt.run_skip(2))
+            return;
+    }
+}
+
+
+bool list_pipeline::transform(object_g &obj, uint first, uint last)
+// ----------------------------------------------------------------------------
+//   Run an element through stages, set it to nullptr if filtered out
+// ----------------------------------------------------------------------------
+{
+    size_t depth = rt.depth();
+    for (uint s = first; obj && s < last; s++)
+    {
+        if (obj->is_array_or_list())
+        {
+            // Like MAP and FILTER, apply remaining stages to sublists
+            obj = collect(list_p(+obj), s, last);
+            return +obj != nullptr;
+        }
+
+        if (!rt.push(obj))
+            return false;
+        if (program::run(programs[s], true) != object::OK)
+            return false;
+        if (rt.depth() != depth + 1)
+        {
+            rt.misbehaving_program_error();
+            return false;
+        }
+        object_p result = rt.pop();
+        if (kind[s] == MAP)
+        {
+            obj = result;
+        }
+        else
+        {
+            bool keep = result->as_truth(true);
+            if (rt.error())
+                return false;
+            if (!keep)
+                obj = nullptr;
+        }
+    }
+    return true;
+}
+
+
+list_p list_pipeline::collect(list_p source, uint first, uint last)
+// ----------------------------------------------------------------------------
+//   Stream elements of a list through the stages and collect the result
+// ----------------------------------------------------------------------------
+{
+    object::id ty = source->type();
+    scribble   scr;
+    for (object_p item : *source)
+    {
+        object_g obj = item;
+        if (!transform(obj, first, last))
+            return nullptr;
+        if (obj && !rt.append(obj))
+            return nullptr;
+    }
+    return list::make(ty, scr.scratch(), scr.growth());
+}
+
+
+object_p list_pipeline::run(list_p source)
+// ----------------------------------------------------------------------------
+//   Run the whole pipeline on the given list
+// ----------------------------------------------------------------------------
+{
+    size_t depth = rt.depth();
+    if (kind[stages - 1] != REDUCE)
+    {
+        if (list_p result = collect(source, 0, stages))
+            return result;
+        goto error;
+    }
+    else
+    {
+        // The accumulator for REDUCE stays on the stack
+        uint     last    = stages - 1;
+        object_g reducer = programs[last];
+        bool     empty   = true;
+        for (object_p item : *source)
+        {
+            object_g obj = item;
+            if (!transform(obj, 0, last))
+                goto error;
+            if (!obj)
+                continue;
+            if (!rt.push(obj))
+                goto error;
+            if (empty)
+            {
+                empty = false;
+                continue;
+            }
+            if (program::run(reducer, true) != object::OK)
+                goto error;
+            if (rt.depth() != depth + 1)
+            {
+                rt.misbehaving_program_error();
+                goto error;
+            }
+        }
+        if (!empty)
+            return rt.pop();
+    }
+
+error:
+    if (rt.depth() > depth)
+        rt.drop(rt.depth() - depth);
+    return nullptr;
+}
+
+
+static object::result map_reduce_filter(list_pipeline::stage_kind kind)
 // ----------------------------------------------------------------------------
 //   Shared code for map, reduce and filter
 // ----------------------------------------------------------------------------
@@ -1273,9 +1470,13 @@ static object::result map_reduce_filter(object_p (list::*cmd)(object_p) const)
     size_t   depth = rt.depth();
     object_p obj   = rt.stack(1);
     object_g prg   = rt.top();
-    if (list_p li = obj->as_array_or_list())
+    if (list_g li = obj->as_array_or_list())
     {
-        object_p result = (li->*cmd)(prg);
+        list_pipeline pipeline;
+        pipeline.add(kind, prg);
+        if (kind != list_pipeline::REDUCE)
+            pipeline.absorb();
+        object_p result = pipeline.run(li);
         if (!result)
             goto error;
         if (rt.drop() && rt.top(result))
@@ -1297,7 +1498,7 @@ COMMAND_BODY(Map)
 //   Apply unary function in level 1 to all elements in level 2
 // ----------------------------------------------------------------------------
 {
-    return map_reduce_filter(&list::map_as_object);
+    return map_reduce_filter(list_pipeline::MAP);
 }
 
 
@@ -1306,7 +1507,7 @@ COMMAND_BODY(Reduce)
 //   Apply binary function in level 1 pairwise to combine elements in level 2
 // ----------------------------------------------------------------------------
 {
-    return map_reduce_filter(&list::reduce);
+    return map_reduce_filter(list_pipeline::REDUCE);
 }
 
 
@@ -1315,7 +1516,7 @@ COMMAND_BODY(Filter)
 //   Filter the function in level 1 to all elements in level 2
 // ----------------------------------------------------------------------------
 {
-    return map_reduce_filter(&list::filter_as_object);
+    return map_reduce_filter(list_pipeline::FILTER);
 }
 
 
@@ -1415,53 +1616,6 @@ list_p list::tail() const
 }
 
 
-list_p list::map(object_p prgobj) const
-// ----------------------------------------------------------------------------
-//   Apply an RPL object (nominally a program) on all elements in the list
-// ----------------------------------------------------------------------------
-{
-    id       ty    = type();
-    object_g prg   = prgobj;
-    size_t   depth = rt.depth();
-    scribble scr;
-    for (object_p obj : *this)
-    {
-        id oty = obj->type();
-        if (is_array_or_list(oty))
-        {
-            list_g sub = list_p(obj)->map(prg);
-            obj = +sub;
-        }
-        else
-        {
-            if (!rt.push(obj))
-                goto error;
-            if (program::run(prg, true) != OK)
-                goto error;
-            if (rt.depth() != depth + 1)
-            {
-                rt.misbehaving_program_error();
-                goto error;
-            }
-            obj = rt.pop();
-        }
-        if (!obj)
-            goto error;
-
-        if (!rt.append(obj))
-            goto error;
-    }
-
-    return list::make(ty, scr.scratch(), scr.growth());
-
-error:
-    if (rt.depth() > depth)
-        rt.drop(rt.depth() - depth);
-    return nullptr;
-
-}
-
-
 object_p list::reduce(object_p prgobj) const
 // ----------------------------------------------------------------------------
 //   Apply an RPL object (nominally a program) on pairs of list elements
@@ -1500,55 +1654,6 @@ error:
 }
 
 
-list_p list::filter(object_p prgobj) const
-// ----------------------------------------------------------------------------
-//   Apply an RPL object (nominally a program) to filter elements in a list
-// ----------------------------------------------------------------------------
-{
-    id       ty    = type();
-    object_g prg   = prgobj;
-    size_t   depth = rt.depth();
-    scribble scr;
-    for (object_g obj : *this)
-    {
-        id   oty  = obj->type();
-        bool keep = false;
-        if (is_array_or_list(oty))
-        {
-            object_g sub = list_p(+obj)->filter(prg);
-            obj = +sub;
-            keep = true;
-        }
-        else
-        {
-            if (!rt.push(obj))
-                goto error;
-            if (program::run(prg, true) != OK)
-                goto error;
-            if (rt.depth() != depth + 1)
-            {
-                rt.misbehaving_program_error();
-                goto error;
-            }
-            object_p test = rt.pop();
-            keep = test->as_truth(true);
-            if (rt.error())
-                goto error;
-        }
-
-        if (keep && !rt.append(obj))
-            goto error;
-    }
-
-    return list::make(ty, scr.scratch(), scr.growth());
-
-error:
-    if (rt.depth() > depth)
-        rt.drop(rt.depth() - depth);
-    return nullptr;
-}
-
-
 list_p list::pair_map(object_p prgobj) const
 // ----------------------------------------------------------------------------
 //   Apply an RPL object (nominally a program) to combine successive elements
@@ -1745,60 +1850,229 @@ int value_compare(object_p *xp, object_p *yp)
 }
 
 
-static int value_compare_reverse(object_p *xp, object_p *yp)
+struct list_sorter
+// ----------------------------------------------------------------------------
+//   Stable merge sort of list items using precomputed sort keys
+// ----------------------------------------------------------------------------
+//   Each item gets an entry in the scratchpad holding the offset of the item
+//   in its list, the offset of its key in the key list, and, when the key is
+//   an integer or hardware floating-point value, the native key value.
+//   Entry indexes are then sorted with a bottom-up merge sort, which only
+//   falls back to object comparisons for non-native keys.
+//   Since a comparison may cause a garbage collection, which moves both the
+//   lists and the scratchpad, everything is addressed by offset.
+{
+    typedef int (*compare_fn)(object_p *x, object_p *y);
+
+    list_sorter(list_p items, list_p keys, compare_fn cmp, int dir, bool native)
+        : scr(), items(items), keys(keys), cmp(cmp), dir(dir), count(0),
+          native(native) {}
+
+    list_p sort();
+
+private:
+    enum key_kind : byte { OBJECT, INTEGER, FLOAT };
+    struct entry
+    {
+        uint32_t item;
+        uint32_t key;
+        key_kind kind;
+        union
+        {
+            int64_t  i;
+            double   d;
+        };
+    };
+
+    entry get(size_t r)
+    {
+        entry result;
+        memcpy(&result, scr.scratch() + r * sizeof(entry), sizeof(entry));
+        return result;
+    }
+    void put(size_t r, const entry &value)
+    {
+        memcpy(scr.scratch() + r * sizeof(entry), &value, sizeof(entry));
+    }
+    byte *index_address(uint buffer, size_t i)
+    {
+        return scr.scratch() + count * sizeof(entry)
+            + (buffer * count + i) * sizeof(uint32_t);
+    }
+    uint32_t index(uint buffer, size_t i)
+    {
+        uint32_t result;
+        memcpy(&result, index_address(buffer, i), sizeof(result));
+        return result;
+    }
+    void index(uint buffer, size_t i, uint32_t value)
+    {
+        memcpy(index_address(buffer, i), &value, sizeof(value));
+    }
+
+    void native_key(object_p key, entry &r);
+    int  compare(uint32_t x, uint32_t y);
+
+private:
+    scribble   scr;
+    list_g     items;
+    list_g     keys;
+    compare_fn cmp;
+    int        dir;
+    size_t     count;
+    bool       native;
+};
+
+
+void list_sorter::native_key(object_p key, entry &r)
 // ----------------------------------------------------------------------------
-//   Sort item according in decreasing value order
+//   Extract a native key when it represents the value exactly
 // ----------------------------------------------------------------------------
 {
-    return -value_compare(xp, yp);
+    switch(key->type())
+    {
+    case object::ID_integer:
+    case object::ID_neg_integer:
+        if (integer_p(key)->native())
+        {
+            r.i = integer_p(key)->value<int64_t>();
+            if (key->type() == object::ID_neg_integer)
+                r.i = -r.i;
+            r.kind = INTEGER;
+        }
+        break;
+    case object::ID_hwfloat:
+        r.d = hwfloat_p(key)->value();
+        if (r.d == r.d)
+            r.kind = FLOAT;
+        break;
+    case object::ID_hwdouble:
+        r.d = hwdouble_p(key)->value();
+        if (r.d == r.d)
+            r.kind = FLOAT;
+        break;
+    default:
+        break;
+    }
 }
 
 
-static int memory_compare_reverse(object_p *xp, object_p *yp)
+int list_sorter::compare(uint32_t xr, uint32_t yr)
 // ----------------------------------------------------------------------------
-//   Sort item according in decreasing value order
+//   Compare two records, using native keys when possible
 // ----------------------------------------------------------------------------
 {
-    return -memory_compare(xp, yp);
+    entry x = get(xr);
+    entry y = get(yr);
+    if (x.kind == INTEGER && y.kind == INTEGER)
+        return dir * ((x.i > y.i) - (x.i < y.i));
+
+    // Integers up to 2^53 convert exactly to double
+    const int64_t exact = int64_t(1) << 53;
+    if (x.kind == INTEGER && y.kind == FLOAT && x.i >= -exact && x.i <= exact)
+        return dir * ((double(x.i) > y.d) - (double(x.i) < y.d));
+    if (x.kind == FLOAT && y.kind == INTEGER && y.i >= -exact && y.i <= exact)
+        return dir * ((x.d > double(y.i)) - (x.d < double(y.i)));
+    if (x.kind == FLOAT && y.kind == FLOAT)
+        return dir * ((x.d > y.d) - (x.d < y.d));
+
+    object_p xo = object_p(byte_p(keys->objects()) + x.key);
+    object_p yo = object_p(byte_p(keys->objects()) + y.key);
+    return dir * cmp(&xo, &yo);
 }
 
 
-static object::result do_sort(int (*compare)(object_p *x, object_p *y))
+list_p list_sorter::sort()
 // ----------------------------------------------------------------------------
-//   RPL command for a sort
+//   Sort the items, and return the resulting list
 // ----------------------------------------------------------------------------
+//   Without a comparison function, this simply reverses the list
 {
-    typedef int (*qsort_fn)(const void *, const void*);
+    // Build one entry per item, stopping at the shortest list
+    size_t isize = 0;
+    size_t ksize = 0;
+    items->objects(&isize);
+    keys->objects(&ksize);
+    for (size_t ioff = 0, koff = 0; ioff < isize && koff < ksize; count++)
+    {
+        object_p item = object_p(byte_p(items->objects()) + ioff);
+        object_p key  = object_p(byte_p(keys->objects()) + koff);
+        entry   r;
+        r.item = ioff;
+        r.key  = koff;
+        r.kind = OBJECT;
+        r.i    = 0;
+        if (native && cmp)
+            native_key(key, r);
+        ioff += item->size();
+        koff += key->size();
+        if (!rt.allocate(sizeof(entry)))
+            return nullptr;
+        put(count, r);
+    }
 
-    if  (object_p obj = rt.stack(0))
+    // Two index buffers follow the entries
+    if (!rt.allocate(2 * count * sizeof(uint32_t)))
+        return nullptr;
+    for (size_t i = 0; i < count; i++)
+        index(0, i, cmp ? i : count - 1 - i);
+
+    // Bottom-up merge sort, alternating between the two index buffers
+    uint src = 0;
+    if (cmp)
     {
-        if (list_g items = obj->as_array_or_list())
+        for (size_t width = 1; width < count; width *= 2)
         {
-            size_t     depth = rt.depth();
-            size_t     count;
-            scribble   scr;
-            qsort_fn   cmp = qsort_fn(compare);
-            object::id ity = items->type();
+            uint dst = 1 - src;
+            for (size_t lo = 0; lo < count; lo += 2 * width)
+            {
+                size_t mid = lo + width < count ? lo + width : count;
+                size_t hi  = mid + width < count ? mid + width : count;
+                size_t l   = lo;
+                size_t h   = mid;
+                for (size_t o = lo; o < hi; o++)
+                {
+                    // Taking from the left on equality keeps the sort stable
+                    bool left = l < mid &&
+                        (h >= hi || compare(index(src, l), index(src, h)) <= 0);
+                    index(dst, o, left ? index(src, l++) : index(src, h++));
+                }
+                if (program::interrupted())
+                    return nullptr;
+            }
+            src = dst;
+        }
+    }
 
-            for (object_p item : *items)
-                if (!rt.push(item))
-                    goto err;
-            count = rt.depth() - depth;
-            if (cmp)
-                qsort(rt.stack_base(), count, sizeof(object_p), cmp);
+    // Emit the items in sorted order after the entries and indexes
+    size_t   header = scr.growth();
+    object_g item;
+    for (size_t i = 0; i < count; i++)
+    {
+        entry r = get(index(src, i));
+        item = object_p(byte_p(items->objects()) + r.item);
+        if (!rt.append(item))
+            return nullptr;
+    }
+    return list::make(items->type(),
+                      scr.scratch() + header, scr.growth() - header);
+}
 
-            for (uint i = 0; i < count; i++)
-                if (object_g obj = rt.stack(i))
-                    if (!rt.append(obj))
-                        goto err;
-            rt.drop(count);
-            items = list::make(ity, scr.scratch(), scr.growth());
+
+static object::result do_sort(int (*compare)(object_p *x, object_p *y),
+                              int dir = 1, bool native = true)
+// ----------------------------------------------------------------------------
+//   RPL command for a sort
+// ----------------------------------------------------------------------------
+{
+    if  (object_p obj = rt.stack(0))
+    {
+        if (list_g items = obj->as_array_or_list())
+        {
+            list_sorter sorter(items, items, compare, dir, native);
+            items = sorter.sort();
             if (items && rt.top(+items))
                 return object::OK;
-
-        err:
-            rt.drop(rt.depth() - depth);
-            return object::ERROR;
         }
         else
         {
@@ -1823,7 +2097,7 @@ COMMAND_BODY(QuickSort)
 //   Sort contents of a list using memory comparisons
 // ----------------------------------------------------------------------------
 {
-    return do_sort(memory_compare);
+    return do_sort(memory_compare, 1, false);
 }
 
 
@@ -1832,7 +2106,7 @@ COMMAND_BODY(ReverseSort)
 //   Sort contents of a list according to value
 // ----------------------------------------------------------------------------
 {
-    return do_sort(value_compare_reverse);
+    return do_sort(value_compare, -1);
 }
 
 
@@ -1841,7 +2115,57 @@ COMMAND_BODY(ReverseQuickSort)
 //   Sort contents of a list using memory comparisons
 // ----------------------------------------------------------------------------
 {
-    return do_sort(memory_compare_reverse);
+    return do_sort(memory_compare, -1, false);
+}
+
+
+COMMAND_BODY(SortBy)
+// ----------------------------------------------------------------------------
+//   Sort contents of a list according to keys computed by a program
+// ----------------------------------------------------------------------------
+{
+    size_t   depth = rt.depth();
+    object_p obj   = rt.stack(1);
+    object_g prg   = rt.top();
+    if (list_g items = obj->as_array_or_list())
+    {
+        // Evaluate the key program exactly once per item
+        list_g keys;
+        {
+            scribble scr;
+            for (object_p item : *items)
+            {
+                if (!rt.push(item))
+                    goto error;
+                if (program::run(prg, true) != OK)
+                    goto error;
+                if (rt.depth() != depth + 1)
+                {
+                    rt.misbehaving_program_error();
+                    goto error;
+                }
+                object_g key = rt.pop();
+                if (!key || !rt.append(key))
+                    goto error;
+            }
+            keys = list::make(ID_list, scr.scratch(), scr.growth());
+            if (!keys)
+                goto error;
+        }
+
+        list_sorter sorter(items, keys, value_compare, 1, true);
+        items = sorter.sort();
+        if (items && rt.drop() && rt.top(+items))
+            return OK;
+    }
+    else
+    {
+        rt.type_error();
+    }
+error:
+    if (rt.depth() > depth)
+        rt.drop(rt.depth() - depth);
+    return ERROR;
 }
 
 
@@ -2224,16 +2548,29 @@ COMMAND_BODY(DoList)
                 }
             }
 
-            // Run program on all the lists
+            // Byte offset of the current item in each list, deepest first
+            scribble cursors;
+            if (!rt.allocate(count * sizeof(size_t)))
+                return ERROR;
+            memset(cursors.scratch(), 0, count * sizeof(size_t));
+
+            // Run program on all the lists, streaming items from each list
             scribble scr;
             size_t depth = rt.depth();
             for (size_t i = 0; i < length; i++)
             {
                 size_t offs = base + count - 1;
-                for (size_t d = count; d --> 0; )
+                for (size_t d = 0; d < count; d++)
                 {
-                    list_p lst = list_p(rt.stack(offs));
-                    if (!rt.push(lst->at(i)))
+                    // Each push shifts the stack, so offs reaches next list
+                    list_p   lst    = list_p(rt.stack(offs));
+                    byte    *cursor = cursors.scratch() + d * sizeof(size_t);
+                    size_t   offset;
+                    memcpy(&offset, cursor, sizeof(offset));
+                    object_p item   = object_p(byte_p(lst->objects()) + offset);
+                    offset += item->size();
+                    memcpy(cursor, &offset, sizeof(offset));
+                    if (!rt.push(item))
                         return ERROR;
                 }
 
@@ -2319,15 +2656,24 @@ COMMAND_BODY(DoSubs)
             save<size_t> ses(endsub, length - count + 1);
             rt.drop(base + 1);
 
-            // Run program on all subs in the list
+            // Run program on all subs in the list, sliding a window over it
             scribble scr;
             size_t depth = rt.depth();
+            size_t start = 0;
             for (size_t i = 0; i < endsub; i++)
             {
                 nsub = i + 1;
+                size_t offset = start;
                 for (size_t d = 0; d < count; d++)
-                    if (!rt.push(lst->at(i + d)))
+                {
+                    object_p item = object_p(byte_p(lst->objects()) + offset);
+                    size_t   size = item->size();
+                    if (!d)
+                        start += size;
+                    offset += size;
+                    if (!rt.push(item))
                         return ERROR;
+                }
 
                 program::run(prg, true);
 
@@ -274,7 +274,6 @@ struct list : text
 
 
     // Apply an algebraic function to all elements in list
-    list_p map(object_p prg) const;
     list_p map(algebraic_fn fn) const;
     list_p map(arithmetic_fn fn, algebraic_r y) const;
     list_p map(algebraic_r x, arithmetic_fn fn) const;
@@ -308,14 +307,11 @@ struct list : text
     // Remove a range in the list
     list_p remove(size_t start, size_t length = 1) const;
 
-    // Reduce and filter operations
+    // Reduce operation
     object_p reduce(object_p prg) const;
-    list_p   filter(object_p prg) const;
 
     // Build a list by combining two subsequent items
     list_p   pair_map(object_p prg) const;
-    object_p map_as_object(object_p prg) const          { return map(prg);    }
-    object_p filter_as_object(object_p prg) const       { return filter(prg); }
 
     // Element substitution
     static algebraic_p where(algebraic_r expr, algebraic_r args);
@@ -353,6 +349,7 @@ COMMAND_DECLARE(Sort,1);
 COMMAND_DECLARE(QuickSort,1);
 COMMAND_DECLARE(ReverseSort,1);
 COMMAND_DECLARE(ReverseQuickSort,1);
+COMMAND_DECLARE(SortBy,2);
 COMMAND_DECLARE(ReverseList,1);
 COMMAND_DECLARE(Head,1);
 COMMAND_DECLARE(Tail,1);
@@ -704,7 +704,10 @@ MENU(ProbabilitiesMenu,
      "FFT⁻¹",   ID_Unimplemented,
 
      RandomGeneratorBits::label, ID_RandomGeneratorBits,
-     RandomGeneratorOrder::label, ID_RandomGeneratorOrder
+     RandomGeneratorOrder::label, ID_RandomGeneratorOrder,
+     "RandU",   ID_RandomUniform,
+     "RandN",   ID_RandomNormal,
+     ID_FixedRandomSeed
 );
 
 
@@ -731,7 +734,10 @@ MENU(StatisticsMenu,
      "ClrΣ",    ID_ClearData,
      "Popul",   ID_PopulationMenu,
      "Regres",  ID_RegressionMenu,
-     "Plot",    ID_PlotMenu);
+     "Plot",    ID_PlotMenu,
+
+     "Quantl",  ID_Quantile,
+     "Pctile",  ID_Percentile);
 
 MENU(RegressionMenu,
 // ----------------------------------------------------------------------------
@@ -1060,7 +1066,12 @@ MENU(ListMenu,
      "Find",    ID_Unimplemented,
      "Objects", ID_ObjectMenu,
      "Matrix",  ID_MatrixMenu,
-     "Vector",  ID_VectorMenu);
+     "Vector",  ID_VectorMenu,
+
+     "SortBy",  ID_SortBy,
+     "Median",  ID_ListMedian,
+     "Quantl",  ID_ListQuantile,
+     "Pctile",  ID_ListPercentile);
 
 
 MENU(ObjectMenu,
@@ -1204,7 +1215,11 @@ MENU(IntegrationMenu,
      "Indep",   ID_Unimplemented,
 
      "Σ",       ID_Sum,
-     "∏",       ID_Product);
+     "∏",       ID_Product,
+     "Romberg", ID_RombergIntegration,
+     "G-K",     ID_GaussKronrodIntegration,
+     "Tanh-S",  ID_TanhSinhIntegration,
+     "Evals",   ID_IntegrationEvaluations);
 
 MENU(SolverMenu,
 // ----------------------------------------------------------------------------
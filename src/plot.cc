@@ -31,6 +31,7 @@
 
 #include "arithmetic.h"
 #include "compare.h"
+#include "compiled.h"
 #include "equations.h"
 #include "expression.h"
 #include "functions.h"
@@ -127,6 +128,411 @@ uint draw_data(array::iterator &it, array::iterator &end,
 }
 
 
+static void draw_error(const PlotParametersAccess &ppar,
+                       coord rx, pattern errbg)
+// ----------------------------------------------------------------------------
+//   Show an evaluation error, with a marker at column `rx` if not negative
+// ----------------------------------------------------------------------------
+{
+    if (rx >= 0)
+    {
+        coord ry = ppar.pixel_y(ppar.yorigin);
+        if (ry < 0)
+            ry = 0;
+        else if (ry >= LCD_H)
+            ry = LCD_H-1;
+        rect r(rx, ry - LCD_H/32, rx, ry + LCD_H/32);
+        Screen.fill(r, errbg);
+        ui.draw_dirty(r);
+    }
+    if (!rt.error())
+        rt.invalid_function_error();
+    Screen.text(0, 0, rt.error(), ErrorFont,
+                pattern::white, pattern::black);
+    ui.draw_dirty(0, 0, LCD_W, ErrorFont->height());
+    rt.clear_error();
+}
+
+
+
+// ============================================================================
+//
+//   Adaptive sampling of function plots
+//
+// ============================================================================
+//
+//   With the default resolution, a function plot is sampled in screen
+//   columns. Columns are first sampled every COARSE pixels, and intervals
+//   are split in the middle when the curve moves by more than one pixel
+//   between two samples or bends away from a straight line. Flat regions
+//   are sampled every GAP pixels, so a narrower spike between two flat
+//   samples is not seen: GAP is kept small to only miss very narrow ones.
+//   The vertical pixel positions are kept in a cache keyed by the equation,
+//   independent variable and plot range, so that redrawing the same plot,
+//   or one panned horizontally by a whole number of pixels, only evaluates
+//   columns that were not computed yet.
+//   Drawing is progressive: dots every COARSE pixels show the shape of the
+//   curve first, then intervals are refined and drawn from left to right,
+//   refreshing the modified parts of the screen as drawing proceeds.
+
+struct plot_samples
+// ----------------------------------------------------------------------------
+//   Cache of the pixel positions computed for a function plot
+// ----------------------------------------------------------------------------
+{
+    enum : coord { UNKNOWN = INT32_MIN, FAILED = INT32_MIN + 1 };
+    enum { COARSE = 8, GAP = 2 };
+
+    plot_samples(): columns(0), height(0), settings(0), ry(nullptr) {}
+
+    bool        prepare(const PlotParametersAccess &ppar, program_r eq);
+    bool        flush();
+
+    program_g   eq;
+    symbol_g    independent;
+    algebraic_g xmin, xmax, ymin, ymax;
+    coord       columns, height;
+    uint32_t    settings;
+    coord      *ry;
+};
+
+static plot_samples *samples = nullptr;
+
+
+static inline large distance(large a, large b)
+// ----------------------------------------------------------------------------
+//   Vertical distance between two pixel positions, without overflow
+// ----------------------------------------------------------------------------
+{
+    return a < b ? b - a : a - b;
+}
+
+
+static inline bool same(object_p a, object_p b)
+// ----------------------------------------------------------------------------
+//   Check if two cache key components are identical
+// ----------------------------------------------------------------------------
+{
+    return a == b || (a && b && a->is_same_as(b));
+}
+
+
+bool plot_samples::prepare(const PlotParametersAccess &ppar, program_r peq)
+// ----------------------------------------------------------------------------
+//   Reuse cached samples if possible, return false if out of memory
+// ----------------------------------------------------------------------------
+{
+    coord    w     = ScreenWidth() + 1;
+    coord    h     = ScreenHeight();
+    uint32_t shash = Settings.hash();
+    coord    shift = 0;
+    bool     reuse = ry
+        && columns == w && height == h && settings == shash
+        && same(+eq, +peq)
+        && same(+independent, +ppar.independent)
+        && same(+ymin, +ppar.ymin) && same(+ymax, +ppar.ymax);
+
+    // Check if the plot was panned horizontally by a whole number of pixels
+    if (reuse && !(same(+xmin, +ppar.xmin) && same(+xmax, +ppar.xmax)))
+    {
+        algebraic_g range = xmax - xmin;
+        algebraic_g nrange = ppar.xmax - ppar.xmin;
+        algebraic_g d = range - nrange;
+        reuse = d && d->is_zero(false);
+        if (reuse)
+        {
+            algebraic_g cols = integer::make(w - 1);
+            algebraic_g s = (ppar.xmin - xmin) * cols / range;
+            shift = s ? s->as_int32(0, false) : 0;
+            algebraic_g rs = integer::make(shift);
+            algebraic_g ds = s ? s - rs : nullptr;
+            reuse = ds && ds->is_zero(false) && shift > -w && shift < w;
+        }
+        rt.clear_error();
+    }
+
+    if (!reuse)
+    {
+        if (columns != w)
+        {
+            // No operator new[] nor operator delete[] in embedded runtime
+            free(ry);
+            ry = (coord *) malloc(w * sizeof(coord));
+            columns = ry ? w : 0;
+            if (!ry)
+                return false;
+        }
+        for (coord i = 0; i < w; i++)
+            ry[i] = UNKNOWN;
+    }
+    else if (shift > 0)
+    {
+        for (coord i = 0; i < w; i++)
+            ry[i] = i + shift < w ? ry[i + shift] : UNKNOWN;
+    }
+    else if (shift < 0)
+    {
+        for (coord i = w; i-- > 0; )
+            ry[i] = i + shift >= 0 ? ry[i + shift] : UNKNOWN;
+    }
+
+    // Errors are not remembered, they will be reported again
+    for (coord i = 0; i < w; i++)
+        if (ry[i] == FAILED)
+            ry[i] = UNKNOWN;
+
+    eq          = peq;
+    independent = ppar.independent;
+    xmin        = ppar.xmin;
+    xmax        = ppar.xmax;
+    ymin        = ppar.ymin;
+    ymax        = ppar.ymax;
+    height      = h;
+    settings    = shash;
+    return true;
+}
+
+
+bool plot_samples::flush()
+// ----------------------------------------------------------------------------
+//   Forget all samples, return true if there were any
+// ----------------------------------------------------------------------------
+{
+    // Keep the array, since a plotted program may store variables
+    bool freed = eq;
+    for (coord i = 0; i < columns; i++)
+        ry[i] = UNKNOWN;
+    eq          = nullptr;
+    independent = nullptr;
+    xmin        = nullptr;
+    xmax        = nullptr;
+    ymin        = nullptr;
+    ymax        = nullptr;
+    return freed;
+}
+
+
+bool plot_cache_flush()
+// ----------------------------------------------------------------------------
+//   Forget cached plot samples, e.g. after variables changed
+// ----------------------------------------------------------------------------
+{
+    return samples && samples->flush();
+}
+
+
+struct adaptive_plot
+// ----------------------------------------------------------------------------
+//   State for drawing a function plot with adaptive sampling
+// ----------------------------------------------------------------------------
+{
+    adaptive_plot(const PlotParametersAccess &ppar,
+                  program_r eq, const compiled_expression &code)
+        : ppar(ppar), eq(eq), code(code),
+          range(ppar.xmax - ppar.xmin),
+          cols(integer::make(ScreenWidth())),
+          lx(-1), ly(-1), then(sys_current_ms()),
+          split_points(Settings.NoCurveFilling()),
+          lw(Settings.LineWidth()),
+          fg(Settings.Foreground()),
+          errbg(Settings.PlotErrorBackground())
+    {}
+
+    coord       sample(coord px);
+    void        refine(coord a, coord b, bool curved);
+    void        draw(coord px);
+    void        refresh(bool force);
+    void        coarse();
+    bool        run();
+
+    const PlotParametersAccess &ppar;
+    program_r                   eq;
+    const compiled_expression  &code;
+    algebraic_g                 range;
+    algebraic_g                 cols;
+    coord                       lx, ly;
+    uint                        then;
+    bool                        split_points;
+    size                        lw;
+    pattern                     fg;
+    pattern                     errbg;
+};
+
+
+coord adaptive_plot::sample(coord px)
+// ----------------------------------------------------------------------------
+//   Evaluate the function for the given column, unless already known
+// ----------------------------------------------------------------------------
+{
+    if (samples->ry[px] != plot_samples::UNKNOWN)
+        return samples->ry[px];
+    if (program::interrupted())
+        return plot_samples::UNKNOWN;
+
+    algebraic_g x = ppar.xmin + range * integer::make(px) / cols;
+    algebraic_g y = x ? code.evaluate(eq, x) : nullptr;
+    coord       ry = y ? ppar.pixel_y(y) : plot_samples::FAILED;
+
+    // An evaluation interrupted by EXIT leaves the column unknown
+    if (!y && program::interrupted())
+    {
+        rt.clear_error();
+        return plot_samples::UNKNOWN;
+    }
+    if (!y || rt.error())
+        ry = plot_samples::FAILED;
+    else if (ry <= plot_samples::FAILED)
+        ry = plot_samples::FAILED + 1;
+    samples->ry[px] = ry;
+    return ry;
+}
+
+
+void adaptive_plot::refine(coord a, coord b, bool curved)
+// ----------------------------------------------------------------------------
+//   Split the interval between two sampled columns as long as needed
+// ----------------------------------------------------------------------------
+{
+    if (b - a < 2 || program::interrupted())
+        return;
+
+    coord ya = samples->ry[a];
+    coord yb = samples->ry[b];
+    if (ya == plot_samples::UNKNOWN || yb == plot_samples::UNKNOWN)
+        return;
+    bool  failed = ya == plot_samples::FAILED || yb == plot_samples::FAILED;
+    if (!curved && !failed && b - a <= plot_samples::GAP &&
+        distance(ya, yb) <= 1)
+        return;
+
+    coord m  = (a + b) / 2;
+    coord ym = sample(m);
+    if (ym == plot_samples::UNKNOWN)
+        return;
+    curved = !failed && ym != plot_samples::FAILED &&
+        distance(2 * large(ym), large(ya) + yb) > 2;
+    refine(a, m, curved);
+    refine(m, b, curved);
+}
+
+
+void adaptive_plot::draw(coord px)
+// ----------------------------------------------------------------------------
+//   Draw the curve up to a sampled column
+// ----------------------------------------------------------------------------
+{
+    coord ry = samples->ry[px];
+    if (ry == plot_samples::UNKNOWN)
+        return;
+    if (ry == plot_samples::FAILED)
+    {
+        draw_error(ppar, px, errbg);
+        lx = ly = -1;
+        return;
+    }
+    if (lx < 0 || split_points)
+    {
+        lx = px;
+        ly = ry;
+    }
+    Screen.line(lx, ly, px, ry, lw, fg);
+    ui.draw_dirty(lx, ly, px, ry);
+    lx = px;
+    ly = ry;
+}
+
+
+void adaptive_plot::refresh(bool force)
+// ----------------------------------------------------------------------------
+//   Show what was drawn so far if forced or if the refresh period elapsed
+// ----------------------------------------------------------------------------
+{
+    uint now = sys_current_ms();
+    if (force || now - then >= Settings.PlotRefreshRate())
+    {
+        refresh_dirty();
+        then = sys_current_ms();
+    }
+}
+
+
+void adaptive_plot::coarse()
+// ----------------------------------------------------------------------------
+//   Show the shape of the curve by drawing one dot every COARSE columns
+// ----------------------------------------------------------------------------
+//   The dots are on the final curve, so the refinement pass draws over them
+{
+    coord last = samples->columns - 1;
+    for (coord px = 0; px <= last && !program::interrupted();
+         px += plot_samples::COARSE)
+    {
+        coord ry = sample(px);
+        if (ry != plot_samples::UNKNOWN && ry != plot_samples::FAILED)
+        {
+            Screen.line(px, ry, px, ry, lw, fg);
+            ui.draw_dirty(px, ry, px, ry);
+        }
+        refresh(false);
+    }
+    refresh(true);
+}
+
+
+bool adaptive_plot::run()
+// ----------------------------------------------------------------------------
+//   Sample and draw the whole plot, coarse interval by coarse interval
+// ----------------------------------------------------------------------------
+//   A first pass gives a quick preview, then each interval is refined and
+//   drawn from left to right. If interrupted, e.g. by EXIT, drawing stops
+//   with the part computed so far on screen and the samples kept in cache.
+{
+    coord last = samples->columns - 1;
+    coarse();
+    sample(0);
+    draw(0);
+    for (coord a = 0; a < last && !program::interrupted();
+         a += plot_samples::COARSE)
+    {
+        coord b = a + plot_samples::COARSE;
+        if (b > last)
+            b = last;
+        sample(b);
+        refine(a, b, false);
+        for (coord px = a + 1; px <= b; px++)
+            draw(px);
+        refresh(false);
+    }
+    return !program::interrupted();
+}
+
+
+static object::result draw_adaptive_plot(const PlotParametersAccess &ppar,
+                                         program_r                   eq,
+                                         const compiled_expression  &code)
+// ----------------------------------------------------------------------------
+//   Draw a function plot using adaptive sampling and cached samples
+// ----------------------------------------------------------------------------
+{
+    if (!samples)
+    {
+        // Operator new support purposefully not linked in embedded versions
+        samples = (plot_samples *) malloc(sizeof(plot_samples));
+        if (samples)
+            new(samples) plot_samples;
+    }
+    if (!samples || !samples->prepare(ppar, eq))
+    {
+        rt.out_of_memory_error();
+        refresh_dirty();
+        return object::ERROR;
+    }
+
+    adaptive_plot plot(ppar, eq, code);
+    plot.run();
+    refresh_dirty();
+    return object::OK;
+}
+
 
 object::result draw_plot(object::id                  kind,
                          const PlotParametersAccess &ppar,
@@ -194,6 +600,9 @@ object::result draw_plot(object::id                  kind,
     size            bar_width = 0, bar_skip = 0;
     size            bar_x = 0;
     coord           yzero = 0;
+    StatsBins       histogram;
+    size_t          bin = 0;
+    bool            binned = false;
 
     if (dname == object::ID_Equation)
     {
@@ -213,20 +622,41 @@ object::result draw_plot(object::id                  kind,
     }
     else if (dname == object::ID_StatsData)
     {
-        if (to_plot->type() != object::ID_array)
+        // A bar plot of { xmin xwidth nbins } or { edges } draws frequencies
+        binned = kind == object::ID_Bar && to_plot->type() == object::ID_list;
+        if (binned)
+        {
+            list_g args = list_p(+to_plot);
+            size_t nargs = args->items();
+            bool   ok = nargs == 3
+                ? histogram.setup(args->at(0), args->at(1), args->at(2))
+                : nargs == 1 && histogram.setup(args->at(0));
+            if (!ok)
+            {
+                if (!rt.error())
+                    rt.invalid_plot_data_error();
+                return object::ERROR;
+            }
+            StatsAccess stats;
+            if (!stats || !histogram.count(stats))
+                return object::ERROR;
+        }
+        else if (to_plot->type() != object::ID_array)
         {
             rt.invalid_plot_data_error();
             return object::ERROR;
         }
 
-        data = array_p(+to_plot);
-        size_t items = data->items();
-        data = array_p(+to_plot);
+        data = binned ? nullptr : array_p(+to_plot);
+        size_t items = binned ? histogram.bins : data->items();
         step = (max - min) / integer::make(items);
         bar_skip = items && items < ScreenWidth() ? ScreenWidth() / items : 1;
         bar_width = bar_skip > 2 ? bar_skip - 2: bar_skip;
-        it = data->begin();
-        end = data->end();
+        if (data)
+        {
+            it = data->begin();
+            end = data->end();
+        }
         StatsParameters::Access stats;
         xcol = stats.xcol;
         ycol = stats.ycol;
@@ -238,6 +668,7 @@ object::result draw_plot(object::id                  kind,
     save<symbol_g *> iref(expression::independent,
                           (symbol_g *) &ppar.independent);
     settings::PrepareForFunctionEvaluation willEvaluateFunction;
+    compiled_expression code(eq);
     if (ui.draw_graphics())
         if (Settings.DrawPlotAxes())
             draw_axes(ppar);
@@ -247,6 +678,10 @@ object::result draw_plot(object::id                  kind,
     pattern fg           = Settings.Foreground();
     pattern errbg        = Settings.PlotErrorBackground();
 
+    if (kind == object::ID_Function && ppar.resolution->is_zero() &&
+        !Settings.FixedPlotSampling())
+        return draw_adaptive_plot(ppar, eq, code);
+
     while (!program::interrupted())
     {
         coord rx     = 0;
@@ -254,7 +689,19 @@ object::result draw_plot(object::id                  kind,
         uint  dcount = 1;
         if (dname == object::ID_Equation)
         {
-            y = algebraic::evaluate_function(eq, x);
+            y = code.evaluate(eq, x);
+            if (!y && program::interrupted())
+            {
+                rt.clear_error();
+                break;
+            }
+        }
+        else if (binned)
+        {
+            // Frequencies are read directly from the native counters
+            if (bin >= histogram.bins)
+                break;
+            y = integer::make(histogram.frequency(++bin));
         }
         else
         {
@@ -326,25 +773,9 @@ object::result draw_plot(object::id                  kind,
         }
         else
         {
-            if (kind == object::ID_Function)
-            {
-                rx = ppar.pixel_x(x);
-                ry = ppar.pixel_y(ppar.yorigin);
-                if (ry < 0)
-                    ry = 0;
-                else if (ry >= LCD_H)
-                    ry = LCD_H-1;
-                rect r(rx, ry - LCD_H/32, rx, ry + LCD_H/32);
-                Screen.fill(r, errbg);
-                ui.draw_dirty(r);
-            }
-            if (!rt.error())
-                rt.invalid_function_error();
-            Screen.text(0, 0, rt.error(), ErrorFont,
-                        pattern::white, pattern::black);
-            ui.draw_dirty(0, 0, LCD_W, ErrorFont->height());
+            draw_error(ppar, kind == object::ID_Function
+                       ? ppar.pixel_x(x) : -1, errbg);
             lx = ly = -1;
-            rt.clear_error();
         }
 
         if (kind != object::ID_Scatter)
@@ -48,4 +48,6 @@ struct Equation : command
     Equation(id ty = ID_Equation): command(ty) {}
 };
 
+bool plot_cache_flush();
+
 #endif // PLOT_H
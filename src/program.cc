@@ -28,6 +28,7 @@
 
 #include "program.h"
 
+#include "arithmetic.h"
 #include "dmcp.h"
 #include "parser.h"
 #include "settings.h"
@@ -158,6 +159,291 @@ object::result program::run(algebraic_p obj, bool sync)
 #endif // DM42
 
 
+// ============================================================================
+//
+//   Peephole superinstructions
+//
+// ============================================================================
+
+struct superinstruction
+// ----------------------------------------------------------------------------
+//   Peephole superinstructions for common sequences in hot loops
+// ----------------------------------------------------------------------------
+//   Short sequences such as `DUP *` or `1 +` are recognized when their first
+//   object is decoded, and run as a single step when the stack contains small
+//   integers. The program itself is not modified, so it renders as written.
+//   When single-stepping, or when operands are not suitable, the objects are
+//   evaluated one at a time as before.
+{
+    enum opcode : byte
+    {
+        NONE,
+        SQUARE,                 // DUP *
+        ADD,                    // n +
+        SUB,                    // n -
+        MUL,                    // n *
+        NIP,                    // SWAP DROP
+        OVER2,                  // OVER OVER
+        DIVISIBLE,              // n MOD 0 ==
+    };
+
+    struct prepared
+    {
+        opcode     op;          // Superinstruction to execute, NONE if none
+        size_t     size;        // Size of the objects it replaces
+        object::id type;        // Type of the integer result
+        ularge     value;       // Value of the integer result
+    };
+
+    static opcode         match(object_p first, object_p second,
+                                object_p end, object_p &next);
+    static bool           prepare(opcode op, object_p first, prepared &p);
+    static object::result execute(object_p first, const prepared &p,
+                                  bool last_args);
+};
+
+
+superinstruction::opcode superinstruction::match(object_p first,
+                                                 object_p second,
+                                                 object_p end,
+                                                 object_p &next)
+// ----------------------------------------------------------------------------
+//   Check if a superinstruction starts at first, and if so, where it ends
+// ----------------------------------------------------------------------------
+{
+    if (second >= end)
+        return NONE;
+    object::id ft = first->type();
+    object::id st = second->type();
+    next = second->skip();
+    switch(ft)
+    {
+    case object::ID_Dup:
+        return st == object::ID_mul ? SQUARE : NONE;
+    case object::ID_Swap:
+        return st == object::ID_Drop ? NIP : NONE;
+    case object::ID_Over:
+        return st == object::ID_Over ? OVER2 : NONE;
+    case object::ID_integer:
+    case object::ID_neg_integer:
+        if (!integer_p(first)->native())
+            return NONE;
+        if (st == object::ID_add)
+            return ADD;
+        if (st == object::ID_sub)
+            return SUB;
+        if (st == object::ID_mul)
+            return MUL;
+        if (st == object::ID_mod && ft == object::ID_integer &&
+            !integer_p(first)->is_zero() && next < end)
+        {
+            object_p zero = next;
+            object_p same = zero->skip();
+            if (same < end &&
+                zero->type() == object::ID_integer &&
+                integer_p(zero)->is_zero() &&
+                same->type() == object::ID_TestSame)
+            {
+                next = same->skip();
+                return DIVISIBLE;
+            }
+        }
+        return NONE;
+    default:
+        return NONE;
+    }
+}
+
+
+bool superinstruction::prepare(opcode op, object_p first, prepared &p)
+// ----------------------------------------------------------------------------
+//   Check if the stack allows a superinstruction, compute integer results
+// ----------------------------------------------------------------------------
+{
+    if (program::stepping || program::halted)
+        return false;
+
+    switch(op)
+    {
+    case NIP:
+    case OVER2:
+        return rt.depth() >= 2;
+    case NONE:
+        return false;
+    default:
+        break;
+    }
+
+    // Arithmetic superinstructions only apply to small integers
+    if (Settings.NumericalResults())
+        return false;
+    object_p x = rt.depth() >= 1 ? rt.stack(0) : nullptr;
+    if (!x)
+        return false;
+    object::id xt = x->type();
+    if ((xt != object::ID_integer && xt != object::ID_neg_integer) ||
+        !integer_p(x)->native())
+        return false;
+
+    // Run the same integer code as the arithmetic operations
+    object::id yt = xt;
+    ularge     xv = integer_p(x)->value<ularge>();
+    ularge     yv = xv;
+    bool       ok = false;
+    if (op != SQUARE)
+    {
+        yt = first->type();
+        yv = integer_p(first)->value<ularge>();
+    }
+    switch(op)
+    {
+    case SQUARE:
+    case MUL:           ok = mul::integer_ok(xt, yt, xv, yv); break;
+    case ADD:           ok = add::integer_ok(xt, yt, xv, yv); break;
+    case SUB:           ok = sub::integer_ok(xt, yt, xv, yv); break;
+    case DIVISIBLE:     ok = mod::integer_ok(xt, yt, xv, yv); break;
+    default:            break;
+    }
+    p.type = xt;
+    p.value = xv;
+    return ok;
+}
+
+
+object::result superinstruction::execute(object_p first, const prepared &p,
+                                         bool last_args)
+// ----------------------------------------------------------------------------
+//   Execute a prepared superinstruction
+// ----------------------------------------------------------------------------
+//   When saving last arguments, the stack is set up as it would be for the
+//   last command in the sequence, so that LastArg gives the same result.
+{
+    // Errors and commands looking back refer to the last command
+    static const object::id last[] =
+    {
+        object::ID_object, object::ID_mul,  object::ID_add,  object::ID_sub,
+        object::ID_mul,    object::ID_Drop, object::ID_Over, object::ID_TestSame
+    };
+    opcode     op  = p.op;
+    object::id lty = last[op];
+    rt.command(first + p.size - leb128size(lty));
+    record(program, "Superinstruction %u at %p size %u", op, first, p.size);
+
+    // Allocating results may move the program
+    object_g start = first;
+
+    switch(op)
+    {
+    case SQUARE:
+    case ADD:
+    case SUB:
+    case MUL:
+    {
+        object_g result = rt.make<integer>(p.type, p.value);
+        if (!result)
+            return object::ERROR;
+        if (last_args)
+        {
+            if (!rt.push(op == SQUARE ? rt.top() : +start))
+                return object::ERROR;
+            rt.need_save();
+            if (!rt.args(2) || !rt.drop())
+                return object::ERROR;
+        }
+        return rt.top(result) ? object::OK : object::ERROR;
+    }
+
+    case NIP:
+    {
+        object_p x = rt.stack(0);
+        object_p y = rt.stack(1);
+        if (last_args)
+        {
+            rt.stack(0, y);
+            rt.stack(1, x);
+            rt.need_save();
+            return rt.args(1) && rt.drop() ? object::OK : object::ERROR;
+        }
+        return rt.drop() && rt.top(x) ? object::OK : object::ERROR;
+    }
+
+    case OVER2:
+        if (rt.push(rt.stack(1)))
+        {
+            if (last_args)
+            {
+                rt.need_save();
+                if (!rt.args(2))
+                    return object::ERROR;
+            }
+            if (rt.push(rt.stack(1)))
+                return object::OK;
+            rt.drop();
+        }
+        return object::ERROR;
+
+    case DIVISIBLE:
+    {
+        object::id truth = p.value ? object::ID_False : object::ID_True;
+        if (last_args)
+        {
+            object_g remainder = rt.make<integer>(p.type, p.value);
+            object_p zero      = start->skip()->skip();
+            if (!remainder || !rt.top(remainder) || !rt.push(zero))
+                return object::ERROR;
+            rt.need_save();
+            if (!rt.args(2) || !rt.drop())
+                return object::ERROR;
+        }
+        return rt.top(command::static_object(truth))
+            ? object::OK : object::ERROR;
+    }
+
+    default:
+        return object::ERROR;
+    }
+}
+
+
+
+// ============================================================================
+//
+//   Pre-decoded execution cache
+//
+// ============================================================================
+//   Hot loops execute the same few objects over and over again.
+//   For each executed object, we remember the object that follows it and its
+//   evaluation handler, so that later executions need not decode its type
+//   and size again. The cache is direct-mapped on the object address.
+//   Entries are flushed by runtime::uncache when objects move or are purged.
+
+struct decoded_object
+// ----------------------------------------------------------------------------
+//   Pre-decoded information about an object being executed
+// ----------------------------------------------------------------------------
+{
+    object_p                object;     // Object being executed
+    object_p                next;       // Object following it
+    object::evaluate_fn     evaluate;   // Evaluation handler for the object
+    object_p                fused_next; // Object following superinstruction
+    superinstruction::opcode fused;     // Superinstruction starting here
+};
+
+static decoded_object decoded[program::DECODE_CACHE];
+
+
+void program::decode_flush(object_p start, size_t size)
+// ----------------------------------------------------------------------------
+//   Flush decoded entries for objects in the given memory range
+// ----------------------------------------------------------------------------
+{
+    object_p end = start + size;
+    for (decoded_object &d : decoded)
+        if (d.object >= start && d.object < end)
+            d.object = nullptr;
+}
+
+
 object::result program::run_loop(size_t depth)
 // ----------------------------------------------------------------------------
 //   Continue executing a program
@@ -173,11 +459,45 @@ object::result program::run_loop(size_t depth)
     save<bool> save_running(running, true);
     object_g   obj;
 
-    while ((obj = rt.run_next(depth)))
+    // Do not let a tick from idle time steal type-ahead keys right away
+    if (outer)
+        ticked = false;
+
+    // Find the next object and evaluation handler from the decode cache
+    evaluate_fn                evaluate = nullptr;
+    superinstruction::prepared fused    = {};
+    auto decode = [&](object_p o, object_p end)
+    {
+        decoded_object &d = decoded[uintptr_t(o) % DECODE_CACHE];
+        if (d.object != o)
+        {
+            d.object     = o;
+            d.next       = o->skip();
+            d.evaluate   = o->ops().evaluate;
+            d.fused_next = d.next;
+            d.fused      = superinstruction::match(o, d.next, end,
+                                                   d.fused_next);
+        }
+        evaluate = d.evaluate;
+        fused.op = superinstruction::NONE;
+        if (d.fused && d.fused_next <= end &&
+            superinstruction::prepare(d.fused, o, fused))
+        {
+            fused.op   = d.fused;
+            fused.size = d.fused_next - o;
+            return d.fused_next;
+        }
+        return d.next;
+    };
+
+    while ((obj = rt.run_next(depth, decode)))
     {
         if (interrupted())
         {
-            obj->defer();
+            if (fused.op)
+                rt.run_push(obj, obj + fused.size);
+            else
+                obj->defer();
             if (ui.in_input())
             {
                 halted = false;
@@ -191,13 +511,19 @@ object::result program::run_loop(size_t depth)
         }
         if (last_args)
             rt.need_save();
-        result = obj->evaluate();
+        record(eval, "Evaluating %t", +obj);
+        result = fused.op
+            ? superinstruction::execute(obj, fused, last_args)
+            : evaluate(obj);
 
         if (result != OK)
         {
             if (Settings.DebugOnError())
             {
-                obj->defer();
+                if (fused.op)
+                    rt.run_push(obj, obj + fused.size);
+                else
+                    obj->defer();
                 static_object(ID_DebugMenu)->evaluate();
             }
             else
@@ -220,17 +546,22 @@ object::result program::run_loop(size_t depth)
 
 static uint last_interrupted = 0;
 static uint last_power_check = 0;
-static uint count_interrupted = 0;
+program::tick_flag program::ticked(false);
+#if !SIMULATOR
+uint program::tick_countdown = program::TICK_COUNT;
+#endif // SIMULATOR
 
-bool program::interrupted()
+bool program::poll()
 // ----------------------------------------------------------------------------
-//   Return true if the current program must be interrupted
+//   Periodic work when the tick fired: keys, battery, busy indicator
 // ----------------------------------------------------------------------------
+//   The simulator and wasm targets set `ticked` from a timer thread, see
+//   sim/dmcp.cpp. On DMCP, `interrupted()` sets it every TICK_COUNT calls.
 {
-    if (count_interrupted++ < 32)
-        return halted;
-
-    count_interrupted = 0;
+    ticked = false;
+#if !SIMULATOR
+    tick_countdown = TICK_COUNT;
+#endif // SIMULATOR
     reset_auto_off();
     uint now = sys_current_ms();
     if (now - last_power_check >= Settings.BatteryRefresh())
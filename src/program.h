@@ -32,6 +32,10 @@
 #include "list.h"
 #include "recorder.h"
 
+#if SIMULATOR
+#include <atomic>
+#endif // SIMULATOR
+
 GCP(program);
 GCP(block);
 RECORDER_DECLARE(program);
@@ -50,10 +54,34 @@ struct program : list
     INLINE static result run_program(object_p obj)  { return run(obj, false); }
 
     static result        run_loop(size_t depth);
+    static void          decode_flush(object_p start, size_t size);
+    enum { DECODE_CACHE = 32 };         // Entries in the decode cache
 
     static program_p     parse(utf8 source, size_t size);
 
-    static bool          interrupted(); // Program interrupted e.g. by EXIT key
+    static INLINE bool   interrupted()
+    // ------------------------------------------------------------------------
+    //   Program interrupted e.g. by EXIT key - Single load in the fast path
+    // ------------------------------------------------------------------------
+    {
+#if !SIMULATOR
+        // DMCP has no timer callbacks: derive the tick from a countdown
+        if (!--tick_countdown)
+            ticked = true;
+#endif // SIMULATOR
+        return ticked ? poll() : halted;
+    }
+    static bool          poll();        // Periodic work: keys, battery, busy
+    static INLINE void   tick()         { ticked = true; }
+    enum { TICK_PERIOD = 5 };           // Milliseconds between ticks
+    enum { TICK_COUNT  = 32 };          // Calls between ticks on DMCP
+#if SIMULATOR
+    typedef std::atomic<bool> tick_flag; // Set from the timer thread
+#else // !SIMULATOR
+    typedef bool         tick_flag;     // Set from the countdown
+    static uint          tick_countdown;
+#endif // SIMULATOR
+    static tick_flag     ticked;        // Set by the periodic tick
     static bool          low_battery();
     static void          read_battery();
 
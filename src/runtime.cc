@@ -33,11 +33,18 @@
 #include "compare.h"
 #include "constants.h"
 #include "expression.h"
+#include "file.h"
+#include "hash.h"
 #include "integer.h"
 #include "object.h"
+#include "plot.h"
 #include "program.h"
+#include "solve.h"
+#include "stats.h"
+#include "unit.h"
 #include "user_interface.h"
 #include "variables.h"
+#include "version.h"
 
 #include <cstring>
 
@@ -150,6 +157,11 @@ void runtime::memory(byte *memory, size_t size)
     Temporaries = Globals;                      // Area for temporaries
     Editing = 0;                                // No editor
     Scratch = 0;                                // No scratchpad
+    uncache();                                  // Nothing cached
+    expression::memo_flush();                   // Nothing memoized
+    plot_cache_flush();                         // No plot samples
+    stats_cache_flush();                        // No statistics accumulated
+    unit::lookup_flush();                       // No units looked up
 
     record(runtime, "Memory %p-%p size %u (%uK)",
            LowMem, HighMem, size, size>>10);
@@ -199,6 +211,13 @@ size_t runtime::available(size_t size)
     {
         gc();
         size_t avail = available();
+        if (avail < size &&
+            (expression::memo_flush() | unit::lookup_flush() |
+             stats_cache_flush() | solver_cache_flush()))
+        {
+            gc();
+            avail = available();
+        }
         if (avail < size)
             out_of_memory_error();
         return avail;
@@ -422,6 +441,7 @@ void runtime::uncache(object_p start, size_t sz)
                 ptr = nullptr;
         }
     }
+    program::decode_flush(start, sz);
 }
 
 
@@ -689,7 +709,7 @@ void runtime::move_globals(object_p to, object_p from)
     Temporaries += delta;
 
     // Remove all cached entries, they may be covered by what we moved
-    uncache(from, moving);
+    uncache(first, last - first);
 }
 
 #ifdef DM42
@@ -1499,6 +1519,7 @@ bool runtime::enter(directory_p dir)
 // ----------------------------------------------------------------------------
 {
     runtime_invariants check;
+    plot_cache_flush();
 
     // Check if this is a directory up
     size_t depth = (object_p *) XLibs - Directories;
@@ -1506,6 +1527,10 @@ bool runtime::enter(directory_p dir)
         if (dir == Directories[i])
             return !i || updir(i);
 
+    // Names defined in the new directory hide those we memoized with
+    expression::memo_forget(dir);
+    solver_cache_flush();
+
     size_t sz = sizeof(directory_p);
     if (available(sz) < sz)
         return false;
@@ -1534,12 +1559,18 @@ bool runtime::updir(size_t count)
 // ----------------------------------------------------------------------------
 {
     runtime_invariants check;
+    plot_cache_flush();
     size_t depth = XLibs - Directories;
     if (count >= depth - 1)
         count = depth - 1;
     if (!count)
         return false;
 
+    // Names defined in the directories we leave were used when memoizing
+    for (size_t i = 0; i < count; i++)
+        expression::memo_forget(directory_p(Directories[i]));
+    solver_cache_flush();
+
     // Move pointers up
     object_p *oldp = Directories;
     Stack += count;
@@ -1598,6 +1629,209 @@ bool runtime::attach(size_t nentries)
 
 
 
+// ============================================================================
+//
+//   Binary state images
+//
+// ============================================================================
+//
+//   A state image is a copy of the global objects (the home directory),
+//   the objects on the stack, the current menu, the settings and the
+//   current path, saved next to a state file. Global objects contain no
+//   pointers, so they are loaded in place with a single read. The stack
+//   objects are read as temporaries, and the path is saved as offsets
+//   from the start of memory, so that loading only needs to fix up the
+//   stack and directory pointers. An image is only loaded if it was saved
+//   by the same firmware, and for the same source state file, which is
+//   loaded instead otherwise.
+
+struct state_image
+// ----------------------------------------------------------------------------
+//   Header of a binary state image
+// ----------------------------------------------------------------------------
+{
+    enum { MAGIC = 0x49534244, VERSION = 1 }; // "DBSI" as little-endian
+
+    uint32_t magic;             // Identifies a state image
+    uint32_t version;           // Version of the image format
+    uint32_t build;             // Hash of the firmware object layout
+    uint32_t source;            // Hash of the matching state file
+    uint32_t globals;           // Size of global objects
+    uint32_t objects;           // Size of stack and menu objects
+    uint32_t depth;             // Number of objects on the stack
+    uint32_t menu;              // Non-zero if there is a menu object
+    uint32_t path;              // Number of directories in path after home
+    uint32_t settings;          // Size of the settings
+    uint32_t checksum;          // Hash of the image data
+};
+
+
+static uint32_t image_build()
+// ----------------------------------------------------------------------------
+//   Identify the object layout of the current firmware
+// ----------------------------------------------------------------------------
+//   The image is only valid if object IDs and settings did not change
+{
+    uint32_t h = FNV_BASIS;
+    uint32_t sizes[] = { object::NUM_IDS, sizeof(settings), sizeof(object_p) };
+    h = fnv1a(h, DB48X_VERSION, sizeof(DB48X_VERSION));
+    h = fnv1a(h, sizes, sizeof(sizes));
+    for (size_t i = 0; i < object::spelling_count; i++)
+    {
+        auto &s = object::spellings[i];
+        h = fnv1a(h, &s.type, sizeof(s.type));
+        if (s.name)
+            h = fnv1a(h, s.name, strlen(s.name));
+    }
+    return h;
+}
+
+
+bool runtime::save_image(file &f, uint32_t source, object_p menu)
+// ----------------------------------------------------------------------------
+//   Save a binary image of the global objects, stack and settings
+// ----------------------------------------------------------------------------
+{
+    state_image hdr;
+    byte_p      base    = byte_p(LowMem);
+    uint        depth   = Args - Stack;
+    uint        path    = directories() - 1;
+
+    hdr.magic    = state_image::MAGIC;
+    hdr.version  = state_image::VERSION;
+    hdr.build    = image_build();
+    hdr.source   = source;
+    hdr.globals  = byte_p(Globals) - base;
+    hdr.objects  = 0;
+    hdr.depth    = depth;
+    hdr.menu     = menu != nullptr;
+    hdr.path     = path;
+    hdr.settings = sizeof(settings);
+
+    // Compute the checksum in the order the data is written
+    uint32_t h = fnv1a(base, hdr.globals);
+    for (uint i = depth; i-- > 0; )
+    {
+        size_t sz = Stack[i]->size();
+        h = fnv1a(h, Stack[i], sz);
+        hdr.objects += sz;
+    }
+    if (menu)
+    {
+        size_t sz = menu->size();
+        h = fnv1a(h, menu, sz);
+        hdr.objects += sz;
+    }
+    h = fnv1a(h, &Settings, sizeof(Settings));
+    for (uint i = path; i-- > 0; )
+    {
+        uint32_t offset = byte_p(Directories[i]) - base;
+        h = fnv1a(h, &offset, sizeof(offset));
+    }
+    hdr.checksum = h;
+
+    // Write the data
+    bool ok = f.write((const char *) &hdr, sizeof(hdr));
+    ok = ok && f.write((const char *) base, hdr.globals);
+    for (uint i = depth; ok && i-- > 0; )
+        ok = f.write((const char *) Stack[i], Stack[i]->size());
+    if (ok && menu)
+        ok = f.write((const char *) menu, menu->size());
+    ok = ok && f.write((const char *) &Settings, sizeof(Settings));
+    for (uint i = path; ok && i-- > 0; )
+    {
+        uint32_t offset = byte_p(Directories[i]) - base;
+        ok = f.write((const char *) &offset, sizeof(offset));
+    }
+    record(runtime, "Saved image, %u bytes globals, %u bytes objects: %+s",
+           hdr.globals, hdr.objects, ok ? "OK" : "failed");
+    return ok;
+}
+
+
+bool runtime::load_image(file &f, uint32_t source, object_p &menu)
+// ----------------------------------------------------------------------------
+//   Load a binary image saved by save_image, return false if not valid
+// ----------------------------------------------------------------------------
+//   On failure, the runtime is reset to a clean state
+{
+    state_image hdr;
+    menu = nullptr;
+    if (!f.read((char *) &hdr, sizeof(hdr)))
+        return false;
+    if (hdr.magic    != state_image::MAGIC     ||
+        hdr.version  != state_image::VERSION   ||
+        hdr.source   != source                 ||
+        hdr.settings != sizeof(settings)       ||
+        hdr.build    != image_build())
+        return false;
+
+    // Check that we have room for everything
+    reset();
+    byte  *base    = (byte *) LowMem;
+    size_t data    = size_t(hdr.globals) + hdr.objects;
+    size_t offsets = hdr.path * sizeof(uint32_t);
+    size_t ptrs    = (hdr.depth + hdr.path) * sizeof(object_p);
+    size_t avail   = (byte *) Stack - base;
+    if (hdr.globals < directory::required_memory(object::ID_directory) ||
+        data + offsets + ptrs + redzone > avail)
+        return false;
+
+    // Read global and stack objects with one read, then settings and path
+    settings saved;
+    byte    *path = base + data;
+    bool     ok   = (f.read((char *) base, data) &&
+                     f.read((char *) &saved, sizeof(saved)) &&
+                     f.read((char *) path, offsets));
+    uint32_t h = fnv1a(base, data);
+    h = fnv1a(h, &saved, sizeof(saved));
+    h = fnv1a(h, path, offsets);
+    if (!ok || h != hdr.checksum || object_p(base)->type() != object::ID_directory)
+    {
+        reset();
+        return false;
+    }
+
+    // Enter directories in the path, from the outermost one
+    Globals = (object_p) (base + hdr.globals);
+    Temporaries = Globals;
+    for (uint i = 0; ok && i < hdr.path; i++)
+    {
+        uint32_t offset;
+        memcpy(&offset, path + i * sizeof(offset), sizeof(offset));
+        object_p dir = (object_p) (base + offset);
+        ok = offset < hdr.globals && dir->type() == object::ID_directory &&
+            enter(directory_p(dir));
+    }
+
+    // Stack objects and menu become temporaries, room was checked above
+    Temporaries = (object_p) path;
+    object_p end = Temporaries;
+    object_p obj = Globals;
+    for (uint i = 0; ok && i < hdr.depth; i++)
+    {
+        ok = obj < end && obj->skip() <= end && push(obj);
+        obj = obj->skip();
+    }
+    if (ok && hdr.menu)
+        menu = obj;
+    Settings = saved;
+    if (!ok)
+    {
+        reset();
+        Settings = settings();
+        menu = nullptr;
+        return false;
+    }
+
+    record(runtime, "Loaded image, %u bytes globals, %u bytes objects",
+           hdr.globals, hdr.objects);
+    runtime_invariants check;
+    return true;
+}
+
+
+
 // ============================================================================
 //
 //   Return stack
@@ -1845,6 +2079,52 @@ bool runtime::run_select_case(bool condition)
 }
 
 
+object_p runtime::run_peek(uint ahead) const
+// ----------------------------------------------------------------------------
+//   Look at an upcoming object in the current code block without running it
+// ----------------------------------------------------------------------------
+//   This only looks at the innermost block, since outer blocks may contain
+//   alternatives (e.g. conditionals) that will not necessarily be executed
+{
+    runtime_invariants check;
+    if (Returns >= HighMem)
+        return nullptr;
+    object_p next = Returns[0];
+    object_p end  = Returns[1] + 1;
+    while (next && next < end)
+    {
+        if (!ahead--)
+            return next;
+        next = next->skip();
+    }
+    return nullptr;
+}
+
+
+bool runtime::run_skip(uint count)
+// ----------------------------------------------------------------------------
+//   Skip objects in the current code block, return true if some remain
+// ----------------------------------------------------------------------------
+{
+    runtime_invariants check;
+    if (Returns >= HighMem)
+        return false;
+    object_p next = Returns[0];
+    object_p end  = Returns[1] + 1;
+    if (!next)                  // Local variables frame
+        return false;
+    while (count-- && next < end)
+        next = next->skip();
+    if (next >= end)
+    {
+        call_stack_drop(2);
+        return false;
+    }
+    Returns[0] = next;
+    return true;
+}
+
+
 bool runtime::call_stack_grow(object_p &next, object_p &end)
 // ----------------------------------------------------------------------------
 //   Grow the call stack by a block
@@ -2056,6 +2336,7 @@ object_p cleaner::adjust(object_p temp)
                temp - temporaries, sz, temp, temporaries,
                rt.Temporaries, temporaries + sz);
         rt.GCCleared += temp - temporaries;
+        rt.uncache(temporaries, rt.Temporaries - temporaries);
         memmove((void *) temporaries, temp, sz);
         if (size_t scsz = rt.Editing + rt.Scratch)
             rt.move(temporaries + sz, rt.Temporaries, scsz, 1, 1);
@@ -93,6 +93,7 @@ struct directory;               // Directory (storing global variables)
 struct symbol;                  // Symbols (references to a directory)
 struct text;
 struct algebraic;
+struct file;                    // Files on disk
 typedef const object *object_p;
 typedef const directory *directory_p;
 typedef const text *text_p;
@@ -589,13 +590,13 @@ struct runtime
         return true;
     }
 
-    inline object_p run_next(size_t depth)
+    template <typename Skip>
+    inline object_p run_next(size_t depth, Skip &skip)
     // ------------------------------------------------------------------------
     //   Pull the next object to execute from the RPL evaluation stack
     // ------------------------------------------------------------------------
-    //   Getting proper inlining here is important for performance, but
-    //   that requires the definition of object::skip()
-#ifdef OBJECT_H
+    //   The `skip` argument computes the object following the one returned,
+    //   which must not be beyond the end of the current code block
     {
         runtime_invariants check;
         object_p *high = HighMem - depth;
@@ -607,7 +608,7 @@ struct runtime
             {
                 if (next)
                 {
-                    object_p nnext = next->skip();
+                    object_p nnext = skip(next, end);
                     Returns[0] = nnext;
                     if (nnext >= end)
                         // Note that call_stack_drop() cannot and MUST NOT GC
@@ -622,6 +623,18 @@ struct runtime
         }
         return nullptr;
     }
+
+    inline object_p run_next(size_t depth)
+    // ------------------------------------------------------------------------
+    //   Pull the next object to execute from the RPL evaluation stack
+    // ------------------------------------------------------------------------
+    //   Getting proper inlining here is important for performance, but
+    //   that requires the definition of object::skip()
+#ifdef OBJECT_H
+    {
+        auto skip = [](object_p obj, object_p) { return obj->skip(); };
+        return run_next(depth, skip);
+    }
 #else // !OBJECT_H
     // Don't have the definition of object::skip() - Simply mark as inline
     ;
@@ -643,6 +656,17 @@ struct runtime
     }
 
 
+    object_p run_peek(uint ahead = 0) const;
+    // ------------------------------------------------------------------------
+    //   Look ahead in the current code block without executing anything
+    // ------------------------------------------------------------------------
+
+    bool run_skip(uint count);
+    // ------------------------------------------------------------------------
+    //   Skip objects in the current code block without executing them
+    // ------------------------------------------------------------------------
+
+
     bool run_conditionals(object_p trueC, object_p falseC, bool xeq = false);
     // ------------------------------------------------------------------------
     //   Push true and false paths on the evaluation stack
@@ -893,6 +917,17 @@ struct runtime
 
 
 
+    // ========================================================================
+    //
+    //   Binary state images
+    //
+    // ========================================================================
+
+    bool save_image(file &f, uint32_t source, object_p menu);
+    bool load_image(file &f, uint32_t source, object_p &menu);
+
+
+
     // ========================================================================
     //
     //   Library items
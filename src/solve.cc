@@ -33,6 +33,7 @@
 #include "arithmetic.h"
 #include "array.h"
 #include "compare.h"
+#include "compiled.h"
 #include "equations.h"
 #include "expression.h"
 #include "functions.h"
@@ -96,6 +97,454 @@ static algebraic_p recall(algebraic_r namer)
     return nullptr;
 }
 
+static uint evaluations = 0;
+static const uint NEWTON_ITERATIONS = 20;
+static const uint BRENT_RETRIES     = 8;
+
+
+static algebraic_p evaluate_equation(program_r           eq,
+                                     compiled_expression &code,
+                                     algebraic_r         x)
+// ----------------------------------------------------------------------------
+//   Evaluate the equation, counting evaluations
+// ----------------------------------------------------------------------------
+{
+    evaluations++;
+    return code.evaluate(eq, x);
+}
+
+
+static inline bool less(algebraic_r x, algebraic_r y)
+// ----------------------------------------------------------------------------
+//   Check if x < y
+// ----------------------------------------------------------------------------
+{
+    algebraic_g cmp = x < y;
+    return cmp && cmp->as_truth(false);
+}
+
+
+// ============================================================================
+//
+//   Cache of symbolic derivatives
+//
+// ============================================================================
+//
+//   Solving the same equation for the same variable again, e.g. from the
+//   Solving menu, reuses the symbolic derivative computed the first time.
+//   Derivatives treat the unknowns as symbols, so entries are kept when the
+//   solver stores the unknowns. They are dropped when another name they
+//   mention is stored or purged, when the directory changes, and when
+//   running low on memory.
+
+struct derivative_cache
+// ----------------------------------------------------------------------------
+//   Remember the derivative of an equation for a variable
+// ----------------------------------------------------------------------------
+{
+    enum { ENTRIES = 8 };
+
+    struct entry
+    {
+        uint32_t     settings;
+        bool         valid;
+        expression_g eq;
+        symbol_g     var;
+        expression_g deriv;     // Null if there is no symbolic derivative
+    };
+
+    static expression_p derivative(expression_r eq, symbol_r var);
+    static bool         unknown(symbol_p name);
+    static bool         forget(symbol_p name);
+    static bool         flush();
+
+    static entry  *table;
+    static uint    next;
+    static list_g *unknowns;    // Unknowns of the system being solved
+};
+
+derivative_cache::entry *derivative_cache::table    = nullptr;
+uint                     derivative_cache::next     = 0;
+list_g                  *derivative_cache::unknowns = nullptr;
+
+
+expression_p derivative_cache::derivative(expression_r eq, symbol_r var)
+// ----------------------------------------------------------------------------
+//   Return the symbolic derivative of `eq` for `var`, nullptr if none
+// ----------------------------------------------------------------------------
+{
+    uint32_t settings = Settings.hash();
+    if (table)
+    {
+        for (uint i = 0; i < ENTRIES; i++)
+        {
+            entry &e = table[i];
+            if (e.valid && e.settings == settings &&
+                e.var->is_same_as(+var) && e.eq->is_same_as(+eq))
+            {
+                record(solve, "Cached derivative %t for %t", +e.deriv, +eq);
+                return e.deriv;
+            }
+        }
+    }
+
+    // Do not remember failures, which may be caused by low memory
+    expression_g deriv = eq->derivative(var);
+    rt.clear_error();
+    if (!deriv || program::interrupted())
+        return nullptr;
+
+    // Derivatives that could not be computed symbolically are not usable
+    for (object_p obj : *deriv)
+        if (obj->type() == object::ID_Derivative)
+            deriv = nullptr;
+
+    if (!table)
+    {
+        // No operator new[] nor operator delete[] in embedded runtime
+        table = (entry *) calloc(ENTRIES, sizeof(entry));
+        if (!table)
+            return deriv;
+        for (uint i = 0; i < ENTRIES; i++)
+            new(table + i) entry();
+    }
+    entry &e = table[next++ % ENTRIES];
+    e.settings = settings;
+    e.valid = true;
+    e.eq = eq;
+    e.var = var;
+    e.deriv = deriv;
+    return deriv;
+}
+
+
+bool derivative_cache::unknown(symbol_p name)
+// ----------------------------------------------------------------------------
+//   Check if a name is an unknown the solver is currently solving for
+// ----------------------------------------------------------------------------
+{
+    if (expression::independent)
+        if (symbol_p indep = *expression::independent)
+            if (indep->is_same_as(name))
+                return true;
+    if (unknowns)
+        if (list_p vars = *unknowns)
+            for (object_p obj : *vars)
+                if (symbol_p var = obj->as_quoted<symbol>())
+                    if (var->is_same_as(name))
+                        return true;
+    return false;
+}
+
+
+bool derivative_cache::forget(symbol_p name)
+// ----------------------------------------------------------------------------
+//   Forget derivatives that mention a name, unless taken for that name
+// ----------------------------------------------------------------------------
+{
+    if (!table || unknown(name))
+        return false;
+    bool freed = false;
+    for (uint i = 0; i < ENTRIES; i++)
+    {
+        entry &e = table[i];
+        if (!e.valid || e.var->is_same_as(name))
+            continue;
+        if (name->found_in(+e.eq) || name->found_in(+e.deriv))
+        {
+            freed = true;
+            e.valid = false;
+            e.eq = nullptr;
+            e.var = nullptr;
+            e.deriv = nullptr;
+        }
+    }
+    return freed;
+}
+
+
+bool derivative_cache::flush()
+// ----------------------------------------------------------------------------
+//   Forget all cached derivatives, return true if anything was freed
+// ----------------------------------------------------------------------------
+{
+    if (!table)
+        return false;
+    bool freed = false;
+    for (uint i = 0; i < ENTRIES; i++)
+    {
+        entry &e = table[i];
+        freed = freed || e.valid;
+        e.valid = false;
+        e.eq = nullptr;
+        e.var = nullptr;
+        e.deriv = nullptr;
+    }
+    return freed;
+}
+
+
+bool solver_cache_forget(object_p name)
+// ----------------------------------------------------------------------------
+//   Forget cached derivatives that may depend on a variable
+// ----------------------------------------------------------------------------
+{
+    if (symbol_p sym = name->as_quoted<symbol>())
+        return derivative_cache::forget(sym);
+    return derivative_cache::flush();
+}
+
+
+bool solver_cache_flush()
+// ----------------------------------------------------------------------------
+//   Forget all cached derivatives, e.g. when running low on memory
+// ----------------------------------------------------------------------------
+{
+    return derivative_cache::flush();
+}
+
+
+static algebraic_p newton(program_r           eq,
+                          compiled_expression &code,
+                          symbol_r            name,
+                          algebraic_r         guess,
+                          algebraic_r         eps,
+                          uint                max,
+                          algebraic_r         lo,
+                          algebraic_r         hi)
+// ----------------------------------------------------------------------------
+//   Try Newton's method using the symbolic derivative of the equation
+// ----------------------------------------------------------------------------
+//   The derivative comes from the derivative cache, so that solving the
+//   same equation again does not differentiate it again.
+//   This gives up as soon as the method does not converge fast, or when
+//   an iterate leaves the [lo, hi] interval given by the user, leaving the
+//   slower but more robust bracketing algorithm do the work. Return nullptr
+//   in that case.
+{
+    expression_g expr = eq->as<expression>();
+    if (!expr)
+        return nullptr;
+    expression_g deriv = derivative_cache::derivative(expr, name);
+    if (!deriv)
+        return nullptr;
+
+    program_g           dprog = +deriv;
+    compiled_expression dcode(dprog);
+    algebraic_g         x     = guess;
+    algebraic_g         yeps  = eps;
+    algebraic_g         half  = decimal::make(5, -1);
+    algebraic_g         y, dy, last;
+
+    // Work with decimal values, fractions would quickly grow very large
+    if (!algebraic::to_decimal(x))
+    {
+        rt.clear_error();
+        return nullptr;
+    }
+
+    for (uint i = 0; i < max && !program::interrupted(); i++)
+    {
+        y = evaluate_equation(eq, code, x);
+        if (!y || !y->is_real())
+            break;
+
+        // Scale the precision like the main solver loop does
+        if (!i && !y->is_zero(false))
+            if (algebraic_g neps = abs::run(y) * yeps)
+                if (smaller_magnitude(yeps, neps))
+                    yeps = neps;
+
+        record(solve, "Newton [%u] x=%t y=%t", i, +x, +y);
+        if (y->is_zero(false) || smaller_magnitude(y, yeps))
+            return x;
+
+        // Give up unless |y| decreases at least by half at each step
+        if (last && !smaller_magnitude(y, last))
+            break;
+        last = y * half;
+
+        evaluations++;
+        dy = dcode.evaluate(dprog, x);
+        if (!dy || !dy->is_real() || dy->is_zero(false))
+            break;
+        x = x - y / dy;
+        if (!x || !x->is_real())
+            break;
+
+        // Do not look for a solution outside of the user-supplied bracket
+        if (lo && hi && (less(x, lo) || less(hi, x)))
+        {
+            record(solve, "Newton [%u] x=%t outside [%t, %t]", i, +x, +lo, +hi);
+            break;
+        }
+    }
+    rt.clear_error();
+    return nullptr;
+}
+
+
+static algebraic_p brent(program_r           eq,
+                         compiled_expression &code,
+                         algebraic_g         a,
+                         algebraic_g         fa,
+                         algebraic_g         b,
+                         algebraic_g         fb,
+                         algebraic_r         yeps,
+                         uint                max)
+// ----------------------------------------------------------------------------
+//   Brent's method, when we know that the solution is between a and b
+// ----------------------------------------------------------------------------
+//   This combines inverse quadratic interpolation, secant steps and
+//   bisection, and is guaranteed to keep the solution within the bracket.
+//   This follows the classical zbrent algorithm. The bracket is considered
+//   small enough relative to b, or relative to the initial bracket when b
+//   gets close to zero.
+{
+    algebraic_g zero  = integer::make(0);
+    algebraic_g one   = integer::make(1);
+    algebraic_g two   = integer::make(2);
+    algebraic_g three = integer::make(3);
+    algebraic_g c     = a;
+    algebraic_g fc    = fa;
+    algebraic_g d     = b - a;
+    algebraic_g e     = d;
+    algebraic_g xeps  = abs::run(d) * yeps;
+    algebraic_g tol, xm, p, q, r, s, min1, min2;
+
+    for (uint i = 0; i < max && !program::interrupted(); i++)
+    {
+        // Make sure that the solution is between b and c
+        if (fb->is_negative(false) == fc->is_negative(false))
+        {
+            c  = a;
+            fc = fa;
+            d  = b - a;
+            e  = d;
+        }
+
+        // Make sure that b is the best estimate
+        if (smaller_magnitude(fc, fb))
+        {
+            a  = b;
+            b  = c;
+            c  = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+
+        tol = abs::run(b) * yeps;
+        if (tol && smaller_magnitude(tol, xeps))
+            tol = xeps;
+        xm  = (c - b) / two;
+        if (!tol || !xm)
+            return nullptr;
+        record(solve, "Brent [%u] x=%t y=%t [%t, %t]", i, +b, +fb, +b, +c);
+        if (fb->is_zero(false) || smaller_magnitude(fb, yeps))
+        {
+            record(solve, "Brent [%u] Solution=%t value=%t", i, +b, +fb);
+            store(b);
+            return b;
+        }
+        if (!smaller_magnitude(tol, xm))
+        {
+            // The bracket is too small, there is a sign reversal
+            record(solve, "Brent [%u] Sign reversal=%t value=%t", i, +b, +fb);
+            rt.sign_reversal_error();
+            solver_command_error();
+            store(b);
+            return b;
+        }
+
+        if (!smaller_magnitude(e, tol) && smaller_magnitude(fb, fa))
+        {
+            // Attempt interpolation
+            s = fb / fa;
+            if (+a == +c)
+            {
+                // Secant step
+                p = two * xm * s;
+                q = one - s;
+            }
+            else
+            {
+                // Inverse quadratic interpolation
+                q = fa / fc;
+                r = fb / fc;
+                p = s * (two * xm * q * (q - r) - (b - a) * (r - one));
+                q = (q - one) * (r - one) * (s - one);
+            }
+            if (!p || !q)
+                return nullptr;
+            if (less(zero, p))
+                q = -q;
+            p    = abs::run(p);
+            min1 = three * xm * q - abs::run(tol * q);
+            min2 = abs::run(e * q);
+            if (less(min2, min1))
+                min1 = min2;
+            if (less(two * p, min1))
+            {
+                // Accept interpolation
+                e = d;
+                d = p / q;
+            }
+            else
+            {
+                // Interpolation failed, use bisection
+                d = xm;
+                e = d;
+            }
+        }
+        else
+        {
+            // Bounds decreasing too slowly, use bisection
+            d = xm;
+            e = d;
+        }
+
+        a  = b;
+        fa = fb;
+        if (smaller_magnitude(tol, d))
+            b = b + d;
+        else if (xm->is_negative(false))
+            b = b - tol;
+        else
+            b = b + tol;
+        if (!b || !algebraic::to_decimal_if_big(b))
+            return nullptr;
+
+        // If evaluation fails, e.g. on a pole, move back towards a
+        for (uint retry = 0; ; retry++)
+        {
+            fb = evaluate_equation(eq, code, b);
+            if (fb && fb->is_real())
+                break;
+            if (retry >= BRENT_RETRIES)
+            {
+                if (!rt.error())
+                    rt.bad_guess_error();
+                solver_command_error();
+                store(a);
+                return nullptr;
+            }
+            record(solve_error, "Brent evaluation failed at %t: %+s",
+                   +b, rt.error());
+            rt.clear_error();
+            b = (a + b) / two;
+            if (!b)
+                return nullptr;
+        }
+    }
+
+    rt.no_solution_error();
+    solver_command_error();
+    store(b);
+    return nullptr;
+}
+
+
 algebraic_p Root::solve(program_r pgm, algebraic_r goal, algebraic_r guess)
 // ----------------------------------------------------------------------------
 //   The core of the solver, numerical solving for a single variable
@@ -165,10 +614,12 @@ algebraic_p Root::solve(program_r pgm, algebraic_r goal, algebraic_r guess)
     bool is_complex = lx->is_complex() || hx->is_complex();
 
     // Check if low and hight are identical, if so pick hx=1.01*lx
+    bool bracketed = is_array_or_list(gty);
     if (algebraic_p diff = hx - lx)
     {
         if (diff->is_zero(true))
         {
+            bracketed = false;
             algebraic_g delta =
                 +fraction::make(integer::make(1234), integer::make(997));
             if (!hx->is_zero(true))
@@ -216,6 +667,33 @@ algebraic_p Root::solve(program_r pgm, algebraic_r goal, algebraic_r guess)
     algebraic_g      two         = integer::make(2);
     int              degraded    = 0;
 
+    // Compile the equation to hardware floating-point if possible
+    compiled_expression code(eq);
+    evaluations = 0;
+
+    // Try Newton's method first if we can compute the derivative
+    if (!is_complex && !uexpr)
+    {
+        uint newton_max = max < NEWTON_ITERATIONS ? max : NEWTON_ITERATIONS;
+        algebraic_g lo, hi;
+        if (bracketed)
+        {
+            lo = less(hx, lx) ? hx : lx;
+            hi = +lo == +lx ? hx : lx;
+        }
+        if (algebraic_g root = newton(eq, code, name, x, yeps, newton_max,
+                                      lo, hi))
+        {
+            record(solve, "Newton solution %t after %u evaluations",
+                   +root, evaluations);
+            store(root);
+            return root;
+        }
+    }
+
+    // Points on each side of the solution, to switch to Brent's method
+    algebraic_g bnx, bny, bpx, bpy;
+
     for (uint i = 0; i < max && !program::interrupted(); i++)
     {
         // If we failed during evaluation of x, break
@@ -234,7 +712,7 @@ algebraic_p Root::solve(program_r pgm, algebraic_r goal, algebraic_r guess)
         }
 
         // Evaluate equation
-        y = algebraic::evaluate_function(eq, x);
+        y = evaluate_equation(eq, code, x);
 
         // If the function evaluates as 10^23 and eps=10^-18, use 10^(23-18)
         if (!i && y && !y->is_zero())
@@ -277,6 +755,29 @@ algebraic_p Root::solve(program_r pgm, algebraic_r goal, algebraic_r guess)
                 return x;
             }
 
+            // Once the solution is bracketed, Brent's method converges fast
+            if (!is_complex && !uexpr && dy->is_real())
+            {
+                if (dy->is_negative(false))
+                {
+                    bnx = x;
+                    bny = dy;
+                }
+                else
+                {
+                    bpx = x;
+                    bpy = dy;
+                }
+                if (bnx && bpx)
+                {
+                    record(solve, "[%u] Bracket [%t, %t]", i, +bnx, +bpx);
+                    x = brent(eq, code, bnx, bny, bpx, bpy, yeps, max - i);
+                    record(solve, "Brent result %t after %u evaluations",
+                           +x, evaluations);
+                    return x;
+                }
+            }
+
             if (!ly)
             {
                 record(solve, "Setting low %t=f(%t)", +y, +x);
@@ -555,10 +1056,274 @@ algebraic_p Root::solve(algebraic_g &eq,
 }
 
 
+static const uint NEWTON_SYSTEM_MAX      = 8;
+static const uint NEWTON_SYSTEM_HALVINGS = 12;
+
+
+static bool evaluate_system(expression_g eq[],
+                            symbol_g     var[],
+                            algebraic_g  x[],
+                            algebraic_g  f[],
+                            size_t       n)
+// ----------------------------------------------------------------------------
+//   Store the values of all variables, then evaluate all equations
+// ----------------------------------------------------------------------------
+{
+    for (size_t j = 0; j < n; j++)
+        if (!directory::store_here(var[j], x[j]))
+            return false;
+    for (size_t i = 0; i < n; i++)
+    {
+        evaluations++;
+        f[i] = eq[i]->evaluate();
+        if (!f[i] || !f[i]->is_real())
+            return false;
+    }
+    return true;
+}
+
+
+static algebraic_p sum_of_squares(algebraic_g f[], size_t n)
+// ----------------------------------------------------------------------------
+//   Compute the sum of squares of the residuals
+// ----------------------------------------------------------------------------
+{
+    algebraic_g norm = integer::make(0);
+    for (size_t i = 0; i < n && norm; i++)
+        norm = norm + f[i] * f[i];
+    return norm;
+}
+
+
+static bool linear_solve(algebraic_g a[], algebraic_g b[], size_t n)
+// ----------------------------------------------------------------------------
+//   Solve a.x = b in place using Gaussian elimination with partial pivoting
+// ----------------------------------------------------------------------------
+//   The matrix `a` is stored by rows, and is destroyed in the process.
+//   The result replaces `b`. Return false if the matrix is singular.
+{
+    for (size_t k = 0; k < n; k++)
+    {
+        // Select the largest pivot in the column to limit rounding errors
+        size_t p = k;
+        for (size_t i = k + 1; i < n; i++)
+            if (smaller_magnitude(a[p * n + k], a[i * n + k]))
+                p = i;
+        if (!a[p * n + k] || a[p * n + k]->is_zero(false))
+            return false;
+        if (p != k)
+        {
+            for (size_t j = k; j < n; j++)
+            {
+                algebraic_g t = a[p * n + j];
+                a[p * n + j] = a[k * n + j];
+                a[k * n + j] = t;
+            }
+            algebraic_g t = b[p];
+            b[p] = b[k];
+            b[k] = t;
+        }
+
+        // Eliminate the column below the pivot
+        for (size_t i = k + 1; i < n; i++)
+        {
+            algebraic_g m = a[i * n + k] / a[k * n + k];
+            for (size_t j = k + 1; j < n; j++)
+                a[i * n + j] = a[i * n + j] - m * a[k * n + j];
+            b[i] = b[i] - m * b[k];
+        }
+    }
+
+    // Back substitution
+    for (size_t k = n; k-- > 0; )
+    {
+        algebraic_g s = b[k];
+        for (size_t j = k + 1; j < n; j++)
+            s = s - a[k * n + j] * b[j];
+        b[k] = s / a[k * n + k];
+        if (!b[k] || !b[k]->is_real())
+            return false;
+    }
+    return true;
+}
+
+
+static bool newton_system(list_r eqns, list_r vars, list_r guesses)
+// ----------------------------------------------------------------------------
+//   Solve coupled equations simultaneously with a damped Newton-Raphson
+// ----------------------------------------------------------------------------
+//   This is used when the equations cannot be solved one variable at a time.
+//   The Jacobian uses the symbolic derivatives when they can be computed, and
+//   forward finite differences otherwise. Each step solves J.dx = -F, and is
+//   halved until the sum of squares of the residuals decreases.
+//   Return false without an error if the method does not apply, e.g. with
+//   units or complex values, and with an error if it fails to converge.
+{
+    size_t n = vars->items();
+    if (!n || n != eqns->items() || n > NEWTON_SYSTEM_MAX)
+        return false;
+    save<list_g *> sunknowns(derivative_cache::unknowns, (list_g *) &vars);
+
+    const size_t N = NEWTON_SYSTEM_MAX;
+    expression_g eq[N];
+    symbol_g     var[N];
+    algebraic_g  x[N], f[N], dx[N], nx[N], nf[N];
+    expression_g deriv[N * N];
+    algebraic_g  jac[N * N];
+
+    list::iterator vi = vars->begin();
+    list::iterator gi = guesses->begin();
+    list::iterator ei = eqns->begin();
+    for (size_t i = 0; i < n; i++)
+    {
+        var[i] = (*vi)->as_quoted<symbol>();
+        x[i] = (*gi)->as_algebraic();
+        eq[i] = expression::get(*ei);
+        if (!var[i] || !x[i] || !x[i]->is_real() || !eq[i])
+            return false;
+        if (!algebraic::to_decimal(x[i]))
+            return false;
+        if (expression_g diff = eq[i]->as_difference_for_solve())
+            eq[i] = diff;
+        ++vi;
+        ++gi;
+        ++ei;
+    }
+
+    // Symbolic derivatives, from the cache if we solved this system before
+    for (size_t i = 0; i < n; i++)
+        for (size_t j = 0; j < n; j++)
+            deriv[i * n + j] = derivative_cache::derivative(eq[i], var[j]);
+
+    settings::PrepareForFunctionEvaluation willEvaluateFunctions;
+    settings::SaveNumericalConstants snc(true);
+    int         prec  = Settings.Precision() - Settings.SolverImprecision();
+    algebraic_g yeps  = decimal::make(1, prec <= 0 ? -1 : -prec);
+    algebraic_g heps  = decimal::make(1, -(prec + 1) / 2);
+    algebraic_g half  = decimal::make(5, -1);
+    algebraic_g one   = integer::make(1);
+    uint        max   = Settings.SolverIterations();
+    algebraic_g norm, lambda, h;
+
+    evaluations = 0;
+    if (!evaluate_system(eq, var, x, f, n))
+        return false;
+    norm = sum_of_squares(f, n);
+    if (!norm)
+        return false;
+
+    // Scale the precision with the initial residuals, like for one variable
+    algebraic_g ftol[N];
+    for (size_t i = 0; i < n; i++)
+    {
+        ftol[i] = abs::run(f[i]) * yeps;
+        if (!ftol[i] || smaller_magnitude(ftol[i], yeps))
+            ftol[i] = yeps;
+    }
+
+    for (uint iter = 0; iter < max && !program::interrupted(); iter++)
+    {
+        // Check if all residuals are small enough
+        bool done = true;
+        for (size_t i = 0; done && i < n; i++)
+            done = f[i]->is_zero(false) || smaller_magnitude(f[i], ftol[i]);
+        record(solve, "Newton system [%u] norm=%t", iter, +norm);
+        if (done)
+            return true;
+
+        // Compute the Jacobian at x, the variables currently hold x
+        for (size_t j = 0; j < n; j++)
+        {
+            bool finite = false;
+            for (size_t i = 0; i < n; i++)
+            {
+                if (expression_p d = deriv[i * n + j])
+                {
+                    evaluations++;
+                    jac[i * n + j] = d->evaluate();
+                    if (!jac[i * n + j] || !jac[i * n + j]->is_real())
+                        return false;
+                }
+                else
+                {
+                    finite = true;
+                }
+            }
+            if (finite)
+            {
+                h = (abs::run(x[j]) + one) * heps;
+                nx[j] = x[j] + h;
+                if (!nx[j] || !directory::store_here(var[j], nx[j]))
+                    return false;
+                for (size_t i = 0; i < n; i++)
+                {
+                    if (!deriv[i * n + j])
+                    {
+                        evaluations++;
+                        algebraic_g fh = eq[i]->evaluate();
+                        if (!fh || !fh->is_real())
+                            return false;
+                        jac[i * n + j] = (fh - f[i]) / h;
+                    }
+                }
+                if (!directory::store_here(var[j], x[j]))
+                    return false;
+            }
+        }
+
+        // Newton step
+        for (size_t i = 0; i < n; i++)
+            dx[i] = -f[i];
+        if (!linear_solve(jac, dx, n))
+        {
+            if (!rt.error())
+                rt.no_solution_error();
+            return false;
+        }
+
+        // Damped step: halve it until the residuals decrease
+        bool accepted = false;
+        lambda = one;
+        for (uint d = 0; !accepted && d < NEWTON_SYSTEM_HALVINGS; d++)
+        {
+            for (size_t j = 0; j < n; j++)
+                nx[j] = x[j] + lambda * dx[j];
+            if (evaluate_system(eq, var, nx, nf, n))
+            {
+                algebraic_g nnorm = sum_of_squares(nf, n);
+                if (nnorm && less(nnorm, norm))
+                {
+                    accepted = true;
+                    norm = nnorm;
+                }
+            }
+            rt.clear_error();
+            lambda = lambda * half;
+        }
+        if (!accepted)
+            break;
+        for (size_t j = 0; j < n; j++)
+        {
+            x[j] = nx[j];
+            f[j] = nf[j];
+        }
+    }
+
+    // Leave the best values found in the variables
+    for (size_t j = 0; j < n; j++)
+        directory::store_here(var[j], x[j]);
+    if (!rt.error())
+        rt.no_solution_error();
+    return false;
+}
+
+
 list_p Root::multiple_equation_solver(list_r eqs, list_r names, list_r guesses)
 // ----------------------------------------------------------------------------
 //   Solve multiple equations in sequence (equivalent to HP's MES)
 // ----------------------------------------------------------------------------
+//   When no variable can be solved alone, the remaining equations are
+//   solved simultaneously (equivalent to HP's MSLV)
 {
     if (!eqs || !names || !guesses)
         return nullptr;
@@ -704,12 +1469,17 @@ list_p Root::multiple_equation_solver(list_r eqs, list_r names, list_r guesses)
             ++gi;
         }
 
-        // This algorithm does not apply, some variables were not found
+        // Remaining equations are coupled, solve them simultaneously
         if (!found)
         {
-            rt.multisolver_variable_error();
-            solver_command_error();
-            return nullptr;
+            if (!newton_system(eqns, vars, gvalues))
+            {
+                if (!rt.error())
+                    rt.multisolver_variable_error();
+                solver_command_error();
+                return nullptr;
+            }
+            break;
         }
     }
 
@@ -787,6 +1557,18 @@ COMMAND_BODY(MultipleEquationsRoots)
 }
 
 
+COMMAND_BODY(SolverEvaluations)
+// ----------------------------------------------------------------------------
+//   Return the number of evaluations for the last numerical solve
+// ----------------------------------------------------------------------------
+{
+    if (integer_p count = integer::make(evaluations))
+        if (rt.push(count))
+            return OK;
+    return ERROR;
+}
+
+
 
 // ============================================================================
 //
@@ -56,6 +56,7 @@ NFUNCTION(MultipleEquationsSolver,3,
           }
 );
 COMMAND_DECLARE(MultipleEquationsRoots, 1);
+COMMAND_DECLARE(SolverEvaluations, 0);
 
 
 COMMAND_DECLARE(StEq, 1);
@@ -85,4 +86,7 @@ COMMAND_DECLARE_INSERT_HELP(SolvingMenuStore,1);
 COMMAND_DECLARE_INSERT(SolvingMenuSolve,0);
 COMMAND_DECLARE_INSERT(SolvingMenuRecall,0);
 
+bool solver_cache_forget(object_p name);
+bool solver_cache_flush();
+
 #endif // SOLVE_H
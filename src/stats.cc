@@ -32,11 +32,17 @@
 #include "arithmetic.h"
 #include "bignum.h"
 #include "compare.h"
+#include "decimal.h"
 #include "dmcp.h"
+#include "fraction.h"
+#include "hash.h"
+#include "hwfp.h"
 #include "integer.h"
+#include "program.h"
 #include "tag.h"
 #include "variables.h"
 
+#include <cmath>
 #include <random>
 
 
@@ -158,6 +164,443 @@ bool StatsParameters::Access::write(object_p name) const
 
 
 
+// ============================================================================
+//
+//   Statistics accumulators
+//
+// ============================================================================
+//   Running sums for the statistics data are kept in a cache, so that
+//   statistics commands do not need to scan all the data every time.
+//   The cache is keyed by a hash of the contents of ΣData, checked along
+//   with its size, number of rows and of columns, which also makes it
+//   possible to skip validating the data when it did not change.
+//   Accumulators are built on first use, updated as rows are added by Σ+ or
+//   removed by Σ-, and rebuilt when ΣData is replaced. Means and co-moments
+//   use Welford's algorithm, which loses less precision than computing them
+//   from sums of squares.
+
+struct stats_cache
+// ----------------------------------------------------------------------------
+//   Accumulators for the current statistics data
+// ----------------------------------------------------------------------------
+{
+    stats_cache()
+        : hash(), size(), rows(), columns(), valid(), built(), exact(),
+          sum(), sum2(), mean(), m2(), min(), max()
+    {}
+
+    uint32_t    hash;           // Hash of ΣData contents
+    size_t      size;           // Size of ΣData contents
+    size_t      rows;           // Number of rows in ΣData
+    size_t      columns;        // Number of columns in ΣData
+    bool        valid;          // The key above is valid
+    bool        built;          // The accumulators below are valid
+    bool        exact;          // All values are exact, rows can be removed
+    list_g      sum;            // Σx for each column
+    list_g      sum2;           // Σxy for each pair of columns
+    list_g      mean;           // Running mean for each column
+    list_g      m2;             // Co-moments Σ(x-x̄)(y-ȳ) for each pair
+    list_g      min;            // Minimum for each column, once computed
+    list_g      max;            // Maximum for each column, once computed
+};
+
+static stats_cache *accumulated = nullptr;
+
+
+static uint32_t stats_hash(array_p data, size_t *size)
+// ----------------------------------------------------------------------------
+//   Hash the contents of a data array
+// ----------------------------------------------------------------------------
+{
+    byte_p payload = byte_p(data->objects(size));
+    return fnv1a(payload, *size);
+}
+
+
+static void stats_cache_key(array_p data, size_t rows, size_t columns)
+// ----------------------------------------------------------------------------
+//   Record validated statistics data as the new cache key
+// ----------------------------------------------------------------------------
+{
+    if (!accumulated)
+    {
+        // operator new support purposefully not linked in embedded versions
+        accumulated = (stats_cache *) calloc(1, sizeof(stats_cache));
+        if (!accumulated)
+            return;
+        new(accumulated) stats_cache;
+    }
+    stats_cache *c = accumulated;
+    c->hash = stats_hash(data, &c->size);
+    c->rows = rows;
+    c->columns = columns;
+    c->valid = true;
+    c->built = false;
+    c->min = nullptr;
+    c->max = nullptr;
+}
+
+
+static bool stats_cache_match(stats_cache *c, array_p data)
+// ----------------------------------------------------------------------------
+//   Check if the cache key matches some statistics data
+// ----------------------------------------------------------------------------
+//   The hash is only a quick check, also check the shape of the data
+{
+    size_t size = 0;
+    if (!c || !c->valid || c->hash != stats_hash(data, &size) ||
+        c->size != size || c->rows != data->items())
+        return false;
+    if (!c->rows)
+        return true;
+    object_p first = data->at(0);
+    array_p  row   = first ? first->as<array>() : nullptr;
+    return c->columns == (row ? row->items() : 1);
+}
+
+
+bool stats_cache_flush()
+// ----------------------------------------------------------------------------
+//   Forget the statistics accumulators, e.g. when memory is reset
+// ----------------------------------------------------------------------------
+{
+    stats_cache *c = accumulated;
+    if (!c)
+        return false;
+    bool freed = c->valid;
+    c->valid = false;
+    c->built = false;
+    c->sum   = nullptr;
+    c->sum2  = nullptr;
+    c->mean  = nullptr;
+    c->m2    = nullptr;
+    c->min   = nullptr;
+    c->max   = nullptr;
+    return freed;
+}
+
+
+static inline size_t stats_pair(size_t i, size_t j, size_t columns)
+// ----------------------------------------------------------------------------
+//   Index of the pair of columns i <= j in the co-moment lists
+// ----------------------------------------------------------------------------
+{
+    return i * columns - i * (i - 1) / 2 + (j - i);
+}
+
+
+static algebraic_p stats_item(object_p row, size_t col)
+// ----------------------------------------------------------------------------
+//   Return the value in a given column of a row
+// ----------------------------------------------------------------------------
+{
+    if (array_p ra = row->as<array>())
+        return algebraic_p(ra->at(col));
+    return col == 0 ? algebraic_p(row) : nullptr;
+}
+
+
+template <typename F>
+static list_p stats_columns(size_t columns, F f)
+// ----------------------------------------------------------------------------
+//   Build a list with one value per column
+// ----------------------------------------------------------------------------
+{
+    scribble scr;
+    for (size_t i = 0; i < columns; i++)
+    {
+        algebraic_g value = f(i);
+        if (!value || !rt.append(+value))
+            return nullptr;
+    }
+    return list::make(object::ID_list, scr.scratch(), scr.growth());
+}
+
+
+template <typename F>
+static list_p stats_pairs(size_t columns, F f)
+// ----------------------------------------------------------------------------
+//   Build a list with one value per pair of columns
+// ----------------------------------------------------------------------------
+{
+    scribble scr;
+    for (size_t i = 0; i < columns; i++)
+    {
+        for (size_t j = i; j < columns; j++)
+        {
+            algebraic_g value = f(i, j);
+            if (!value || !rt.append(+value))
+                return nullptr;
+        }
+    }
+    return list::make(object::ID_list, scr.scratch(), scr.growth());
+}
+
+
+static algebraic_p stats_shape(list_p values, size_t columns)
+// ----------------------------------------------------------------------------
+//   Return a value for one column, or an array for multiple columns
+// ----------------------------------------------------------------------------
+//   This matches the shape of the results of StatsAccess::total()
+{
+    if (!values)
+        return nullptr;
+    if (columns == 1)
+        return algebraic_p(values->at(0));
+    size_t size  = 0;
+    byte_p items = byte_p(values->objects(&size));
+    return algebraic_p(list::make(object::ID_array, items, size));
+}
+
+
+static list_p stats_items(algebraic_p value, size_t columns)
+// ----------------------------------------------------------------------------
+//   Reverse of stats_shape, return a list with one item per column
+// ----------------------------------------------------------------------------
+{
+    if (columns == 1)
+    {
+        algebraic_g single = value;
+        return stats_columns(1, [&](size_t) { return +single; });
+    }
+    if (array_p a = value->as<array>())
+    {
+        size_t size  = 0;
+        byte_p items = byte_p(a->objects(&size));
+        return list::make(object::ID_list, items, size);
+    }
+    return nullptr;
+}
+
+
+static algebraic_p smallest(algebraic_r s, algebraic_r x);
+static algebraic_p largest(algebraic_r s, algebraic_r x);
+
+
+static bool stats_add(stats_cache *c, object_p rowobj, size_t n)
+// ----------------------------------------------------------------------------
+//   Add the n-th row to the accumulators
+// ----------------------------------------------------------------------------
+//   Sums are computed in the same order as a scan of the whole data would,
+//   so that they give identical results
+{
+    // Hold the accumulators, which may be flushed if we run low on memory
+    object_g    row     = rowobj;
+    size_t      columns = c->columns;
+    list_g      osum    = c->sum;
+    list_g      osum2   = c->sum2;
+    list_g      omean   = c->mean;
+    list_g      om2     = c->m2;
+    list_g      omin    = c->min;
+    list_g      omax    = c->max;
+    algebraic_g count   = integer::make(n);
+    if (!count)
+        return false;
+
+    for (size_t i = 0; i < columns; i++)
+    {
+        algebraic_p x = stats_item(row, i);
+        if (!x)
+            return false;
+        if (!x->is_fractionable())
+            c->exact = false;
+    }
+
+    list_g sum = stats_columns(columns, [&](size_t i) {
+        algebraic_g s = algebraic_p(osum->at(i));
+        algebraic_g x = stats_item(row, i);
+        return +(s + x);
+    });
+    list_g sum2 = stats_pairs(columns, [&](size_t i, size_t j) {
+        algebraic_g s = algebraic_p(osum2->at(stats_pair(i, j, columns)));
+        algebraic_g x = stats_item(row, i);
+        algebraic_g y = stats_item(row, j);
+        return +(s + x * y);
+    });
+    list_g mean = stats_columns(columns, [&](size_t i) {
+        algebraic_g m = algebraic_p(omean->at(i));
+        algebraic_g x = stats_item(row, i);
+        return +(m + (x - m) / count);
+    });
+    if (!sum || !sum2 || !mean)
+        return false;
+    list_g m2 = stats_pairs(columns, [&](size_t i, size_t j) {
+        algebraic_g s  = algebraic_p(om2->at(stats_pair(i, j, columns)));
+        algebraic_g x  = stats_item(row, i);
+        algebraic_g y  = stats_item(row, j);
+        algebraic_g mx = algebraic_p(omean->at(i));
+        algebraic_g my = algebraic_p(mean->at(j));
+        return +(s + (x - mx) * (y - my));
+    });
+    if (!m2)
+        return false;
+
+    list_g min, max;
+    if (omin)
+    {
+        min = stats_columns(columns, [&](size_t i) {
+            algebraic_g s = algebraic_p(omin->at(i));
+            algebraic_g x = stats_item(row, i);
+            return smallest(s, x);
+        });
+    }
+    if (omax)
+    {
+        max = stats_columns(columns, [&](size_t i) {
+            algebraic_g s = algebraic_p(omax->at(i));
+            algebraic_g x = stats_item(row, i);
+            return largest(s, x);
+        });
+    }
+
+    c->sum  = sum;
+    c->sum2 = sum2;
+    c->mean = mean;
+    c->m2   = m2;
+    c->min  = min;
+    c->max  = max;
+    return true;
+}
+
+
+static bool stats_remove(stats_cache *c, object_p rowobj, size_t n)
+// ----------------------------------------------------------------------------
+//   Remove the last row from the accumulators, leaving n rows
+// ----------------------------------------------------------------------------
+//   This is only done with exact values, where it gives exact results
+{
+    object_g    row     = rowobj;
+    size_t      columns = c->columns;
+    list_g      osum    = c->sum;
+    list_g      osum2   = c->sum2;
+    list_g      omean   = c->mean;
+    list_g      om2     = c->m2;
+    algebraic_g count   = integer::make(n);
+    if (!count)
+        return false;
+
+    list_g mean = stats_columns(columns, [&](size_t i) {
+        algebraic_g m = algebraic_p(omean->at(i));
+        algebraic_g x = stats_item(row, i);
+        return +(m - (x - m) / count);
+    });
+    if (!mean)
+        return false;
+    list_g m2 = stats_pairs(columns, [&](size_t i, size_t j) {
+        algebraic_g s  = algebraic_p(om2->at(stats_pair(i, j, columns)));
+        algebraic_g x  = stats_item(row, i);
+        algebraic_g y  = stats_item(row, j);
+        algebraic_g mx = algebraic_p(mean->at(i));
+        algebraic_g my = algebraic_p(omean->at(j));
+        return +(s - (x - mx) * (y - my));
+    });
+    list_g sum = stats_columns(columns, [&](size_t i) {
+        algebraic_g s = algebraic_p(osum->at(i));
+        algebraic_g x = stats_item(row, i);
+        return +(s - x);
+    });
+    list_g sum2 = stats_pairs(columns, [&](size_t i, size_t j) {
+        algebraic_g s = algebraic_p(osum2->at(stats_pair(i, j, columns)));
+        algebraic_g x = stats_item(row, i);
+        algebraic_g y = stats_item(row, j);
+        return +(s - x * y);
+    });
+    if (!m2 || !sum || !sum2)
+        return false;
+
+    // We cannot know the previous minimum and maximum
+    c->sum  = sum;
+    c->sum2 = sum2;
+    c->mean = mean;
+    c->m2   = m2;
+    c->min  = nullptr;
+    c->max  = nullptr;
+    return true;
+}
+
+
+static bool stats_reset(stats_cache *c)
+// ----------------------------------------------------------------------------
+//   Reset the accumulators before adding the first row
+// ----------------------------------------------------------------------------
+{
+    auto zero = [](size_t, size_t = 0) { return integer::make(0); };
+    c->sum  = stats_columns(c->columns, zero);
+    c->sum2 = stats_pairs(c->columns, zero);
+    c->mean = stats_columns(c->columns, zero);
+    c->m2   = stats_pairs(c->columns, zero);
+    c->min  = nullptr;
+    c->max  = nullptr;
+    c->exact = true;
+    return c->sum && c->sum2 && c->mean && c->m2;
+}
+
+
+static algebraic_p cached_variance(stats_cache *c, bool pop)
+// ----------------------------------------------------------------------------
+//   Compute the variance of all columns from the co-moments
+// ----------------------------------------------------------------------------
+{
+    size_t      columns = c->columns;
+    list_g      om2     = c->m2;
+    algebraic_g n       = integer::make(c->rows - !pop);
+    list_g      var     = stats_columns(columns, [&](size_t i) {
+        algebraic_g m2 = algebraic_p(om2->at(stats_pair(i, i, columns)));
+        return +(m2 / n);
+    });
+    return stats_shape(var, columns);
+}
+
+
+static void stats_cache_append(StatsData::Access &stats, object_p row)
+// ----------------------------------------------------------------------------
+//   Update the cache after adding a row to ΣData
+// ----------------------------------------------------------------------------
+{
+    stats_cache *c = accumulated;
+    if (!stats.cached || !c || !c->valid)
+        return;
+
+    // The contents of the new data are the old contents followed by the row
+    size_t size = row->size();
+    c->hash = fnv1a(c->hash, row, size);
+    c->size += size;
+    if (!c->rows)
+    {
+        c->columns = 1;
+        if (array_p ra = row->as<array>())
+            c->columns = ra->items();
+        c->built = stats_reset(c);
+    }
+    c->rows++;
+    if (c->built)
+        c->built = stats_add(c, row, c->rows);
+}
+
+
+static void stats_cache_remove(StatsData::Access &stats, object_p row)
+// ----------------------------------------------------------------------------
+//   Update the cache after removing the last row of ΣData
+// ----------------------------------------------------------------------------
+{
+    stats_cache *c = accumulated;
+    if (!stats.cached || !c || !c->valid || !stats.data)
+        return;
+
+    c->hash = stats_hash(stats.data, &c->size);
+    c->rows--;
+    if (!c->rows)
+    {
+        c->columns = 0;
+        c->built = false;
+    }
+    else if (c->built)
+    {
+        c->built = c->exact && stats_remove(c, row, c->rows);
+    }
+}
+
+
 // ============================================================================
 //
 //   Stats data access
@@ -168,7 +611,7 @@ StatsData::Access::Access()
 // ----------------------------------------------------------------------------
 //   Default values, load variable if it exists
 // ----------------------------------------------------------------------------
-    : data(), original_data(), columns(), rows()
+    : data(), original_data(), columns(), rows(), cached()
 {
     parse(name());
 }
@@ -203,6 +646,7 @@ bool StatsData::Access::parse(array_p values)
 
     columns = 0;
     rows    = 0;
+    cached  = false;
 
     for (object_p row : *values)
     {
@@ -256,9 +700,23 @@ bool StatsData::Access::parse(object_p name)
 
         if (array_p values = obj->as<array>())
         {
+            // Unchanged data was already validated, no need to scan it again
+            stats_cache *c = accumulated;
+            if (stats_cache_match(c, values))
+            {
+                data          = values;
+                original_data = data;
+                rows          = c->rows;
+                columns       = c->columns;
+                cached        = true;
+                return true;
+            }
+
             if (parse(values))
             {
                 original_data = data;
+                stats_cache_key(data, rows, columns);
+                cached = accumulated != nullptr;
                 return true;
             }
         }
@@ -340,7 +798,11 @@ COMMAND_BODY(AddData)
 
             if (!stats.data)
                 stats.data = array_p(array::make(ID_array, nullptr, 0));
-            stats.data = stats.data->append(value);
+            object_g row = value;
+            stats.data = stats.data->append(row);
+            if (!stats.data)
+                return ERROR;
+            stats_cache_append(stats, row);
             rt.drop();
             return OK;
         }
@@ -377,6 +839,9 @@ COMMAND_BODY(RemoveData)
 
         size = last - first;
         stats.data = array_p(array::make(ID_array, byte_p(first), size));
+        if (!stats.data)
+            return ERROR;
+        stats_cache_remove(stats, removed);
         return OK;
     }
     rt.invalid_stats_data_error();
@@ -444,6 +909,8 @@ COMMAND_BODY(ClearData)
 {
     StatsData::Access stats;
     stats.data = array_p(array::make(ID_array, nullptr, 0));
+    if (stats.data)
+        stats_cache_key(stats.data, 0, 0);
     return OK;
 }
 
@@ -471,18 +938,96 @@ algebraic_p StatsAccess::fit_transform(algebraic_r x, uint col) const
 //   3. Log fit:        y = a*ln(x) + b
 //   4. Power fit:      ln(y) = a*ln(x) + ln(b)
 {
-    bool dolog = false;
+    if (transformed(col))
+        return log::evaluate(x);
+    return x;
+}
+
+
+bool StatsAccess::transformed(uint col) const
+// ----------------------------------------------------------------------------
+//   Check if fit_transform changes the values in a given column
+// ----------------------------------------------------------------------------
+{
     switch (model)
     {
     default:
-    case object::ID_LinearFit:                                          break;
-    case object::ID_ExponentialFit: dolog = col == ycol;                break;
-    case object::ID_LogarithmicFit: dolog = col == xcol;                break;
-    case object::ID_PowerFit:       dolog = col == xcol || col == ycol; break;
+    case object::ID_LinearFit:      return false;
+    case object::ID_ExponentialFit: return col == ycol;
+    case object::ID_LogarithmicFit: return col == xcol;
+    case object::ID_PowerFit:       return col == xcol || col == ycol;
     }
-    if (dolog)
-        return log::evaluate(x);
-    return x;
+}
+
+
+stats_cache *StatsAccess::accumulators() const
+// ----------------------------------------------------------------------------
+//   Return the accumulators for the current data, building them if needed
+// ----------------------------------------------------------------------------
+//   This returns nullptr if the accumulators cannot be used, in which case
+//   the caller falls back to scanning the data
+{
+    stats_cache *c = accumulated;
+    if (!cached || !c || !c->valid || !rows)
+        return nullptr;
+    if (c->built)
+        return c;
+
+    c->columns = columns;
+    if (!stats_reset(c))
+        return nullptr;
+
+    size_t n = 0;
+    for (object_g row : *data)
+    {
+        if (!stats_add(c, row, ++n))
+        {
+            // Out of memory or the like: let the caller scan the data
+            rt.clear_error();
+            return nullptr;
+        }
+    }
+    c->built = true;
+    return c;
+}
+
+
+algebraic_p StatsAccess::cached_sum(uint xc, uint yc) const
+// ----------------------------------------------------------------------------
+//   Return Σx for column xc, or Σxy if yc is non-zero, from the accumulators
+// ----------------------------------------------------------------------------
+//   Columns are numbered from 1 as in ΣParameters
+{
+    if (!xc || xc > columns || yc > columns ||
+        transformed(xc) || (yc && transformed(yc)))
+        return nullptr;
+    stats_cache *c = accumulators();
+    if (!c)
+        return nullptr;
+    if (!yc)
+        return algebraic_p(c->sum->at(xc - 1));
+    size_t i = std::min(xc, yc) - 1;
+    size_t j = std::max(xc, yc) - 1;
+    return algebraic_p(c->sum2->at(stats_pair(i, j, columns)));
+}
+
+
+algebraic_p StatsAccess::cached_moment(uint xc, uint yc, bool pop) const
+// ----------------------------------------------------------------------------
+//   Return the co-moment of two columns divided by n (pop) or n-1
+// ----------------------------------------------------------------------------
+{
+    if (!xc || !yc || xc > columns || yc > columns ||
+        transformed(xc) || transformed(yc))
+        return nullptr;
+    stats_cache *c = accumulators();
+    if (!c)
+        return nullptr;
+    size_t      i  = std::min(xc, yc) - 1;
+    size_t      j  = std::max(xc, yc) - 1;
+    algebraic_g m2 = algebraic_p(c->m2->at(stats_pair(i, j, columns)));
+    algebraic_g n  = integer::make(rows - !pop);
+    return m2 / n;
 }
 
 
@@ -659,6 +1204,8 @@ algebraic_p StatsAccess::sum_x() const
 //   Return the sum of values in the X column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p cached = cached_sum(xcol))
+        return cached;
     return sum(sum1, xcol);
 }
 
@@ -668,6 +1215,8 @@ algebraic_p StatsAccess::sum_y() const
 //   Return the sum of values in the Y column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p cached = cached_sum(ycol))
+        return cached;
     return sum(sum1, ycol);
 }
 
@@ -677,6 +1226,8 @@ algebraic_p StatsAccess::sum_xy() const
 //   Return the sum of product of values in X and Y column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p cached = cached_sum(xcol, ycol))
+        return cached;
     return sum(sumxy, xcol, ycol);
 }
 
@@ -686,6 +1237,8 @@ algebraic_p StatsAccess::sum_x2() const
 //   Return the sum of squares of values in the X column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p cached = cached_sum(xcol, xcol))
+        return cached;
     return sum(sum2, xcol);
 }
 
@@ -695,6 +1248,8 @@ algebraic_p StatsAccess::sum_y2() const
 //   Return the sum of squares of values in the Y column
 // ----------------------------------------------------------------------------
 {
+    if (algebraic_p cached = cached_sum(ycol, ycol))
+        return cached;
     return sum(sum2, ycol);
 }
 
@@ -845,6 +1400,8 @@ algebraic_p StatsAccess::total() const
 //  Perform a sum of the columns
 // ----------------------------------------------------------------------------
 {
+    if (stats_cache *c = accumulators())
+        return stats_shape(c->sum, columns);
     return total(sum1);
 }
 
@@ -854,7 +1411,13 @@ algebraic_p StatsAccess::min() const
 //  Find the minimum of all columns
 // ----------------------------------------------------------------------------
 {
-    return total(smallest);
+    stats_cache *c = accumulators();
+    if (c && c->min)
+        return stats_shape(c->min, columns);
+    algebraic_g result = total(smallest);
+    if (c && result)
+        c->min = stats_items(result, columns);
+    return result;
 }
 
 
@@ -863,7 +1426,13 @@ algebraic_p StatsAccess::max() const
 //  Find the maximum of all columns
 // ----------------------------------------------------------------------------
 {
-    return total(largest);
+    stats_cache *c = accumulators();
+    if (c && c->max)
+        return stats_shape(c->max, columns);
+    algebraic_g result = total(largest);
+    if (c && result)
+        c->max = stats_items(result, columns);
+    return result;
 }
 
 
@@ -907,6 +1476,8 @@ algebraic_p StatsAccess::variance() const
         rt.insufficient_stats_data_error();
         return nullptr;
     }
+    if (stats_cache *c = accumulators())
+        return cached_variance(c, false);
     if (algebraic_g mean = average())
     {
         algebraic_g sum = total(do_variance, mean);
@@ -941,6 +1512,14 @@ algebraic_p StatsAccess::correlation() const
         return nullptr;
     }
 
+    if (algebraic_g cxy = cached_moment(xcol, ycol, true))
+    {
+        algebraic_g cxx = cached_moment(xcol, xcol, true);
+        algebraic_g cyy = cached_moment(ycol, ycol, true);
+        if (cxx && cyy)
+            return cxy / sqrt::evaluate(cxx * cyy);
+    }
+
     algebraic_g n     = integer::make(rows);
     algebraic_g avg_x = sum_x() / n;
     algebraic_g avg_y = sum_y() / n;
@@ -999,6 +1578,9 @@ algebraic_p StatsAccess::covariance(bool population) const
         rt.insufficient_stats_data_error();
         return nullptr;
     }
+    if (algebraic_p cached = cached_moment(xcol, ycol, population))
+        return cached;
+
     algebraic_g n     = integer::make(rows);
     algebraic_g avg_x = sum_x() / n;
     algebraic_g avg_y = sum_y() / n;
@@ -1080,6 +1662,8 @@ algebraic_p StatsAccess::population_variance() const
         rt.insufficient_stats_data_error();
         return nullptr;
     }
+    if (stats_cache *c = accumulators())
+        return cached_variance(c, true);
     if (algebraic_g mean = average())
     {
         algebraic_g sum = total(do_popvar, mean);
@@ -1125,55 +1709,984 @@ object::result StatsAccess::evaluate(eval_fn op, bool two_columns)
 
 // ============================================================================
 //
-//   User-level data analysis commands
+//   Quantiles
 //
 // ============================================================================
 
-COMMAND_BODY(DataSize)
+struct quantile_selector
 // ----------------------------------------------------------------------------
-//   Return the number of entries in statistics data
+//   Find order statistics of numerical values without sorting them
 // ----------------------------------------------------------------------------
+//   Each value gets an entry in the scratchpad with the offset of the value
+//   in the data and a native key, which is exact for small integers and a
+//   double otherwise. Entries are then reordered with introselect, i.e.
+//   quickselect with a median-of-three pivot and a three-way partition,
+//   switching to heapsort if partitioning does not converge.
+//   Objects are only compared when their native keys are equal but their
+//   encodings differ. Since this may cause a garbage collection, which
+//   moves both the data and the scratchpad, everything is addressed by
+//   offset, as in list_sorter.
 {
-    return StatsAccess::evaluate(&StatsAccess::num_rows, false);
-}
+    quantile_selector(list_p data) : scr(), data(data), count(0) {}
 
+    bool        add(size_t column);
+    bool        select(size_t lo, size_t k);
+    object_p    value(size_t rank);
 
-COMMAND_BODY(DataTotal)
-// ----------------------------------------------------------------------------
-//   Compute the sum of items
-// ----------------------------------------------------------------------------
-{
-    return StatsAccess::evaluate(&StatsAccess::total, false);
-}
+    struct entry
+    {
+        uint32_t offset;
+        bool     integer;       // Key is in i and exact
+        bool     precise;       // Equal keys means equal values
+        union
+        {
+            int64_t i;
+            double  d;
+        };
+    };
+    static bool native_key(object_p value, entry &r);
+
+private:
+    entry get(size_t r)
+    {
+        entry result;
+        memcpy(&result, scr.scratch() + r * sizeof(entry), sizeof(entry));
+        return result;
+    }
+    void put(size_t r, const entry &value)
+    {
+        memcpy(scr.scratch() + r * sizeof(entry), &value, sizeof(entry));
+    }
+    void swap(size_t x, size_t y)
+    {
+        entry ex = get(x);
+        put(x, get(y));
+        put(y, ex);
+    }
 
+    int         compare(const entry &x, const entry &y);
+    void        heapsort(size_t lo, size_t hi);
+    void        sift(size_t lo, size_t root, size_t hi);
 
-COMMAND_BODY(Average)
-// ----------------------------------------------------------------------------
-//   Compute the mean of all input data
-// ----------------------------------------------------------------------------
-{
-    return StatsAccess::evaluate(&StatsAccess::average, false);
-}
+private:
+    scribble    scr;
+    list_g      data;
+    size_t      count;
+};
 
 
-COMMAND_BODY(Median)
+static double quantile_bignum_key(byte_p &p)
 // ----------------------------------------------------------------------------
-//  Find the median of the input data
+//   Approximate value of a bignum payload
 // ----------------------------------------------------------------------------
 {
-    rt.unimplemented_error();
-    return ERROR;
+    size_t size  = leb128<size_t>(p);
+    double value = 0;
+    for (size_t i = size; i--; )
+        value = value * 256.0 + p[i];
+    p += size;
+    return value;
 }
 
 
-
-COMMAND_BODY(MinData)
+bool quantile_selector::native_key(object_p value, entry &r)
 // ----------------------------------------------------------------------------
-//  Find the minimum of all data
+//   Compute the native key for a value, return false if not a real number
 // ----------------------------------------------------------------------------
 {
-    return StatsAccess::evaluate(&StatsAccess::min, false);
-}
+    object::id ty  = value->type();
+    byte_p     p   = value->payload();
+    bool       neg = false;
+    r.integer = false;
+    r.precise = false;
+    switch (ty)
+    {
+    case object::ID_neg_integer:
+        neg = true;
+        // fallthrough
+    case object::ID_integer:
+        if (integer_p(value)->native())
+        {
+            r.i = integer_p(value)->value<int64_t>();
+            if (neg)
+                r.i = -r.i;
+            r.integer = true;
+            r.precise = true;
+            return true;
+        }
+        r.d = double(integer_p(value)->value<ularge>());
+        break;
+
+    case object::ID_neg_bignum:
+        neg = true;
+        // fallthrough
+    case object::ID_bignum:
+        r.d = quantile_bignum_key(p);
+        break;
+
+    case object::ID_neg_fraction:
+        neg = true;
+        // fallthrough
+    case object::ID_fraction:
+    {
+        ularge n = leb128<ularge>(p);
+        ularge d = leb128<ularge>(p);
+        r.d = double(n) / double(d);
+        break;
+    }
+
+    case object::ID_neg_big_fraction:
+        neg = true;
+        // fallthrough
+    case object::ID_big_fraction:
+    {
+        double n = quantile_bignum_key(p);
+        double d = quantile_bignum_key(p);
+        r.d = n / d;
+        break;
+    }
+
+    case object::ID_hwfloat:
+        r.d = hwfloat_p(value)->value();
+        r.precise = true;
+        break;
+    case object::ID_hwdouble:
+        r.d = hwdouble_p(value)->value();
+        r.precise = true;
+        break;
+
+    case object::ID_neg_decimal:
+        neg = true;
+        // fallthrough
+    case object::ID_decimal:
+    {
+        // Up to 15 digits, distinct decimals give distinct doubles
+        decimal::info s    = decimal_p(value)->shape();
+        size_t        used = s.nkigits < 6 ? s.nkigits : 6;
+        double        m    = 0;
+        for (size_t i = 0; i < used; i++)
+            m = m * 1000.0 + decimal::kigit(s.base, i);
+        r.d = m * std::pow(10.0, double(s.exponent - 3 * large(used)));
+        r.precise = s.nkigits <= 5;
+        break;
+    }
+
+    default:
+        return false;
+    }
+    if (neg)
+        r.d = -r.d;
+    if (r.d != r.d)
+        return false;
+    return true;
+}
+
+
+bool quantile_selector::add(size_t column)
+// ----------------------------------------------------------------------------
+//   Add the values in a column of the data, or all values if not an array
+// ----------------------------------------------------------------------------
+{
+    size_t items = data->items();
+    if (!rt.allocate(items * sizeof(entry)))
+        return false;
+
+    byte_p base = byte_p(data->objects());
+    for (object_p row : *data)
+    {
+        object_p item = row;
+        if (array_p ra = row->as<array>())
+            item = ra->at(column);
+        else if (column)
+            item = nullptr;
+
+        entry r;
+        if (!item || !native_key(item, r))
+        {
+            rt.type_error();
+            return false;
+        }
+        r.offset = byte_p(item) - base;
+        put(count++, r);
+    }
+    return true;
+}
+
+
+int quantile_selector::compare(const entry &x, const entry &y)
+// ----------------------------------------------------------------------------
+//   Compare two entries, using native keys when possible
+// ----------------------------------------------------------------------------
+{
+    if (x.integer && y.integer)
+        return (x.i > y.i) - (x.i < y.i);
+
+    double xd = x.integer ? double(x.i) : x.d;
+    double yd = y.integer ? double(y.i) : y.d;
+    if (xd != yd)
+        return xd < yd ? -1 : 1;
+    if (x.offset == y.offset || (x.precise && y.precise))
+        return 0;
+
+    // Repeated values have the same encoding
+    byte_p   base  = byte_p(data->objects());
+    object_p xo    = object_p(base + x.offset);
+    object_p yo    = object_p(base + y.offset);
+    size_t   xsize = xo->size();
+    if (xsize == yo->size() && memcmp(xo, yo, xsize) == 0)
+        return 0;
+
+    // Keys are too close, compare the actual values (may GC)
+    algebraic_g xa = algebraic_p(xo);
+    algebraic_g ya = algebraic_p(yo);
+    int         test = 0;
+    comparison::compare(&test, xa, ya);
+    return test;
+}
+
+
+void quantile_selector::sift(size_t lo, size_t root, size_t hi)
+// ----------------------------------------------------------------------------
+//   Sift an entry down a max-heap rooted at lo
+// ----------------------------------------------------------------------------
+{
+    while (true)
+    {
+        size_t child = lo + 2 * (root - lo) + 1;
+        if (child >= hi)
+            break;
+        if (child + 1 < hi && compare(get(child), get(child + 1)) < 0)
+            child++;
+        if (compare(get(root), get(child)) >= 0)
+            break;
+        swap(root, child);
+        root = child;
+    }
+}
+
+
+void quantile_selector::heapsort(size_t lo, size_t hi)
+// ----------------------------------------------------------------------------
+//   Sort a range of entries when quickselect does not converge
+// ----------------------------------------------------------------------------
+{
+    for (size_t i = lo + (hi - lo) / 2; i-- > lo; )
+        sift(lo, i, hi);
+    for (size_t end = hi; end-- > lo + 1; )
+    {
+        swap(lo, end);
+        sift(lo, lo, end);
+    }
+}
+
+
+bool quantile_selector::select(size_t lo, size_t k)
+// ----------------------------------------------------------------------------
+//   Place the k-th smallest entry at index k, smaller ones from lo before it
+// ----------------------------------------------------------------------------
+//   Entries before lo must already be smaller than all the others
+{
+    size_t hi    = count;
+    uint   depth = 2;
+    for (size_t n = hi - lo; n > 1; n /= 2)
+        depth += 2;
+
+    while (hi - lo > 1)
+    {
+        if (program::interrupted())
+            return false;
+        if (!depth--)
+        {
+            heapsort(lo, hi);
+            return true;
+        }
+
+        // Median of three as a pivot
+        size_t a = lo, b = lo + (hi - lo) / 2, c = hi - 1;
+        if (compare(get(a), get(b)) > 0)
+            std::swap(a, b);
+        if (compare(get(b), get(c)) > 0)
+            b = compare(get(a), get(c)) > 0 ? a : c;
+        entry pivot = get(b);
+
+        // Three-way partition: [lo,lt) < pivot, [lt,gt) = pivot, [gt,hi) >
+        size_t lt = lo, i = lo, gt = hi;
+        while (i < gt)
+        {
+            int test = compare(get(i), pivot);
+            if (test < 0)
+                swap(lt++, i++);
+            else if (test > 0)
+                swap(i, --gt);
+            else
+                i++;
+        }
+        if (k < lt)
+            hi = lt;
+        else if (k >= gt)
+            lo = gt;
+        else
+            break;
+    }
+    return !rt.error();
+}
+
+
+object_p quantile_selector::value(size_t rank)
+// ----------------------------------------------------------------------------
+//   Return the value at a given rank after selection
+// ----------------------------------------------------------------------------
+{
+    return object_p(byte_p(data->objects()) + get(rank).offset);
+}
+
+
+static bool quantile_rank(algebraic_r p, size_t n,
+                          size_t &lower, algebraic_g &frac)
+// ----------------------------------------------------------------------------
+//   Compute the rank and interpolation factor for a given probability
+// ----------------------------------------------------------------------------
+//   This interpolates linearly between closest ranks, so that the 0.5
+//   quantile is the median. With exact data and probability, the result
+//   is exact.
+{
+    if (!p || !p->is_real())
+    {
+        rt.type_error();
+        return false;
+    }
+    algebraic_g last = integer::make(n - 1);
+    algebraic_g h    = last * p;
+    if (!h)
+        return false;
+    if (h->is_negative(false))
+    {
+        rt.domain_error();
+        return false;
+    }
+
+    object::id ty = h->type();
+    if (ty == object::ID_integer)
+    {
+        lower = integer_p(+h)->value<size_t>();
+    }
+    else if (ty == object::ID_fraction)
+    {
+        fraction_p f = fraction_p(+h);
+        lower = f->numerator_value() / f->denominator_value();
+    }
+    else
+    {
+        quantile_selector::entry r;
+        if (!quantile_selector::native_key(h, r))
+        {
+            rt.domain_error();
+            return false;
+        }
+        lower = size_t(r.integer ? r.i : r.d);
+    }
+    if (lower > n - 1)
+    {
+        rt.domain_error();
+        return false;
+    }
+    algebraic_g low = integer::make(lower);
+    frac = h - low;
+    return +frac;
+}
+
+
+static list_p quantile_values(list_r data, size_t column, list_r probs)
+// ----------------------------------------------------------------------------
+//   Compute quantiles of a column of data, one for each probability
+// ----------------------------------------------------------------------------
+//   Ranks are selected in increasing order, each selection only working on
+//   the entries above the previous one, so that all quantiles are computed
+//   in a single pass over the data.
+{
+    size_t n = data->items();
+    if (!n)
+    {
+        rt.insufficient_stats_data_error();
+        return nullptr;
+    }
+
+    quantile_selector sel(data);
+    if (!sel.add(column))
+        return nullptr;
+
+    // Compute the ranks for all probabilities, then select in order
+    size_t      nprobs = probs->items();
+    size_t      placed = 0;
+    size_t      lower  = 0;
+    algebraic_g frac, p;
+    for (size_t done = 0; done < nprobs; done++)
+    {
+        size_t next = n;
+        for (size_t i = 0; i < nprobs; i++)
+        {
+            p = probs->at(i)->as_algebraic();
+            if (!quantile_rank(p, n, lower, frac))
+                return nullptr;
+            if (lower >= placed && lower < next)
+                next = lower;
+        }
+        if (next >= n)
+            break;
+        if (!sel.select(placed, next))
+            return nullptr;
+        placed = next + 1;
+        if (placed < n)
+        {
+            if (!sel.select(placed, placed))
+                return nullptr;
+            placed++;
+        }
+    }
+
+    // Interpolate between the selected values
+    scribble    scr;
+    algebraic_g x, y;
+    for (size_t i = 0; i < nprobs; i++)
+    {
+        p = probs->at(i)->as_algebraic();
+        if (!quantile_rank(p, n, lower, frac))
+            return nullptr;
+        x = algebraic_p(sel.value(lower));
+        if (lower + 1 < n && !frac->is_zero(false))
+        {
+            y = algebraic_p(sel.value(lower + 1));
+            x = x + frac * (y - x);
+        }
+        if (!x || !rt.append(+x))
+            return nullptr;
+    }
+    return list::make(object::ID_list, scr.scratch(), scr.growth());
+}
+
+
+static object_p quantile_probabilities(object_p probs, bool percent)
+// ----------------------------------------------------------------------------
+//   Return a list of probabilities, scaling percentages
+// ----------------------------------------------------------------------------
+{
+    list_g ps = probs->as_array_or_list();
+    if (!ps)
+        ps = list::make(object::ID_list, object_g(probs));
+    if (percent && ps)
+    {
+        algebraic_g hundred = integer::make(100);
+        scribble    scr;
+        algebraic_g p;
+        for (object_p item : *ps)
+        {
+            p = item->as_algebraic();
+            if (!p)
+            {
+                rt.type_error();
+                return nullptr;
+            }
+            p = p / hundred;
+            if (!p || !rt.append(+p))
+                return nullptr;
+        }
+        ps = list::make(object::ID_list, scr.scratch(), scr.growth());
+    }
+    return +ps;
+}
+
+
+algebraic_p StatsAccess::quantiles(object_p probs, bool percent) const
+// ----------------------------------------------------------------------------
+//   Compute quantiles for all columns of the statistics data
+// ----------------------------------------------------------------------------
+//   For a single probability, the result is a value for a single column,
+//   or a vector for multiple columns. For a list of probabilities, e.g.
+//   { 0 0.25 0.5 0.75 1 } for a box-plot summary, it is a list of those.
+{
+    if (!rows)
+    {
+        rt.insufficient_stats_data_error();
+        return nullptr;
+    }
+
+    object_g input = probs;
+    list_g   ps    = list_p(quantile_probabilities(probs, percent));
+    if (!ps)
+        return nullptr;
+
+    // One list of quantiles per column
+    list_g data = +this->data;
+    list_g bycol;
+    {
+        scribble scr;
+        for (size_t c = 0; c < columns; c++)
+        {
+            list_g qs = quantile_values(data, c, ps);
+            if (!qs || !rt.append(+qs))
+                return nullptr;
+        }
+        bycol = list::make(object::ID_list, scr.scratch(), scr.growth());
+    }
+    if (!bycol)
+        return nullptr;
+
+    // Transpose to one vector of columns per probability
+    size_t   nprobs = ps->items();
+    object_g q;
+    scribble scr;
+    for (size_t i = 0; i < nprobs; i++)
+    {
+        if (columns == 1)
+        {
+            q = list_p(bycol->at(0))->at(i);
+        }
+        else
+        {
+            scribble row;
+            for (size_t c = 0; c < columns; c++)
+                if (!rt.append(list_p(bycol->at(c))->at(i)))
+                    return nullptr;
+            q = list::make(object::ID_array, row.scratch(), row.growth());
+        }
+        if (!q || !rt.append(+q))
+            return nullptr;
+    }
+
+    object::id ty = input->type();
+    if (!object::is_array_or_list(ty))
+        return algebraic_p(+q);
+    return algebraic_p(list::make(ty, scr.scratch(), scr.growth()));
+}
+
+
+algebraic_p StatsAccess::median() const
+// ----------------------------------------------------------------------------
+//   Compute the median of all columns
+// ----------------------------------------------------------------------------
+{
+    algebraic_g one  = integer::make(1);
+    algebraic_g two  = integer::make(2);
+    algebraic_g half = one / two;
+    return half ? quantiles(+half, false) : nullptr;
+}
+
+
+static object::result list_quantiles(object_p data, object_p probs,
+                                     bool percent, uint args)
+// ----------------------------------------------------------------------------
+//   Compute quantiles of the values in a list or vector
+// ----------------------------------------------------------------------------
+{
+    list_g values = data->as_array_or_list();
+    if (!values)
+    {
+        rt.type_error();
+        return object::ERROR;
+    }
+    object_g input = probs;
+    list_g   ps    = list_p(quantile_probabilities(probs, percent));
+    if (!ps)
+        return object::ERROR;
+    list_g qs = quantile_values(values, 0, ps);
+    if (!qs)
+        return object::ERROR;
+
+    object_g   result = +qs;
+    object::id ty     = input->type();
+    if (!object::is_array_or_list(ty))
+    {
+        result = qs->at(0);
+    }
+    else if (ty == object::ID_array)
+    {
+        size_t size  = 0;
+        byte_p items = byte_p(qs->objects(&size));
+        result = list::make(object::ID_array, items, size);
+    }
+    if (result && rt.drop(args) && rt.push(result))
+        return object::OK;
+    return object::ERROR;
+}
+
+
+
+// ============================================================================
+//
+//   Frequency bins
+//
+// ============================================================================
+
+uint StatsBins::arguments(object_p top)
+// ----------------------------------------------------------------------------
+//   Number of arguments: bin edges, or xmin, xwidth and number of bins
+// ----------------------------------------------------------------------------
+{
+    return top && top->is_array_or_list() ? 1 : 3;
+}
+
+
+bool StatsBins::setup(object_p xminobj, object_p xwidthobj, object_p nbins)
+// ----------------------------------------------------------------------------
+//   Setup uniform bins of a given width
+// ----------------------------------------------------------------------------
+{
+    xmin  = xminobj ? xminobj->as_algebraic() : nullptr;
+    width = xwidthobj ? xwidthobj->as_algebraic() : nullptr;
+    if (!xmin || !width || !xmin->is_real() || !width->is_real())
+    {
+        rt.type_error();
+        return false;
+    }
+    bins = nbins->as_uint32(1, true);
+    if (rt.error())
+        return false;
+
+    quantile_selector::entry mk, wk;
+    if (!quantile_selector::native_key(xmin, mk) ||
+        !quantile_selector::native_key(width, wk))
+    {
+        rt.type_error();
+        return false;
+    }
+    x0 = mk.integer ? double(mk.i) : mk.d;
+    w  = wk.integer ? double(wk.i) : wk.d;
+    if (w <= 0 || !bins)
+    {
+        rt.domain_error();
+        return false;
+    }
+    uniform = true;
+    exact   = mk.integer && wk.integer;
+    return rt.allocate((bins + 2) * sizeof(uint32_t));
+}
+
+
+bool StatsBins::setup(object_p edgesobj)
+// ----------------------------------------------------------------------------
+//   Setup bins from increasing bin edges
+// ----------------------------------------------------------------------------
+{
+    edges = edgesobj ? edgesobj->as_array_or_list() : nullptr;
+    if (!edges)
+    {
+        rt.type_error();
+        return false;
+    }
+    size_t count = edges->items();
+    if (count < 2)
+    {
+        rt.dimension_error();
+        return false;
+    }
+    bins    = count - 1;
+    uniform = false;
+    exact   = true;
+    size_t header = (bins + 2) * sizeof(uint32_t);
+    if (!rt.allocate(header + count * sizeof(double)))
+        return false;
+
+    double last = 0;
+    size_t i    = 0;
+    for (object_p edge : *edges)
+    {
+        quantile_selector::entry k;
+        if (!quantile_selector::native_key(edge, k))
+        {
+            rt.type_error();
+            return false;
+        }
+        double key = k.integer ? double(k.i) : k.d;
+        if (i && key <= last)
+        {
+            rt.domain_error();
+            return false;
+        }
+        exact = exact && k.precise;
+        memcpy(scr.scratch() + header + i++ * sizeof(double),
+               &key, sizeof(key));
+        last = key;
+    }
+    return true;
+}
+
+
+double StatsBins::edge_key(size_t k)
+// ----------------------------------------------------------------------------
+//   Approximate value of the k-th edge
+// ----------------------------------------------------------------------------
+{
+    if (uniform)
+        return x0 + double(k) * w;
+    double key;
+    memcpy(&key, scr.scratch() + (bins + 2) * sizeof(uint32_t)
+           + k * sizeof(double), sizeof(key));
+    return key;
+}
+
+
+algebraic_p StatsBins::edge(size_t k)
+// ----------------------------------------------------------------------------
+//   Exact value of the k-th edge
+// ----------------------------------------------------------------------------
+{
+    if (!uniform)
+        return edges->at(k)->as_algebraic();
+    algebraic_g index = integer::make(k);
+    return xmin + index * width;
+}
+
+
+bool StatsBins::near(double x, double k)
+// ----------------------------------------------------------------------------
+//   Check if a value is too close to an edge to trust the native comparison
+// ----------------------------------------------------------------------------
+{
+    return std::fabs(x - k) <= 1e-9 * (std::fabs(x) + std::fabs(k));
+}
+
+
+bool StatsBins::count(const StatsAccess &stats)
+// ----------------------------------------------------------------------------
+//   Count the values of the independent column in one pass over the data
+// ----------------------------------------------------------------------------
+//   For uniform bins, the bin is computed directly from the value, and for
+//   other bins, by a binary search on the edges. The result is adjusted
+//   with an exact comparison only when the value is too close to an edge.
+{
+    if (!stats.data)
+    {
+        rt.invalid_stats_data_error();
+        return false;
+    }
+    if (stats.xcol < 1 || stats.xcol > stats.columns)
+    {
+        rt.invalid_stats_parameters_error();
+        return false;
+    }
+    memset(scr.scratch(), 0, (bins + 2) * sizeof(uint32_t));
+
+    array_g  data   = +stats.data;
+    size_t   column = stats.xcol - 1;
+    size_t   size   = 0;
+    size_t   offset = 0;
+    object_g item;
+    data->objects(&size);
+    while (offset < size)
+    {
+        if (program::interrupted())
+            return false;
+
+        object_p row = object_p(byte_p(data->objects()) + offset);
+        offset += row->size();
+        object_p value = row;
+        if (array_p ra = row->as<array>())
+            value = ra->at(column);
+        quantile_selector::entry vk;
+        if (!value || !quantile_selector::native_key(value, vk))
+        {
+            rt.invalid_stats_data_error();
+            return false;
+        }
+        double x = vk.integer ? double(vk.i) : vk.d;
+
+        // Number of edges below or at x, from 0 to bins + 1
+        size_t c = 0;
+        if (uniform)
+        {
+            double t = std::floor((x - x0) / w) + 1;
+            c = t <= 0 ? 0 : t > bins ? bins + 1 : size_t(t);
+
+            // The division may round to the next edge
+            if (c > 0 && x < edge_key(c - 1))
+                c--;
+            else if (c <= bins && x >= edge_key(c))
+                c++;
+        }
+        else
+        {
+            size_t lo = 0, hi = bins + 1;
+            while (lo < hi)
+            {
+                size_t mid = (lo + hi) / 2;
+                if (edge_key(mid) <= x)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            c = lo;
+        }
+
+        // Check neighbouring edges exactly if the keys are too close
+        bool precise = exact && vk.precise;
+        if (!precise)
+        {
+            item = value;
+            if (c > 0 && near(x, edge_key(c - 1)) && below(item, c - 1))
+                c--;
+            else if (c <= bins && near(x, edge_key(c)) && !below(item, c))
+                c++;
+            if (rt.error())
+                return false;
+        }
+
+        // Bins 1 to bins count values between edges, 0 and bins+1 outside
+        byte    *counter = scr.scratch() + c * sizeof(uint32_t);
+        uint32_t n;
+        memcpy(&n, counter, sizeof(n));
+        n++;
+        memcpy(counter, &n, sizeof(n));
+    }
+    return true;
+}
+
+
+bool StatsBins::below(object_r value, size_t k)
+// ----------------------------------------------------------------------------
+//   Exact check if a value is below the k-th edge
+// ----------------------------------------------------------------------------
+{
+    algebraic_g x = value->as_algebraic();
+    algebraic_g e = edge(k);
+    int         test = 0;
+    if (!x || !e || !comparison::compare(&test, x, e))
+        return false;
+    return test < 0;
+}
+
+
+uint32_t StatsBins::frequency(size_t bin)
+// ----------------------------------------------------------------------------
+//   Return the number of values in a bin, 0 below, bins+1 above range
+// ----------------------------------------------------------------------------
+{
+    uint32_t n;
+    memcpy(&n, scr.scratch() + bin * sizeof(uint32_t), sizeof(n));
+    return n;
+}
+
+
+// ============================================================================
+//
+//   User-level data analysis commands
+//
+// ============================================================================
+
+COMMAND_BODY(DataSize)
+// ----------------------------------------------------------------------------
+//   Return the number of entries in statistics data
+// ----------------------------------------------------------------------------
+{
+    return StatsAccess::evaluate(&StatsAccess::num_rows, false);
+}
+
+
+COMMAND_BODY(DataTotal)
+// ----------------------------------------------------------------------------
+//   Compute the sum of items
+// ----------------------------------------------------------------------------
+{
+    return StatsAccess::evaluate(&StatsAccess::total, false);
+}
+
+
+COMMAND_BODY(Average)
+// ----------------------------------------------------------------------------
+//   Compute the mean of all input data
+// ----------------------------------------------------------------------------
+{
+    return StatsAccess::evaluate(&StatsAccess::average, false);
+}
+
+
+COMMAND_BODY(Median)
+// ----------------------------------------------------------------------------
+//  Find the median of the input data
+// ----------------------------------------------------------------------------
+{
+    return StatsAccess::evaluate(&StatsAccess::median, false);
+}
+
+
+static object::result stats_quantiles(bool percent)
+// ----------------------------------------------------------------------------
+//  Compute quantiles or percentiles of the statistics data
+// ----------------------------------------------------------------------------
+{
+    StatsAccess stats;
+    if (!stats)
+        return object::ERROR;
+    object_g    probs = rt.top();
+    algebraic_g value = probs ? stats.quantiles(probs, percent) : nullptr;
+    return value && rt.top(+value) ? object::OK : object::ERROR;
+}
+
+
+COMMAND_BODY(Quantile)
+// ----------------------------------------------------------------------------
+//  Find one or more quantiles of the input data
+// ----------------------------------------------------------------------------
+{
+    return stats_quantiles(false);
+}
+
+
+COMMAND_BODY(Percentile)
+// ----------------------------------------------------------------------------
+//  Find one or more percentiles of the input data
+// ----------------------------------------------------------------------------
+{
+    return stats_quantiles(true);
+}
+
+
+COMMAND_BODY(ListMedian)
+// ----------------------------------------------------------------------------
+//  Find the median of the values in a list
+// ----------------------------------------------------------------------------
+{
+    algebraic_g one  = integer::make(1);
+    algebraic_g two  = integer::make(2);
+    algebraic_g half = one / two;
+    if (object_p data = rt.stack(0))
+        if (half)
+            return list_quantiles(data, half, false, 1);
+    return ERROR;
+}
+
+
+COMMAND_BODY(ListQuantile)
+// ----------------------------------------------------------------------------
+//  Find one or more quantiles of the values in a list
+// ----------------------------------------------------------------------------
+{
+    if (object_p data = rt.stack(1))
+        if (object_p probs = rt.stack(0))
+            return list_quantiles(data, probs, false, 2);
+    return ERROR;
+}
+
+
+COMMAND_BODY(ListPercentile)
+// ----------------------------------------------------------------------------
+//  Find one or more percentiles of the values in a list
+// ----------------------------------------------------------------------------
+{
+    if (object_p data = rt.stack(1))
+        if (object_p probs = rt.stack(0))
+            return list_quantiles(data, probs, true, 2);
+    return ERROR;
+}
+
+
+
+COMMAND_BODY(MinData)
+// ----------------------------------------------------------------------------
+//  Find the minimum of all data
+// ----------------------------------------------------------------------------
+{
+    return StatsAccess::evaluate(&StatsAccess::min, false);
+}
 
 
 
@@ -1304,10 +2817,46 @@ COMMAND_BODY(PopulationCovariance)
 
 COMMAND_BODY(FrequencyBins)
 // ----------------------------------------------------------------------------
-//  Compute frequency bits for the independent column in the data
+//  Compute frequency bins for the independent column in the data
 // ----------------------------------------------------------------------------
 {
-    rt.unimplemented_error();
+    uint args = StatsBins::arguments(rt.stack(0));
+    if (!rt.args(args))
+        return ERROR;
+
+    StatsBins bins;
+    bool      ok = args == 1
+        ? bins.setup(rt.stack(0))
+        : bins.setup(rt.stack(2), rt.stack(1), rt.stack(0));
+    if (!ok)
+        return ERROR;
+
+    StatsAccess stats;
+    if (!stats || !bins.count(stats))
+        return ERROR;
+
+    // Frequencies in range as a column matrix
+    array_g  freq;
+    object_g n;
+    {
+        scribble scr;
+        for (size_t b = 1; b <= bins.bins; b++)
+        {
+            n = integer::make(bins.frequency(b));
+            n = n ? array::wrap(n) : nullptr;
+            if (!n || !rt.append(+n))
+                return ERROR;
+        }
+        freq = array_p(array::make(ID_array, scr.scratch(), scr.growth()));
+    }
+
+    // Frequencies outside of range
+    integer_g below = integer::make(bins.frequency(0));
+    integer_g above = integer::make(bins.frequency(bins.bins + 1));
+    array_g   outside = array_p(array::make(ID_array, below, above));
+    if (freq && outside && rt.drop(args) && rt.push(+freq) &&
+        rt.push(+outside))
+        return OK;
     return ERROR;
 }
 
@@ -1524,12 +3073,106 @@ static bignum_g        *acorn       = nullptr;
 static size_t           acorn_order = 0;
 
 
+struct fast_random
+// ----------------------------------------------------------------------------
+//   Native xoshiro256** generator used to fill arrays with random values
+// ----------------------------------------------------------------------------
+//   Filling arrays one RAND at a time is slow, since each ACORN step does
+//   bignum arithmetic. This generator keeps its state in native integers,
+//   see https://prng.di.unimi.it. It is seeded along with ACORN.
+{
+    void seed(ularge value)
+    {
+        // Expand the seed with splitmix64, which never gives all zeroes
+        for (uint i = 0; i < 4; i++)
+        {
+            value += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = value;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            state[i] = z ^ (z >> 31);
+        }
+        spare  = 0;
+        spared = false;
+        seeded = true;
+    }
+
+    static uint64_t rotate(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t next()
+    {
+        uint64_t result = rotate(state[1] * 5, 7) * 9;
+        uint64_t t      = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotate(state[3], 45);
+        return result;
+    }
+
+    double uniform()
+    {
+        // 53 random bits, between 0 and 1 excluded
+        return double(next() >> 11) * 0x1.0p-53;
+    }
+
+    float uniform_float()
+    {
+        // 24 random bits, since rounding a double to float may give 1
+        return float(next() >> 40) * 0x1.0p-24f;
+    }
+
+    double normal()
+    {
+        // Marsaglia polar method, which gives values two at a time
+        if (spared)
+        {
+            spared = false;
+            return spare;
+        }
+        double u, v, s;
+        do
+        {
+            u = 2 * uniform() - 1;
+            v = 2 * uniform() - 1;
+            s = u * u + v * v;
+        } while (s >= 1 || s == 0);
+        s      = std::sqrt(-2 * std::log(s) / s);
+        spare  = v * s;
+        spared = true;
+        return u * s;
+    }
+
+    uint64_t state[4];
+    double   spare;
+    bool     spared;
+    bool     seeded;
+};
+
+static fast_random fast_rng;
+
+
+static ularge clock_seed()
+// ----------------------------------------------------------------------------
+//   Seed used when none is given, fixed when reproducible results are needed
+// ----------------------------------------------------------------------------
+{
+    return Settings.FixedRandomSeed() ? 0x2A2A2A2AULL : sys_current_ms();
+}
+
+
 static void random_seed(ularge seed)
 // ----------------------------------------------------------------------------
 //   Initialize the random number generator with the given seed
 // ----------------------------------------------------------------------------
 {
     record(acorn, "Setting seed %lu", seed);
+    fast_rng.seed(seed);
 
     // The ACORN must be a relative prime to the modulus, which is a power of 2
     // So if it's even, we make it odd.
@@ -1570,7 +3213,7 @@ static void random_init()
         }
         else
         {
-            seed = 3 * sys_current_ms();
+            seed = 3 * clock_seed();
             record(acorn, "Initialize with random seed %lu", seed);
         }
         acorn_order = Settings.RandomGeneratorOrder();
@@ -1688,7 +3331,7 @@ COMMAND_BODY(RandomSeed)
             random_init();
             if (seednum->is_zero(false))
             {
-                random_seed(sys_current_ms());
+                random_seed(clock_seed());
                 return OK;
             }
             ularge seed = 0;
@@ -1703,3 +3346,122 @@ COMMAND_BODY(RandomSeed)
     }
     return ERROR;
 }
+
+
+static algebraic_p random_value(double x)
+// ----------------------------------------------------------------------------
+//   Convert a native random value to a real number
+// ----------------------------------------------------------------------------
+//   Decimals keep up to 15 significant digits, truncated so that uniform
+//   values remain below 1
+{
+    if (Settings.HardwareFloatingPoint())
+    {
+        uint prec = Settings.Precision();
+        if (prec <= 7)
+            return hwfloat::make(float(x));
+        if (prec <= 16)
+            return hwdouble::make(x);
+    }
+    if (x == 0)
+        return integer::make(0);
+
+    large digits = Settings.Precision();
+    if (digits > 15)
+        digits = 15;
+    bool   neg   = x < 0;
+    double ax    = neg ? -x : x;
+    large  exp   = large(std::floor(std::log10(ax))) + 1;
+    ularge mant  = ularge(ax * std::pow(10.0, double(digits - exp)));
+    return decimal::make(neg ? object::ID_neg_decimal : object::ID_decimal,
+                         mant, exp - digits);
+}
+
+
+static algebraic_p random_uniform()
+// ----------------------------------------------------------------------------
+//   Return a uniform random value between 0 and 1 excluded
+// ----------------------------------------------------------------------------
+{
+    if (Settings.HardwareFloatingPoint() && Settings.Precision() <= 7)
+        return hwfloat::make(fast_rng.uniform_float());
+    return random_value(fast_rng.uniform());
+}
+
+
+static object::result random_fill(bool normal)
+// ----------------------------------------------------------------------------
+//   Fill a vector, list or matrix with uniform or normal random values
+// ----------------------------------------------------------------------------
+{
+    object_g dims = rt.top();
+    if (!dims)
+        return object::ERROR;
+
+    size_t rows = 0, columns = 0;
+    if (!array::size_from_object(&rows, &columns, dims))
+    {
+        if (!rt.error())
+            rt.type_error();
+        return object::ERROR;
+    }
+
+    random_init();
+    if (!fast_rng.seeded)
+        fast_rng.seed(clock_seed());
+
+    // `n` or `[ n ]` gives a vector, `{ n }` a list, `{ n m }` a matrix
+    object::id ty = dims->type() == object::ID_list && !columns
+        ? object::ID_list
+        : object::ID_array;
+    size_t      count = columns ? columns : rows;
+    size_t      lines = columns ? rows : 1;
+    algebraic_g value;
+    object_g    line;
+    scribble    scr;
+    for (size_t r = 0; r < lines; r++)
+    {
+        {
+            scribble items;
+            for (size_t c = 0; c < count; c++)
+            {
+                value = normal ? random_value(fast_rng.normal())
+                               : random_uniform();
+                if (!value || !rt.append(+value))
+                    return object::ERROR;
+            }
+            line = list::make(ty, items.scratch(), items.growth());
+        }
+        if (!line)
+            return object::ERROR;
+        if (!columns)
+            break;
+        if (!rt.append(+line))
+            return object::ERROR;
+        if (program::interrupted())
+            return object::ERROR;
+    }
+    if (columns)
+        line = list::make(ty, scr.scratch(), scr.growth());
+    if (line && rt.top(+line))
+        return object::OK;
+    return object::ERROR;
+}
+
+
+COMMAND_BODY(RandomUniform)
+// ----------------------------------------------------------------------------
+//   Fill a vector, list or matrix with random values between 0 and 1
+// ----------------------------------------------------------------------------
+{
+    return random_fill(false);
+}
+
+
+COMMAND_BODY(RandomNormal)
+// ----------------------------------------------------------------------------
+//   Fill a vector, list or matrix with normally distributed random values
+// ----------------------------------------------------------------------------
+{
+    return random_fill(true);
+}
@@ -36,6 +36,8 @@
 #include "symbol.h"
 #include "target.h"
 
+struct stats_cache;
+
 
 struct StatsParameters : command
 // ----------------------------------------------------------------------------
@@ -83,6 +85,7 @@ struct StatsData : command
         array_g         original_data;
         size_t          columns;
         size_t          rows;
+        bool            cached;         // Data matches statistics cache
 
         static object_p name();
 
@@ -111,6 +114,10 @@ struct StatsAccess : StatsParameters::Access, StatsData::Access
     algebraic_p         sum(sum_fn op, uint xcol) const;
     algebraic_p         sum(sxy_fn op, uint xcol, uint ycol) const;
     algebraic_p         fit_transform(algebraic_r x, uint scol) const;
+    bool                transformed(uint col) const;
+    stats_cache *       accumulators() const;
+    algebraic_p         cached_sum(uint xcol, uint ycol = 0) const;
+    algebraic_p         cached_moment(uint xcol, uint ycol, bool pop) const;
 
     algebraic_p         num_rows() const;
     algebraic_p         sum_x() const;
@@ -123,6 +130,8 @@ struct StatsAccess : StatsParameters::Access, StatsData::Access
     algebraic_p         min() const;
     algebraic_p         max() const;
     algebraic_p         average() const;
+    algebraic_p         median() const;
+    algebraic_p         quantiles(object_p probs, bool percent) const;
     algebraic_p         variance() const;
     algebraic_p         standard_deviation() const;
     algebraic_p         correlation() const;
@@ -158,6 +167,41 @@ struct StatsAccess : StatsParameters::Access, StatsData::Access
 };
 
 
+struct StatsBins
+// ----------------------------------------------------------------------------
+//   Count the values of the independent column of ΣData in bins
+// ----------------------------------------------------------------------------
+//   Counters are kept in the scratchpad, bin 0 counting values below the
+//   range, and bin `bins+1` values above it.
+{
+    StatsBins()
+        : scr(), xmin(), width(), edges(), bins(), uniform(), exact(),
+          x0(), w() {}
+
+    static uint         arguments(object_p top);
+    bool                setup(object_p xmin, object_p xwidth, object_p nbins);
+    bool                setup(object_p edges);
+    bool                count(const StatsAccess &stats);
+    uint32_t            frequency(size_t bin);
+
+private:
+    double              edge_key(size_t k);
+    algebraic_p         edge(size_t k);
+    bool                below(object_r value, size_t k);
+    static bool         near(double x, double k);
+
+public:
+    scribble            scr;
+    algebraic_g         xmin;           // Uniform bins: first edge
+    algebraic_g         width;          // Uniform bins: width of each bin
+    list_g              edges;          // Non-uniform bins: all edges
+    size_t              bins;           // Number of bins in range
+    bool                uniform;        // Bins have the same width
+    bool                exact;          // Native edges are exact
+    double              x0, w;          // Native first edge and width
+};
+
+
 COMMAND_DECLARE(AddData,1);
 COMMAND_DECLARE(RemoveData,1);
 COMMAND_DECLARE(RecallData,0);
@@ -166,6 +210,11 @@ COMMAND_DECLARE(ClearData,0);
 COMMAND_DECLARE(DataSize,0);
 COMMAND_DECLARE(Average,0);
 COMMAND_DECLARE(Median,0);
+COMMAND_DECLARE(Quantile,1);
+COMMAND_DECLARE(Percentile,1);
+COMMAND_DECLARE(ListMedian,1);
+COMMAND_DECLARE(ListQuantile,2);
+COMMAND_DECLARE(ListPercentile,2);
 COMMAND_DECLARE(MinData,0);
 COMMAND_DECLARE(MaxData,0);
 COMMAND_DECLARE(SumOfX,0);
@@ -180,7 +229,7 @@ COMMAND_DECLARE(StandardDeviation,0);
 COMMAND_DECLARE(PopulationVariance,0);
 COMMAND_DECLARE(PopulationStandardDeviation,0);
 COMMAND_DECLARE(PopulationCovariance,0);
-COMMAND_DECLARE(FrequencyBins,3);
+COMMAND_DECLARE(FrequencyBins,~3);
 COMMAND_DECLARE(DataTotal,0);
 COMMAND_DECLARE(IndependentColumn,1);
 COMMAND_DECLARE(DependentColumn,1);
@@ -194,11 +243,15 @@ COMMAND_DECLARE(ExponentialFit,0);
 COMMAND_DECLARE(PowerFit,0);
 COMMAND_DECLARE(LogarithmicFit,0);
 
+bool stats_cache_flush();
+
 algebraic_p random_number();
 algebraic_p random_number(algebraic_r min, algebraic_r max);
 
 COMMAND_DECLARE(RandomNumber, 0);
 COMMAND_DECLARE(RandomSeed, 1);
 COMMAND_DECLARE(Random, 2);
+COMMAND_DECLARE(RandomUniform, 1);
+COMMAND_DECLARE(RandomNormal, 1);
 
 #endif // STATS_H
@@ -1870,6 +1870,55 @@ void tests::arithmetic()
     step("xroot");
     test(CLEAR, "8 3 xroot", ENTER).expect("2.");
     test(CLEAR, "-8 3 xroot", ENTER).expect("-2.");
+
+    step("Superinstructions in programs")
+        .test(CLEAR, "7 « DUP * » EVAL", ENTER).expect("49")
+        .test(CLEAR, "2.5 « DUP * » EVAL", ENTER).expect("6.25")
+        .test(CLEAR, "41 « 1 + » EVAL", ENTER).expect("42")
+        .test(CLEAR, "-1 « 1 + » EVAL", ENTER).expect("0")
+        .test(CLEAR, "0 « 1 - » EVAL", ENTER).expect("-1")
+        .test(CLEAR, "-21 « 2 * » EVAL", ENTER).expect("-42")
+        .test(CLEAR, "1 2 3 « SWAP DROP » EVAL DEPTH", ENTER).expect("2")
+        .test(CLEAR, "1 2 « SWAP DROP » EVAL", ENTER).expect("2")
+        .test(CLEAR, "1 2 « OVER OVER » EVAL + + +", ENTER).expect("6")
+        .test(CLEAR, "6 « 2 MOD 0 == » EVAL", ENTER).expect("True")
+        .test(CLEAR, "7 « 2 MOD 0 == » EVAL", ENTER).expect("False")
+        .test(CLEAR, "-8 « 2 MOD 0 == » EVAL", ENTER).expect("True")
+        .test(CLEAR, "7.5 « 2 MOD 0 == » EVAL", ENTER).expect("False");
+    step("Superinstructions in loops")
+        .test(CLEAR, "0 1 100 FOR i IF i 3 MOD 0 == THEN 1 + END NEXT", ENTER)
+        .expect("33")
+        .test(CLEAR, "2 1 5 START DUP * NEXT", ENTER)
+        .expect("4 294 967 296")
+        .test(CLEAR, "2 1 6 START DUP * NEXT 2 64 ^ -", ENTER)
+        .expect("0");
+    step("Superinstructions errors and last arguments")
+        .test(CLEAR, "1 « SWAP DROP » EVAL", ENTER)
+        .error("Too few arguments")
+        .test(CLEAR, "« DUP * » EVAL", ENTER)
+        .error("Too few arguments")
+        .test(CLEAR, "3 DUP *", ENTER).expect("9")
+        .test(SHIFT, M).expect("3")
+        .test(BSP).expect("3")
+        .test(BSP).expect("9")
+        .test(CLEAR, "41 1 +", ENTER).expect("42")
+        .test(SHIFT, M).expect("1")
+        .test(BSP).expect("41")
+        .test(BSP).expect("42")
+        .test(CLEAR, "5 2 SWAP DROP", ENTER).expect("2")
+        .test(SHIFT, M).expect("5")
+        .test(BSP).expect("2")
+        .test(CLEAR, "1 2 OVER OVER", ENTER).expect("2")
+        .test(SHIFT, M).expect("1")
+        .test(BSP).expect("2")
+        .test(BSP).expect("2")
+        .test(CLEAR, "7 2 MOD 0 ==", ENTER).expect("False")
+        .test(SHIFT, M).expect("0")
+        .test(BSP).expect("1")
+        .test(BSP).expect("False");
+    step("Superinstructions render as written")
+        .test(CLEAR, "« DUP * 1 + SWAP DROP 2 MOD 0 == »", ENTER)
+        .expect("«\n\tDuplicate × 1 + Swap Drop 2 mod 0 ==\n»");
 }
 
 
@@ -2149,6 +2198,13 @@ void tests::global_variables()
         .test(NOSHIFT, BSP).expect("11")
         .test(NOSHIFT, BSP).expect("{ 11 23 34 44 }");
 
+    step("Running a program after replacing it in place")
+        .test(CLEAR, "« 1 2 + » 'P' STO P", ENTER).expect("3")
+        .test(CLEAR, "« 3 4 * » 'P' STO P", ENTER).expect("12")
+        .test(CLEAR, "« 5 SQ 1 - » 'P' STO P", ENTER).expect("24")
+        .test(CLEAR, "'P' PURGE « 2 3 ^ » 'Q' STO Q", ENTER).expect("8")
+        .test(CLEAR, "'Q' PURGE", ENTER).noerror();
+
     step("Save to file as text")
         .test(CLEAR, "1.42 \"Hello.txt\"", NOSHIFT, G).noerror();
     step("Restore from file as text")
@@ -2167,6 +2223,32 @@ void tests::global_variables()
     step("Recall from file as BMP")
         .test(CLEAR, EXIT, "\"Hello.bmp\" RCL", ENTER).noerror()
         .image_noheader("rcl-bmp");
+    step("Save to file as CSV")
+        .test(CLEAR, "[[1 2.5 \"a\"][3 4.5 \"b\"]] \"Hello.csv\" STO", ENTER)
+        .noerror();
+    step("Recall from file as CSV")
+        .test(CLEAR, "\"Hello.csv\" RCL", ENTER).noerror()
+        .expect("[[ 1 2.5 \"a\" ]\n  [ 3 4.5 \"b\" ]]");
+    step("Recall selected columns from CSV")
+        .test(CLEAR, "\"Hello.csv\" { 2 1 } RecallColumns", ENTER).noerror()
+        .expect("[[ 2.5 1 ]\n  [ 4.5 3 ]]")
+        .test(CLEAR, "\"Hello.csv\" 3 RecallColumns", ENTER).noerror()
+        .expect("[ \"a\" \"b\" ]")
+        .test(CLEAR, "\"Hello.csv\" 0 RecallColumns", ENTER)
+        .error("Index out of range");
+    step("Recall CSV with decimal comma")
+        .test(CLEAR, "DecimalComma \"Hello.csv\" RCL", ENTER).noerror()
+        .expect("[[ 1 2,5 \"a\" ]\n  [ 3 4,5 \"b\" ]]")
+        .test(CLEAR, "DecimalDot", ENTER).noerror();
+    step("Save state image, reset and reload it")
+        .test(CLEAR, "3 FIX 42 'ImageVar' STO 1.5 2 \"Three\"", ENTER)
+        .noerror()
+        .test(IMAGE).noerror()
+        .expect("\"Three\"")
+        .test(NOSHIFT, BSP).expect("2")
+        .test(NOSHIFT, BSP).expect("1.500")
+        .test(CLEAR, "STD ImageVar", ENTER).expect("42")
+        .test(CLEAR, "'ImageVar' PURGE", ENTER).noerror();
 
     step("Allowing command names in quotes")
         .test(CLEAR, "'bar'", ENTER)
@@ -5228,6 +5310,29 @@ void tests::units_and_conversions()
               KEY2, F2,         // Enter 2_lb
               LSHIFT, F1)       // Convert to USD
         .expect("2.14 USD");
+    step("Repeated unit lookups with prefixes")
+        .test(CLEAR, "« 1 50 START 1._m/s 1_km/yr CONVERT DROP NEXT » EVAL",
+              ENTER)
+        .noerror()
+        .test(CLEAR, "1._m/s 1_km/yr CONVERT", ENTER)
+        .expect("31 556.92521 6 km/yr")
+        .test(CLEAR, "1_KiB 1_B CONVERT", ENTER)
+        .expect("1 024 B");
+    step("Repeated conversions between the same units")
+        .test(CLEAR, "2._in 1_mm CONVERT", ENTER)
+        .expect("50.8 mm")
+        .test(CLEAR, "2._in 1_mm CONVERT", ENTER)
+        .expect("50.8 mm")
+        .test(CLEAR, "3._in 1_mm CONVERT", ENTER)
+        .expect("76.2 mm")
+        .test(CLEAR, "100_°C 1_K CONVERT", ENTER)
+        .expect("373.15 K")
+        .test(CLEAR, "200_°C 1_K CONVERT", ENTER)
+        .expect("473.15 K")
+        .test(CLEAR, "1_m 1_s CONVERT", ENTER)
+        .error("Inconsistent units")
+        .test(CLEAR, "1_m 1_s CONVERT", ENTER)
+        .error("Inconsistent units");
 
     step("Temperature conversions forward, simple case")
         .test(CLEAR, "100_°C 1_K CONVERT", ENTER)
@@ -5431,6 +5536,59 @@ void tests::list_functions()
         .test(CLEAR, "{ A B C 1 2 3 }",LSHIFT, F5)
         .expect("{ 'B-A' 'C-B' '1-C' 1 1 }");
 
+    step("Map, filter and reduce")
+        .test(CLEAR, "{ 1 2 3 4 5 } « 1 + » MAP", ENTER)
+        .expect("{ 2 3 4 5 6 }")
+        .test(CLEAR, "{ 1 2 3 4 5 } « 2 > » FILTER", ENTER)
+        .expect("{ 3 4 5 }")
+        .test(CLEAR, "{ 1 2 3 4 5 } « * » REDUCE", ENTER)
+        .expect("120")
+        .test(CLEAR, "{ 1 { 2 3 } 4 } « 10 * » MAP 2 GET", ENTER)
+        .expect("{ 20 30 }")
+        .test(CLEAR, "{ 5 { 2 3 } 4 } « 2 > » FILTER 2 GET", ENTER)
+        .expect("{ 3 }");
+    step("Map steps run one after the other by default")
+        .test(CLEAR, "{ } 'L' STO "
+              "{ 1 2 } « DUP 'L' STO+ » MAP « DUP 10 * 'L' STO+ » MAP "
+              "DROP L", ENTER)
+        .expect("{ 1 2 10 20 }");
+    step("Fused map, filter and reduce pipeline")
+        .test(CLEAR, "ListPipelines", ENTER).noerror()
+        .test(CLEAR, "{ } 'L' STO "
+              "{ 1 2 } « DUP 'L' STO+ » MAP « DUP 10 * 'L' STO+ » MAP "
+              "DROP L 'L' PURGE", ENTER)
+        .expect("{ 1 10 2 20 }")
+        .test(CLEAR, "{ 1 2 3 4 5 } « 1 + » MAP « 3 > » FILTER", ENTER)
+        .expect("{ 4 5 6 }")
+        .test(CLEAR, "{ 1 2 3 4 5 } « 1 + » MAP « 3 > » FILTER « + » REDUCE",
+              ENTER)
+        .expect("15")
+        .test(CLEAR, "{ 1 2 3 4 5 } « 2 > » FILTER « SQ » MAP « 1 - » MAP",
+              ENTER)
+        .expect("{ 8 15 24 }")
+        .test(CLEAR, "{ 9 { 2 3 } 4 } « 10 * » MAP « 25 > » FILTER 2 GET",
+              ENTER)
+        .expect("{ 30 }")
+        .test(CLEAR, "{ 1 2 } « IF DUP 1 > THEN DUP 2 →List END » MAP "
+              "« 10 * » MAP 2 GET", ENTER)
+        .expect("{ 20 20 }")
+        .test(CLEAR, "{ 1 2 3 } « 1 + » MAP « DROP » FILTER", ENTER)
+        .error("Misbehaving program");
+    step("Pipeline in a program")
+        .test(CLEAR,
+              "« « 1 + » MAP « 3 > » FILTER « + » REDUCE 100 + » "
+              "'PIPE' STO", ENTER)
+        .test("{ 1 2 3 4 5 } PIPE", ENTER).expect("115")
+        .test(CLEAR, "'PIPE' PURGE", ENTER).noerror();
+    step("Sequential map, filter and reduce")
+        .test(CLEAR, "NoListPipelines", ENTER).noerror()
+        .test(CLEAR, "{ 1 2 3 4 5 } « 1 + » MAP « 3 > » FILTER « + » REDUCE",
+              ENTER)
+        .expect("15")
+        .test(CLEAR, "{ 9 { 2 3 } 4 } « 10 * » MAP « 25 > » FILTER 2 GET",
+              ENTER)
+        .expect("{ 30 }");
+
     step("DoList with explicit size in program")
         .test(CLEAR, "{ A B 3 } { D 5 6 } { E 8 F } 3 « + * » DOLIST", ENTER)
         .expect("{ 'A·(D+E)' '13·B' '3·(F+6)' }")
@@ -5532,6 +5690,23 @@ void tests::sorting_functions()
     step("Reverse sort (ReverseSort)")
         .test("ReverseSort", ENTER)
         .expect("{ \"DEF\" \"ABC\" 9.2 8.4 7 3 2.5 }");
+    step("Integer sort with native keys")
+        .test(CLEAR, "{ 5 -3 12 0 -17 4 12 1/2 } SORT", ENTER)
+        .expect("{ -17 -3 0 ¹/₂ 4 5 12 12 }")
+        .test(CLEAR, "{ 5 -3 12 0 -17 4 12 1/2 } ReverseSort", ENTER)
+        .expect("{ 12 12 5 4 ¹/₂ 0 -3 -17 }");
+    step("Stable sort")
+        .test(CLEAR, "{ 2 2. 1 1. 2 } SORT", ENTER)
+        .expect("{ 1 1. 2 2. 2 }");
+    step("Sort by key (SortBy)")
+        .test(CLEAR, "{ \"ccc\" \"a\" \"bb\" \"d\" } « SIZE » SortBy", ENTER)
+        .expect("{ \"a\" \"d\" \"bb\" \"ccc\" }")
+        .test(CLEAR, "{ 3 -5 1 -2 } « ABS » SortBy", ENTER)
+        .expect("{ 1 -2 3 -5 }")
+        .test(CLEAR, "{ 3 -5 1 -2 } « DROP » SortBy", ENTER)
+        .error("Misbehaving program")
+        .test(CLEAR, "3 « ABS » SortBy", ENTER)
+        .error("Bad argument type");
     step("Min function (integer)")
         .test(CLEAR, "1 2 MIN", ENTER).expect("1");
     step("Max function (integer)")
@@ -6250,6 +6425,51 @@ void tests::solver_testing()
         .test("'X'", ENTER, NOSHIFT, BSP, F2)
         .noerror();
 
+    step("Solver using Newton's method")
+        .test(CLEAR, "'X^3-2*X-5' 'X' 2 ROOT", ENTER)
+        .noerror().expect("X=2.09455 14815 4")
+        .test("SolverEvaluations", ENTER)
+        .expect("9");
+    step("Solver keeping Newton's method within the bracket")
+        .test(CLEAR, "'X^3-X' 'X' { 0.5 2 } ROOT", ENTER)
+        .noerror()
+        .test(CLEAR, "X 1 - abs 1E-10 <", ENTER)
+        .expect("True")
+        .test("'X'", ENTER, NOSHIFT, BSP, F2)
+        .noerror();
+    step("Solver using Brent's method")
+        .test(CLEAR, "'abs(X)^(1/3)*sign(X)-1/2' 'X' { -1 1 } ROOT", ENTER)
+        .noerror().expect("X=0.125")
+        .test("SolverEvaluations", ENTER)
+        .expect("15");
+    step("Solver with sign reversal")
+        .test(CLEAR, "'1/X' 'X' { -1 2 } ROOT", ENTER)
+        .error("Sign reversal")
+        .test(CLEAR, "X", ENTER)
+        .expect("3.46944 68625 5⁳⁻¹⁸")
+        .test("'X'", ENTER, NOSHIFT, BSP, F2)
+        .noerror();
+
+    step("Solving coupled linear equations")
+        .test(CLEAR, "{ 'U+V=3' 'U-V=1' } { U V } { 0 0 } ROOT", ENTER)
+        .noerror().expect("{ U=2. V=1. }")
+        .test("SolverEvaluations", ENTER)
+        .expect("8")
+        .test(CLEAR, "{ U V } PURGE", ENTER)
+        .noerror();
+    step("Solving coupled non-linear equations")
+        .test(CLEAR, "{ 'U^2+V^2=4' 'U*V=1' } { U V } { 2 0 } ROOT", ENTER)
+        .noerror().expect("{ U=1.93185 16525 8 V=0.51763 80902 05 }")
+        .test("SolverEvaluations", ENTER)
+        .expect("32")
+        .test(CLEAR, "{ U V } PURGE", ENTER)
+        .noerror();
+    step("Solving coupled equations without solution")
+        .test(CLEAR, "{ 'U^2+V^2=-1' 'U=V' } { U V } { 1 2 } ROOT", ENTER)
+        .error("No solution?")
+        .test(CLEAR, "{ U V } PURGE", ENTER)
+        .noerror();
+
     step("Solving menu")
         .test(CLEAR, "'A²+B²=C²'", ENTER)
         .test(LSHIFT, KEY7, LSHIFT, F1, F6)
@@ -6257,7 +6477,7 @@ void tests::solver_testing()
         .expect("C=5.");
     step("Evaluate equation case Left=Right")
         .test(F1)
-        .expect("'25=25.-4.⁳⁻²²'");
+        .expect("'25=25.-3.⁳⁻²²'");
 
     step("Verify that we display the equation after entering value")
         .test(CLEAR, "42", F4)
@@ -6674,6 +6894,51 @@ void tests::numerical_integration_testing()
         .editor("'∫(A;1;1÷X;X)'")
         .test(ENTER)
         .expect("'∫(A;1;1÷X;X)'");
+
+    step("Gauss-Kronrod integration")
+        .test(CLEAR, "GaussKronrod", ENTER).noerror()
+        .test("1 2 '1/X' 'X' ∫", ENTER)
+        .noerror().expect("0.69314 71805 6")
+        .test(KEY2, ID_log, ID_sub).expect("-6.⁳⁻²³")
+        .test("IntegrationEvaluations", ENTER).expect("135")
+        .test(CLEAR, "0 1 '1/(1+X^2)' 'X' ∫", ENTER)
+        .noerror().expect("0.78539 81633 97")
+        .test("4 * 3.14159265358979323846264 -", ENTER).expect("-1.9⁳⁻²²")
+        .test("IntegrationEvaluations", ENTER).expect("195");
+    step("Gauss-Kronrod integration with a peak")
+        .test(CLEAR, "-1 1 '1/(1+1000*X^2)' 'X' ∫", ENTER)
+        .noerror().expect("0.09734 65489 25")
+        .test("IntegrationEvaluations", ENTER).expect("1 785");
+    step("Tanh-sinh integration")
+        .test(CLEAR, "TanhSinh", ENTER).noerror()
+        .test("1 2 '1/X' 'X' ∫", ENTER)
+        .noerror().expect("0.69314 71805 6")
+        .test(KEY2, ID_log, ID_sub).expect("-2.93⁳⁻²¹")
+        .test("IntegrationEvaluations", ENTER).expect("115");
+    step("Tanh-sinh integration with end point singularity")
+        .test(CLEAR, "0 1 '1/sqrt(X)' 'X' ∫", ENTER)
+        .noerror().expect("2.")
+        .test("IntegrationEvaluations", ENTER).expect("126")
+        .test(CLEAR, "-1 1 '1/sqrt(1-X^2)' 'X' ∫", ENTER)
+        .noerror().expect("3.14159 26535 9")
+        .test("3.14159265358979323846264 - abs 1E-18 <", ENTER).expect("True")
+        .test("IntegrationEvaluations", ENTER).expect("135");
+    step("Romberg integration")
+        .test(CLEAR, "Romberg", ENTER).noerror()
+        .test("1 2 '1/X' 'X' ∫", ENTER)
+        .noerror().expect("0.69314 71805 6")
+        .test("IntegrationEvaluations", ENTER).expect("257")
+        .test(CLEAR, "'IntegrationMethod' Purge", ENTER).noerror();
+
+    step("Integrate with hardware floating-point")
+        .test(CLEAR, "16 PRECISION 12 SIG HardFP", ENTER).noerror()
+        .test("1. 2. '1/X' 'X' ∫", ENTER)
+        .noerror().expect("0.69314 71805 6D")
+        .test("1. 2. '3*X^2+2*sin(X)-1/X' 'X' ∫", ENTER)
+        .noerror().expect("6.35920 60515 6D")
+        .test("1. 2. « 1 SWAP / » 'X' ∫", ENTER)
+        .noerror().expect("0.69314 71805 6D")
+        .test(CLEAR, "24 PRECISION 12 SIG SoftFP", ENTER).noerror();
 }
 
 
@@ -7041,6 +7306,13 @@ void tests::rewrite_engine()
               "↓match", ENTER)
         .expect("3")
         .test(BSP).expect("'cos(2·A)+cos((3-1)·B+B)+sin((3-1)·C+C+C)'");
+    step("Matching with conditions on two wildcards")
+        .test(CLEAR,
+              "'5*3+3*5' "
+              "{ 'I*J' 'J*I' 'J>I' } "
+              "↓match", ENTER)
+        .expect("1")
+        .test(BSP).expect("'5·3+5·3'");
 
     step("Setting ExplicitWildcards to match with &Wildcard")
         .test(CLEAR,
@@ -7415,6 +7687,19 @@ void tests::symbolic_differentiation()
     step("Derivative of unknown form")
         .test(CLEAR, "'IP(X)' 'X'", ID_Derivative)
         .error("Unknown derivative");
+
+    step("Repeated derivative gives the same result")
+        .test(CLEAR, "'sin(A*X^2)*exp(B*X)' 'X'", ID_Derivative)
+        .expect("'sin(A·X²)·B·exp(B·X)+2·A·X·cos(A·X²)·exp(B·X)'")
+        .test(CLEAR, "'sin(A*X^2)*exp(B*X)' 'X'", ID_Derivative)
+        .expect("'sin(A·X²)·B·exp(B·X)+2·A·X·cos(A·X²)·exp(B·X)'");
+    step("Derivative after changing a variable")
+        .test(CLEAR, "'X^A' 'X'", ID_Derivative)
+        .expect("'X↑A·A÷X'")
+        .test(CLEAR, "3 'A' STO 'X^A' 'X'", ID_Derivative)
+        .expect("'3·X²'")
+        .test(CLEAR, "'A' PURGE 'X^A' 'X'", ID_Derivative)
+        .expect("'X↑A·A÷X'");
 }
 
 
@@ -8724,6 +9009,24 @@ void tests::online_help()
     step("Invoke help about DEG menu command with long press")
         .test(EXIT, SHIFT, N, LONGPRESS, F1)
         .image_noheader("help-degrees");
+    step("Help about a command using an alternate spelling")
+        .test(EXIT, CLEAR, "\"DUP\" HELP", ENTER).noerror()
+        .help_topic("Duplicate")
+        .test(EXIT, CLEAR, "\"RCLΣ\" HELP", ENTER).noerror()
+        .help_topic("RecallΣ (RCLΣ)");
+    step("Help about an unknown topic")
+        .test(EXIT, CLEAR, "\"Glorp\" HELP", ENTER)
+        .error("No help for Glorp");
+    step("Scrolling back up resumes the help layout")
+        .test(EXIT, CLEAR, EXIT, "\"authors\"", NOSHIFT, RSHIFT, ADD)
+        .help_topic("Authors")
+        .test(DOWN, DOWN, DOWN, DOWN, DOWN, DOWN, DOWN, DOWN,
+              UP, UP, UP, UP).noerror()
+        .help_topic("Authors")
+        .image_noheader("help-authors");
+    step("Scrolling down again from the top of the topic")
+        .test(UP, UP, UP, UP, DOWN, DOWN, DOWN, DOWN).noerror()
+        .image_noheader("help-authors");
     step("Exit and cleanup")
         .test(EXIT, CLEAR, EXIT);
 
@@ -9312,6 +9615,14 @@ void tests::insertion_of_variables_constants_and_units()
     step("Programmatic library lookup (error)")
         .test(CLEAR, "\"Glop\" XLIB", ENTER)
         .error("Invalid or unknown library entry");
+    step("Repeated constant lookups")
+        .test(CLEAR, "\"NA\" CONST \"NA\" CONST /", ENTER)
+        .expect("1");
+    step("Constant lookup requires an exact name")
+        .test(CLEAR, "\"N\" CONST", ENTER)
+        .error("Invalid or unknown constant")
+        .test(CLEAR, "\"NAA\" CONST", ENTER)
+        .error("Invalid or unknown constant");
 
     step("Select units menu")
         .test(CLEAR, LSHIFT, KEY5, F4).image_menus("units-menu", 3);
@@ -10277,6 +10588,72 @@ void tests::random_number_generation()
         .test(ID_MinData).expect("-1 000")
         .test(ID_MaxData).expect("998");
 
+    step("Statistics after adding and removing data")
+        .test(CLEAR, ID_StatisticsMenu, ID_ClearData)
+        .test(CLEAR, "[1 2] Σ+ [3 5] Σ+ [4 7] Σ+ [10 20] Σ+ Σ-", ENTER)
+        .expect("[ 10 20 ]")
+        .test(CLEAR, ID_DataTotal).expect("[ 8 14 ]")
+        .test(CLEAR, ID_Variance).expect("[ 2 ¹/₃ 6 ¹/₃ ]")
+        .test(CLEAR, ID_Covariance).expect("3 ⁵/₆")
+        .test(CLEAR, ID_MaxData).expect("[ 4 7 ]");
+
+    step("Median and quantiles")
+        .test(CLEAR, ID_Median).expect("[ 3 5 ]")
+        .test(CLEAR, "{ 0 0.5 1 } Quantile", ENTER)
+        .expect("{ [ 1 2 ] [ 3 5 ] [ 4 7 ] }")
+        .test(CLEAR, "75 Percentile", ENTER)
+        .expect("[ 3 ¹/₂ 6 ]")
+        .test(CLEAR, "{ 3 1 4 1 5 9 } ListMedian", ENTER)
+        .expect("3 ¹/₂")
+        .test(CLEAR, "{ 3 1 4 1 5 } { 0 0.25 1 } ListQuantile", ENTER)
+        .expect("{ 1 1 5 }")
+        .test(CLEAR, "{ 10 20 30 40 } 50 ListPercentile", ENTER)
+        .expect("25")
+        .test(CLEAR, "{ 1 2 } 2 ListQuantile", ENTER)
+        .error("Argument outside domain");
+
+    step("Frequency bins")
+        .test(CLEAR, "0 2 2 FrequencyBins", ENTER).expect("[ 0 1 ]")
+        .test(CLEAR, "[ 0 3 5 ] Bins", ENTER).expect("[ 0 0 ]")
+        .test(CLEAR, "[ 0 3 5 ] Bins DROP SIZE", ENTER).expect("{ 2 1 }")
+        .test(CLEAR, "[ 0 5 3 ] Bins", ENTER)
+        .error("Argument outside domain");
+    step("Frequency bins: values on bin edges")
+        .test(CLEAR, "[ 0 1 2 2 3.5 5.99 6 -1 ] 'ΣData' STO", ENTER)
+        .noerror()
+        .test(CLEAR, "0 2 3 FrequencyBins", ENTER).expect("[ 1 1 ]")
+        .test(NOSHIFT, BSP).expect("[[ 2 ]\n  [ 3 ]\n  [ 1 ]]")
+        .test(CLEAR, "[ 0 1 2.5 6 ] FrequencyBins", ENTER).expect("[ 1 1 ]")
+        .test(NOSHIFT, BSP).expect("[[ 1 ]\n  [ 3 ]\n  [ 2 ]]");
+    step("Frequency bins: decimal values on bin edges")
+        .test(CLEAR, "[ 0.1 0.2 0.3 0.39 0.4 ] 'ΣData' STO", ENTER)
+        .noerror()
+        .test(CLEAR, "0.1 0.1 3 FrequencyBins", ENTER).expect("[ 0 1 ]")
+        .test(NOSHIFT, BSP).expect("[[ 1 ]\n  [ 1 ]\n  [ 2 ]]")
+        .test(CLEAR, "[ 0.1 0.2 0.3 0.4 ] FrequencyBins", ENTER)
+        .expect("[ 0 1 ]")
+        .test(NOSHIFT, BSP).expect("[[ 1 ]\n  [ 1 ]\n  [ 2 ]]")
+        .test(CLEAR, "'ΣData' PURGE", ENTER).noerror();
+
+    step("Fill arrays with random values")
+        .test(CLEAR, "17 RDZ 5 RandomUniform SIZE", ENTER).expect("{ 5 }")
+        .test(CLEAR, "{ 2 3 } RandomNormal SIZE", ENTER).expect("{ 2 3 }")
+        .test(CLEAR, "{ 4 } RandU SIZE", ENTER).expect("4")
+        .test(CLEAR, "17 RDZ 3 RandU 17 RDZ 3 RandU SAME", ENTER)
+        .expect("True")
+        .test(CLEAR, "17 RDZ 3 RandN 42 RDZ 3 RandN SAME", ENTER)
+        .expect("False");
+    step("Reproducible random seed")
+        .test(CLEAR, "FixedRandomSeed 0 RDZ 3 RandU 0 RDZ 3 RandU SAME",
+              ENTER).expect("True")
+        .test(CLEAR, "FixedRandomSeed 0 RDZ 3 RandU "
+              "[ 0.343713696652611 0.512806476267399 0.0259961181473803 ] "
+              "- ABS 0 ==", ENTER).expect("True")
+        .test(CLEAR, "7 PRECISION HardFP FixedRandomSeed 0 RDZ 3 RandU "
+              "16777216 * [ 5766558 8603465 436142 ] - ABS 0 ==", ENTER)
+        .expect("True")
+        .test(CLEAR, "24 PRECISION SoftFP ClockRandomSeed", ENTER).noerror();
+
     step("Random graphing")
         .test(CLEAR,
               "5121968 RDZ "
@@ -10748,6 +11125,13 @@ void tests::regression_checks()
               ID_mul, ID_sqrt, ID_inv, ID_ToDecimal)
         .expect("299 792 458. m/(F↑(¹/₂)·H↑(¹/₂))");
 
+    step("Comparing decimal values with zero")
+        .test(CLEAR, "0.001 0. <", ENTER).expect("False")
+        .test(CLEAR, "0. 0.001 <", ENTER).expect("True")
+        .test(CLEAR, "-0.001 0. <", ENTER).expect("True")
+        .test(CLEAR, "0. -0.001 <", ENTER).expect("False")
+        .test(CLEAR, "0. 0. <", ENTER).expect("False");
+
     step("Checking parsing of unary -")
         .test(CLEAR, "'-X'", ENTER).expect("'-X'")
         .test(CLEAR, "'-X^2'", ENTER).expect("'-(X↑2)'")
@@ -10772,6 +11156,8 @@ void tests::plotting()
 
     step("Select radians");
     test(CLEAR, "RAD", ENTER).noerror();
+    step("Sample every pixel for reference images");
+    test(CLEAR, "FixedPlotSampling", ENTER).noerror();
 
     step("Function plot: Sine wave");
     test(CLEAR, "'3*sin(x)' FunctionPlot", LENGTHY(200), ENTER)
@@ -10953,6 +11339,93 @@ void tests::plotting()
 
     step("Reset drawing parameters");
     test(CLEAR, "1 LineWidth 0 GRAY Foreground", ENTER).noerror();
+
+    step("Adaptive sampling")
+        .test(CLEAR, "AdaptivePlotSampling 'PPAR' PURGE", ENTER).noerror()
+        .test(CLEAR, "'3*sin(x)' FunctionPlot", LENGTHY(200), ENTER)
+        .noerror()
+        .test(CLEAR, "'1/x' FunctionPlot", LENGTHY(200), ENTER)
+        .noerror();
+    step("Adaptive sampling: Redraw from cached samples")
+        .test(CLEAR, "'3*sin(x)' 'EQ' STO DRAW", LENGTHY(200), ENTER)
+        .noerror()
+        .test(CLEAR, "DRAX DRAW", LENGTHY(200), ENTER)
+        .noerror();
+    step("Adaptive sampling: Pan by one pixel")
+        .test(CLEAR, "-9.95 10.05 XRNG DRAW", LENGTHY(200), ENTER)
+        .noerror();
+    step("Adaptive sampling: Progressive refresh")
+        .test(CLEAR, "50 PlotRefreshRate 'x*sin(x)' FunctionPlot",
+              LENGTHY(200), ENTER)
+        .noerror()
+        .test(CLEAR, "500 PlotRefreshRate", ENTER)
+        .noerror();
+    step("Adaptive sampling: Variable changes")
+        .test(CLEAR, "1 'A' STO 'A*sin(x)' 'EQ' STO DRAW", LENGTHY(200), ENTER)
+        .noerror()
+        .test(CLEAR, "3 'A' STO DRAW", LENGTHY(200), ENTER)
+        .noerror()
+        .test(CLEAR, "{ A EQ PPAR } PURGE", ENTER)
+        .noerror();
+    step("Adaptive sampling: Narrow spike in a flat region")
+        .test(CLEAR, DIRECT(
+              "'5*exp(-(40*(x-5.075))^2)' FunctionPlot "
+              "0 "
+              "70 100 for r "
+              "{ } 10#302 + 10#0 r + + pix? + "
+              "next "
+              "31 <"),
+              LENGTHY(2000), ENTER)
+        .test(ENTER)
+        .expect("True");
+    step("Bar plot of frequency bins")
+        .test(CLEAR, "'PPAR' PURGE [ 0 1 2 2 3.5 5.99 6 -1 ] 'ΣData' STO",
+              ENTER).noerror()
+        .test(CLEAR, DIRECT(
+              "{ 0 2 3 } BarPlot "
+              "{ } 10#60 + 10#85 + pix? "
+              "{ } 10#60 + 10#75 + pix? "
+              "{ } 10#170 + 10#65 + pix? "
+              "{ } 10#170 + 10#55 + pix? "
+              "{ } 10#330 + 10#105 + pix? "
+              "{ } 10#330 + 10#95 + pix? "
+              "6 →List"),
+              LENGTHY(1000), ENTER)
+        .test(ENTER)
+        .expect("{ 0 1 0 1 0 1 }")
+        .test(CLEAR, "'ΣData' PURGE", ENTER).noerror();
+    step("Adaptive sampling: Interrupt with EXIT")
+        .test(CLEAR, "{ EQ PPAR } PURGE '3*sin(x)' 'EQ' STO", ENTER)
+        .noerror()
+        .test(CLEAR, "DRAW", ENTER, EXIT)
+        .test(CLEAR, "Kill", ENTER)
+        .noerror();
+    step("Adaptive sampling: Resume interrupted plot")
+        .test(CLEAR, DIRECT(
+              "DRAW "
+              "0 "
+              "-10 9.9 for x "
+              "{ } x + x sin 3 * + pix? + "
+              "0.1 step"),
+              LENGTHY(2000), ENTER)
+        .test(ENTER)
+        .expect("0");
+    step("Adaptive sampling: Interrupt panned plot with EXIT")
+        .test(CLEAR, "-9.95 10.05 XRNG DRAW", ENTER, EXIT)
+        .test(CLEAR, "Kill", ENTER)
+        .noerror();
+    step("Adaptive sampling: Resume panned plot")
+        .test(CLEAR, DIRECT(
+              "DRAW "
+              "0 "
+              "-9.95 9.95 for x "
+              "{ } x + x sin 3 * + pix? + "
+              "0.1 step"),
+              LENGTHY(2000), ENTER)
+        .test(ENTER)
+        .expect("0")
+        .test(CLEAR, "{ EQ PPAR } PURGE", ENTER)
+        .noerror();
 }
 
 
@@ -10964,6 +11437,8 @@ void tests::plotting_all_functions()
     BEGIN(plotfns);
 
     step("Select radians").test(CLEAR, SHIFT, N, F2).noerror();
+    step("Sample every pixel for reference images")
+        .test(CLEAR, "FixedPlotSampling", ENTER).noerror();
 
     step("Select 24-digit precision").test(CLEAR, SHIFT, O, 24, F6).noerror();
 
@@ -11035,6 +11510,9 @@ void tests::plotting_all_functions()
 
     FUNCTION(ToDecimal);
     FUNCTION(ToFraction);
+
+    step("Restore adaptive sampling")
+        .test(CLEAR, "AdaptivePlotSampling", ENTER).noerror();
 }
 
 
@@ -12052,6 +12530,18 @@ tests &tests::clear_error(uint extrawait)
 }
 
 
+tests &tests::state_image(uint extrawait)
+// ----------------------------------------------------------------------------
+//   Save a state file and its binary image, then reload the image
+// ----------------------------------------------------------------------------
+{
+    flush();
+    nokeys(extrawait);
+    rpl_command(IMAGE, extrawait);
+    return *this;
+}
+
+
 tests &tests::ready(uint extrawait)
 // ----------------------------------------------------------------------------
 //   Check if the calculator is ready and we can look at it
@@ -12242,6 +12732,7 @@ tests &tests::itest(tests::key k, bool release)
     case CLEARERR: return clear_error();
     case NOKEYS: return nokeys();
     case REFRESH: return refreshed();
+    case IMAGE: return state_image();
     case LONGPRESS:
         longpress = true; // Next key will be a long press
         return *this;
@@ -13255,6 +13746,36 @@ tests &tests::cursor(size_t csr, uint extrawait)
 }
 
 
+tests &tests::help_topic(cstring topic, uint extrawait)
+// ----------------------------------------------------------------------------
+//   Check that the help shows the given topic
+// ----------------------------------------------------------------------------
+{
+    nokeys(extrawait);
+    if (!ui.showing_help())
+        return explain("Expected help topic [", topic, "], "
+                       "but help is not shown").fail();
+
+    // Read the heading at the help position
+    char  heading[256] = "";
+    FILE *f            = fopen(HELPFILE_NAME, "r");
+    if (f)
+    {
+        if (fseek(f, ui.help, SEEK_SET) || !fgets(heading, sizeof(heading), f))
+            heading[0] = 0;
+        fclose(f);
+    }
+
+    // Skip leading '#' and spaces, strip trailing newline
+    cstring title = heading;
+    while (*title == '#' || *title == ' ')
+        title++;
+    heading[strcspn(heading, "\n")] = 0;
+    return check(strcmp(title, topic) == 0,
+                 "Expected help topic [", topic, "], got [", title, "]");
+}
+
+
 tests &tests::error(cstring msg, uint extrawait)
 // ----------------------------------------------------------------------------
 //   Check that the error message matches expectations
@@ -235,6 +235,7 @@ struct tests
         LONGPRESS  = 105,       // Force long press
         EXIT_PGM   = 106,       // Exiting program
         SAVE_PGM   = 107,       // Save program on the RPL thread
+        IMAGE      = 108,       // Save, reset and reload a state image
 
         // Reaching a specific shift state
         NOSHIFT    = 110,       // Clear shifts
@@ -374,6 +375,7 @@ public:
     tests &refreshed(uint extrawait = 0);
     tests &screen_refreshed(uint extrawait = 0);
     tests &ready(uint extrawait = 0);
+    tests &state_image(uint extrawait = 0);
     tests &shifts(bool lshift, bool rshift, bool alpha, bool lowercase);
     tests &wait(uint ms);
     tests &want(cstring output, uint extrawait = 0);
@@ -410,6 +412,7 @@ public:
     tests &editing(size_t length, uint extrawait = 0);
     tests &editor(cstring text, uint extrawait = 0);
     tests &cursor(size_t csr, uint extrawait = 0);
+    tests &help_topic(cstring topic, uint extrawait = 0);
     tests &error(cstring msg, uint extrawait = 0);
     tests &noerror(uint extrawait = 0)
     {
@@ -37,6 +37,7 @@
 #include "file.h"
 #include "functions.h"
 #include "grob.h"
+#include "hash.h"
 #include "integer.h"
 #include "parser.h"
 #include "renderer.h"
@@ -861,6 +862,523 @@ static const si_prefix si_prefixes[] =
 
 
 
+// ============================================================================
+//
+//   Unit index
+//
+// ============================================================================
+//
+//   Looking up a unit used to scan `config/units.csv` and `basic_units[]`
+//   linearly for each possible SI prefix, then parse the definition.
+//   Instead, the definitions are indexed by name in sorted tables, built
+//   once for the built-in units, and rebuilt for the units file when it
+//   changes size or after the calculator wrote a file. The file size is
+//   checked at most once every RECHECK_MS milliseconds. The parsed results
+//   of recent lookups are remembered in a small direct-mapped table.
+//   Similarly, the conversion factors between linear unit expressions are
+//   remembered, so that converting again between the same units only
+//   needs a multiplication. If there is not enough memory for the index,
+//   lookups scan the units file and built-in units like before.
+
+struct unit_index
+// ----------------------------------------------------------------------------
+//   Sorted index of unit definitions from the units file and built-ins
+// ----------------------------------------------------------------------------
+{
+    enum { RECHECK_MS = 1000, ENTRIES = 16 };
+
+    struct memo
+    {
+        symbol_g name;
+        unit_g   result;
+        int      prefix;
+        uint32_t settings;
+    };
+
+    struct factor
+    {
+        algebraic_g from;
+        algebraic_g to;
+        algebraic_g scale;
+        uint32_t    settings;
+    };
+
+    static symbol_p file_lookup(gcutf8 name, size_t len);
+    static cstring builtin_lookup(utf8 name, size_t len);
+    static unit_p  memo_lookup(symbol_r name, int *prefix, uint32_t &h);
+    static void    memo_store(symbol_r name, unit_r result, int prefix,
+                              uint32_t h);
+    static algebraic_p factor_lookup(algebraic_r from, algebraic_r to,
+                                     uint32_t &h);
+    static void        factor_store(algebraic_r from, algebraic_r to,
+                                    algebraic_r scale, uint32_t h);
+    static bool    flush();
+
+protected:
+    static uint32_t factor_key(algebraic_r from, algebraic_r to, uint32_t h);
+    static void    validate();
+    static bool    rebuild(unit_file &uf);
+    static bool    append(char c);
+    static int     compare(cstring entry, utf8 name, size_t len);
+
+    static char     *pool;      // Names and definitions, NUL-terminated
+    static size_t    used;      // Bytes used in pool
+    static size_t    capacity;  // Bytes allocated for pool
+    static uint32_t *entries;   // Offsets of names in pool, sorted by name
+    static uint      count;     // Number of file entries
+    static uint16_t *builtins;  // Indexes in basic_units, sorted by name
+    static uint      nbuiltins; // Number of built-in entries
+    static bool      built;     // File index is up to date
+    static bool      failed;    // Not enough memory to index the file
+    static uint      fsize;     // File size when the index was built
+    static uint      writes;    // File writes when the index was built
+    static uint      checked;   // Last time we checked the file
+    static memo     *memos;     // Recently looked up units
+    static factor   *factors;   // Recently used conversion factors
+};
+
+char          *unit_index::pool      = nullptr;
+size_t         unit_index::used      = 0;
+size_t         unit_index::capacity  = 0;
+uint32_t      *unit_index::entries   = nullptr;
+uint           unit_index::count     = 0;
+uint16_t      *unit_index::builtins  = nullptr;
+uint           unit_index::nbuiltins = 0;
+bool           unit_index::built     = false;
+bool           unit_index::failed    = false;
+uint           unit_index::fsize     = 0;
+uint           unit_index::writes    = 0;
+uint           unit_index::checked   = 0;
+unit_index::memo *unit_index::memos  = nullptr;
+unit_index::factor *unit_index::factors = nullptr;
+
+
+int unit_index::compare(cstring entry, utf8 name, size_t len)
+// ----------------------------------------------------------------------------
+//   Compare a NUL-terminated entry with a name of the given length
+// ----------------------------------------------------------------------------
+{
+    int cmp = strncmp(entry, cstring(name), len);
+    if (cmp)
+        return cmp;
+    return entry[len] ? 1 : 0;
+}
+
+
+static int sort_units(const void *l, const void *r)
+// ----------------------------------------------------------------------------
+//   Sort built-in units by name, then by position in the table
+// ----------------------------------------------------------------------------
+{
+    uint16_t li = *((uint16_t *) l);
+    uint16_t ri = *((uint16_t *) r);
+    int cmp = strcmp(basic_units[li], basic_units[ri]);
+    return cmp ? cmp : int(li) - int(ri);
+}
+
+
+static cstring sort_pool = nullptr;
+
+static int sort_entries(const void *l, const void *r)
+// ----------------------------------------------------------------------------
+//   Sort file units by name, then by position in the file
+// ----------------------------------------------------------------------------
+{
+    uint32_t lo = *((uint32_t *) l);
+    uint32_t ro = *((uint32_t *) r);
+    int cmp = strcmp(sort_pool + lo, sort_pool + ro);
+    return cmp ? cmp : lo < ro ? -1 : lo > ro;
+}
+
+
+bool unit_index::append(char c)
+// ----------------------------------------------------------------------------
+//   Append a character to the pool
+// ----------------------------------------------------------------------------
+{
+    if (used >= capacity)
+    {
+        size_t ncap = capacity ? 2 * capacity : 512;
+        char  *npool = (char *) realloc(pool, ncap);
+        if (!npool)
+            return false;
+        pool = npool;
+        capacity = ncap;
+    }
+    pool[used++] = c;
+    return true;
+}
+
+
+bool unit_index::rebuild(unit_file &uf)
+// ----------------------------------------------------------------------------
+//   Read the units file once and index its definitions
+// ----------------------------------------------------------------------------
+//   This follows the rules of unit_file::lookup: rows in sections whose
+//   name begins with '=' are ignored, as are definitions beginning with
+//   '=', which only indicate that the unit shows in menus.
+{
+    used  = 0;
+    count = 0;
+    built = false;
+
+    uint   column   = 0;
+    bool   quoted   = false;
+    bool   nodefs   = false;
+    size_t start    = 0;
+    size_t defstart = 0;
+    size_t rows     = 0;
+    bool   ok       = true;
+
+    uf.seek(0);
+    while (ok)
+    {
+        char c = uf.getchar();
+        if (c == '"')
+        {
+            if (quoted && uf.peek() == '"')
+            {
+                c = uf.getchar();
+                if (column < 2)
+                    ok = append(c);
+            }
+            else
+            {
+                quoted = !quoted;
+                if (!quoted)
+                {
+                    if (column < 2)
+                        ok = append(0);
+                    column++;
+                    if (column == 1)
+                        defstart = used;
+                }
+            }
+        }
+        else if (c == '\n' || !c)
+        {
+            if (column == 1)
+            {
+                // Section header
+                nodefs = pool[start] == '=';
+                used = start;
+            }
+            else if (column >= 2 && !nodefs &&
+                     pool[defstart] && pool[defstart] != '=')
+            {
+                // Unit definition
+                start = used;
+                rows++;
+            }
+            else
+            {
+                used = start;
+            }
+            column = 0;
+            quoted = false;
+            if (!c)
+                break;
+        }
+        else if (quoted && column < 2)
+        {
+            ok = append(c);
+        }
+    }
+    if (!ok)
+    {
+        used = 0;
+        return false;
+    }
+
+    // Build the sorted table of entries
+    uint32_t *nentries = (uint32_t *) realloc(entries,
+                                              (rows + 1) * sizeof(uint32_t));
+    if (!nentries)
+        return false;
+    entries = nentries;
+    for (size_t o = 0; o < used && count < rows; count++)
+    {
+        entries[count] = o;
+        o += strlen(pool + o) + 1;      // Name
+        o += strlen(pool + o) + 1;      // Definition
+    }
+    sort_pool = pool;
+    qsort(entries, count, sizeof(entries[0]), sort_entries);
+    built = true;
+    record(units, "Indexed %u units from file, %u bytes", count, used);
+    return true;
+}
+
+
+void unit_index::validate()
+// ----------------------------------------------------------------------------
+//   Check that the index is up to date, rebuild it if necessary
+// ----------------------------------------------------------------------------
+{
+    // Built-in units never change
+    if (!builtins)
+    {
+        size_t maxu = sizeof(basic_units) / sizeof(basic_units[0]);
+        uint   n    = 0;
+        for (size_t u = 0; u < maxu; u += 2)
+            if (basic_units[u + 1] && *basic_units[u + 1] != '=')
+                n++;
+        builtins = (uint16_t *) malloc((n + 1) * sizeof(uint16_t));
+        if (builtins)
+        {
+            for (size_t u = 0; u < maxu; u += 2)
+                if (basic_units[u + 1] && *basic_units[u + 1] != '=')
+                    builtins[nbuiltins++] = u;
+            qsort(builtins, nbuiltins, sizeof(builtins[0]), sort_units);
+        }
+    }
+
+    // Avoid checking the file on every lookup
+    uint now = sys_current_ms();
+    if ((built || failed) &&
+        writes == file::writes && now - checked < RECHECK_MS)
+        return;
+    checked = now;
+
+    unit_file uf;
+    uint      sz = uf.valid() ? uf.size() + 1 : 0;
+    if (built && writes == file::writes && sz == fsize)
+        return;
+
+    flush();
+    writes = file::writes;
+    fsize = sz;
+    if (sz)
+    {
+        failed = !rebuild(uf);
+        if (failed)
+            record(units, "Not enough memory to index units file");
+    }
+    else
+    {
+        count = 0;
+        built = true;
+    }
+}
+
+
+symbol_p unit_index::file_lookup(gcutf8 name, size_t len)
+// ----------------------------------------------------------------------------
+//   Find the first definition for a name in the units file
+// ----------------------------------------------------------------------------
+//   The definition is copied, since the index may be rebuilt while parsing
+{
+    validate();
+    if (!built)
+    {
+        // Not indexed, scan the file
+        unit_file uf;
+        if (uf.valid())
+        {
+            bool first = true;
+            while (symbol_p def = uf.lookup(name, len, false, first))
+            {
+                // If definition begins with '=', only show unit in menus
+                first = false;
+                size_t dlen = 0;
+                utf8   fdef = def->value(&dlen);
+                if (*fdef != '=')
+                    return def;
+            }
+        }
+        return nullptr;
+    }
+
+    uint lo = 0, hi = count;
+    while (lo < hi)
+    {
+        uint mid = (lo + hi) / 2;
+        if (compare(pool + entries[mid], name, len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < count && compare(pool + entries[lo], name, len) == 0)
+        return symbol::make(pool + entries[lo] + len + 1);
+    return nullptr;
+}
+
+
+cstring unit_index::builtin_lookup(utf8 name, size_t len)
+// ----------------------------------------------------------------------------
+//   Find the first built-in definition for a name
+// ----------------------------------------------------------------------------
+{
+    validate();
+    if (!builtins)
+    {
+        // Not indexed, scan the built-in units
+        size_t maxu = sizeof(basic_units) / sizeof(basic_units[0]);
+        for (size_t u = 0; u < maxu; u += 2)
+            if (basic_units[u + 1] && *basic_units[u + 1] != '=' &&
+                compare(basic_units[u], name, len) == 0)
+                return basic_units[u + 1];
+        return nullptr;
+    }
+
+    uint lo = 0, hi = nbuiltins;
+    while (lo < hi)
+    {
+        uint mid = (lo + hi) / 2;
+        if (compare(basic_units[builtins[mid]], name, len) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < nbuiltins && compare(basic_units[builtins[lo]], name, len) == 0)
+        return basic_units[builtins[lo] + 1];
+    return nullptr;
+}
+
+
+unit_p unit_index::memo_lookup(symbol_r name, int *prefix, uint32_t &h)
+// ----------------------------------------------------------------------------
+//   Check if we recently looked up the same name with the same settings
+// ----------------------------------------------------------------------------
+{
+    validate();
+    h = Settings.hash();
+    if (!memos)
+        return nullptr;
+    size_t len = 0;
+    utf8   txt = name->value(&len);
+    memo  &m   = memos[fnv1a(h, txt, len) % ENTRIES];
+    if (!m.name || m.settings != h || !m.name->is_same_as(+name))
+        return nullptr;
+    if (prefix)
+        *prefix = m.prefix;
+    return m.result;
+}
+
+
+void unit_index::memo_store(symbol_r name, unit_r result, int prefix,
+                            uint32_t h)
+// ----------------------------------------------------------------------------
+//   Remember the result of a successful lookup
+// ----------------------------------------------------------------------------
+{
+    if (!result || rt.error())
+        return;
+    if (!memos)
+    {
+        // No operator new[] nor operator delete[] in embedded runtime
+        memos = (memo *) calloc(ENTRIES, sizeof(memo));
+        if (!memos)
+            return;
+        for (uint i = 0; i < ENTRIES; i++)
+            new(memos + i) memo;
+    }
+    size_t len = 0;
+    utf8   txt = name->value(&len);
+    memo  &m   = memos[fnv1a(h, txt, len) % ENTRIES];
+    m.name = name;
+    m.result = result;
+    m.prefix = prefix;
+    m.settings = h;
+}
+
+
+uint32_t unit_index::factor_key(algebraic_r from, algebraic_r to, uint32_t h)
+// ----------------------------------------------------------------------------
+//   Compute the hash key for a conversion between two unit expressions
+// ----------------------------------------------------------------------------
+{
+    h = fnv1a(h, +from, from->size());
+    h = fnv1a(h, +to, to->size());
+    return h;
+}
+
+
+algebraic_p unit_index::factor_lookup(algebraic_r from, algebraic_r to,
+                                      uint32_t &h)
+// ----------------------------------------------------------------------------
+//   Return a remembered conversion factor between two unit expressions
+// ----------------------------------------------------------------------------
+{
+    validate();
+    h = Settings.hash();
+    if (!factors)
+        return nullptr;
+    factor &f = factors[factor_key(from, to, h) % ENTRIES];
+    if (!f.scale || f.settings != h)
+        return nullptr;
+    if (!f.from->is_same_as(+from) || !f.to->is_same_as(+to))
+        return nullptr;
+    record(units, "Cached conversion %t to %t = %t", +from, +to, +f.scale);
+    return f.scale;
+}
+
+
+void unit_index::factor_store(algebraic_r from, algebraic_r to,
+                              algebraic_r scale, uint32_t h)
+// ----------------------------------------------------------------------------
+//   Remember the conversion factor between two unit expressions
+// ----------------------------------------------------------------------------
+{
+    if (!scale || rt.error())
+        return;
+    if (!factors)
+    {
+        // No operator new[] nor operator delete[] in embedded runtime
+        factors = (factor *) calloc(ENTRIES, sizeof(factor));
+        if (!factors)
+            return;
+        for (uint i = 0; i < ENTRIES; i++)
+            new(factors + i) factor;
+    }
+    factor &f = factors[factor_key(from, to, h) % ENTRIES];
+    f.from = from;
+    f.to = to;
+    f.scale = scale;
+    f.settings = h;
+}
+
+
+bool unit_index::flush()
+// ----------------------------------------------------------------------------
+//   Forget the file index and remembered lookups and conversions
+// ----------------------------------------------------------------------------
+{
+    bool freed = false;
+    if (memos)
+    {
+        for (uint i = 0; i < ENTRIES; i++)
+        {
+            freed = freed || memos[i].name;
+            memos[i].name = nullptr;
+            memos[i].result = nullptr;
+        }
+    }
+    if (factors)
+    {
+        for (uint i = 0; i < ENTRIES; i++)
+        {
+            freed = freed || factors[i].scale;
+            factors[i].from = nullptr;
+            factors[i].to = nullptr;
+            factors[i].scale = nullptr;
+        }
+    }
+    built = false;
+    failed = false;
+    return freed;
+}
+
+
+bool unit::lookup_flush()
+// ----------------------------------------------------------------------------
+//   Forget indexed units, e.g. when memory is reset
+// ----------------------------------------------------------------------------
+{
+    return unit_index::flush();
+}
+
+
 unit_p unit::lookup(symbol_p namep, int *prefix_info)
 // ----------------------------------------------------------------------------
 //   Lookup a built-in unit
@@ -870,9 +1388,12 @@ unit_p unit::lookup(symbol_p namep, int *prefix_info)
     size_t    len  = 0;
     gcutf8    gtxt = namep->value(&len);
     uint      maxs = sizeof(si_prefixes) / sizeof(si_prefixes[0]);
-    unit_file ufile;
+    uint32_t  shash = 0;
 
     record(units, "Lookup %t", name);
+    if (unit_p u = unit_index::memo_lookup(name, prefix_info, shash))
+        return u;
+
     for (uint si = 0; si < maxs; si++)
     {
         utf8    ntxt   = gtxt;
@@ -882,58 +1403,37 @@ unit_p unit::lookup(symbol_p namep, int *prefix_info)
             continue;
 
         int    e       = si_prefixes[si].exponent;
-        size_t maxu    = sizeof(basic_units) / sizeof(basic_units[0]);
         size_t maxkibi = 1 + (e > 0 && e % 3 == 0 &&
                               ntxt[plen] == 'i' && len > plen+1);
         for (uint kibi = 0; kibi < maxkibi; kibi++)
         {
             size_t  rlen = len - plen - kibi;
             gcutf8  txt  = +gtxt + plen + kibi;
-            cstring utxt = nullptr;
-            cstring udef = nullptr;
+            gcutf8  udef = nullptr;
             size_t  ulen = 0;
 
-            // Check in-file units
-            if (ufile.valid())
+            // Check in-file units first, then built-in units
+            if (symbol_p def = unit_index::file_lookup(txt, rlen))
             {
-                bool first = true;
-                while (symbol_p def = ufile.lookup(txt, rlen, false, first))
-                {
-                    first = false;
-                    utf8 fdef = def->value(&ulen);
-
-                    // If definition begins with '=', only show unit in menus
-                    if (*fdef != '=')
-                    {
-                        udef = cstring(fdef);
-                        utxt = cstring(+txt);
-                        break;
-                    }
-                }
+                udef = def->value(&ulen);
             }
-
-            // Check built-in units
-            for (size_t u = 0; !udef && u < maxu; u += 2)
+            else if (cstring bdef = unit_index::builtin_lookup(txt, rlen))
             {
-                utxt = basic_units[u];
-                if (memcmp(utxt, +txt, rlen) == 0 && utxt[rlen] == 0)
-                {
-                    udef = basic_units[u + 1];
-                    if (udef)
-                        ulen  = strlen(udef);
-                }
+                udef = utf8(bdef);
+                ulen = strlen(bdef);
             }
 
-            // If we found a definition, use that unless it begins with '='
+            // If we found a definition, use that
             if (udef)
             {
-                if (object_p obj = object::parse(utf8(udef), ulen))
+                if (object_p obj = object::parse(udef, ulen))
                 {
                     if (unit_g u = unit::get(obj))
                     {
                         // Record prefix info if we need it
+                        int pinfo = kibi ? -si : si;
                         if (prefix_info)
-                            *prefix_info = kibi ? -si : si;
+                            *prefix_info = pinfo;
 
                         // Apply multipliers
                         if (e)
@@ -962,13 +1462,14 @@ unit_p unit::lookup(symbol_p namep, int *prefix_info)
                         {
                             size_t slen = 0;
                             utf8   stxt = sym->value(&slen);
-                            if (slen == rlen && memcmp(stxt, utxt, slen) == 0)
+                            if (slen == rlen && memcmp(stxt, +txt, slen) == 0)
+                            {
+                                unit_index::memo_store(name, u, pinfo, shash);
                                 return u;
+                            }
                         }
 
                         // Check if we must evaluate, e.g. 1_min -> seconds
-                        ufile.close();
-
                         settings::SaveAutoSimplify sas(false);
                         settings::SaveNumericalConstants snc(true);
                         save<symbol_g *> si(expression::independent, &name);
@@ -981,6 +1482,7 @@ unit_p unit::lookup(symbol_p namep, int *prefix_info)
                             return nullptr;
                         }
                         u = unit_p(+uexpr);
+                        unit_index::memo_store(name, u, pinfo, shash);
                         return u;
                     }
                 }
@@ -1041,6 +1543,26 @@ bool unit::convert(unit_g &x, bool error) const
 
     if (!unit::mode)
     {
+        // Check if we already know the factor between these units
+        bool     cache = !unit::factoring && !unit::nodates;
+        uint32_t shash = 0;
+        if (cache)
+        {
+            if (algebraic_g f = unit_index::factor_lookup(o, u, shash))
+            {
+                algebraic_g v = x->value();
+                {
+                    settings::SaveAutoSimplify sas(false);
+                    v = v * f;
+                }
+                if (!v)
+                    return false;
+                x = unit_p(unit::simple(v, svu));
+                return true;
+            }
+        }
+        algebraic_g from = o;
+
         save<bool> sumode(unit::mode, true);
 
         // Evaluate the unit expression for this one
@@ -1075,6 +1597,7 @@ bool unit::convert(unit_g &x, bool error) const
                     return false;
                 x = unit_p(unit::simple(o, ounit));
                 o = unit::simple(integer::make(1), ounit);
+                cache = false;
             }
         }
         // If the expression is in the destination
@@ -1117,6 +1640,7 @@ bool unit::convert(unit_g &x, bool error) const
                     udef = ue->evaluate();
                     x = unit_p(unit::simple(udef, +xname));
                     u = unit::simple(integer::make(1), +tname);
+                    cache = false;
                 }
             }
         }
@@ -1149,6 +1673,10 @@ bool unit::convert(unit_g &x, bool error) const
             return false;
         }
 
+        // Remember the factor for linear units, not e.g. for °C to K
+        if (cache)
+            unit_index::factor_store(from, svu, o, shash);
+
         algebraic_g v = x->value();
         {
             settings::SaveAutoSimplify sas(false);
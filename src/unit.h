@@ -59,6 +59,7 @@ struct unit : complex
     static algebraic_p parse_uexpr(gcutf8 source, size_t &len);
 
     static unit_p lookup(symbol_p name, int *prefix_index = nullptr);
+    static bool   lookup_flush();
 
     unit_p cycle() const;
     unit_p custom_cycle(symbol_r sym) const;
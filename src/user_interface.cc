@@ -40,6 +40,7 @@
 #include "functions.h"
 #include "graphics.h"
 #include "grob.h"
+#include "help_index.h"
 #include "list.h"
 #include "menu.h"
 #include "precedence.h"
@@ -154,6 +155,7 @@ user_interface::user_interface()
       batteryLow(false),
       keymap(),
       helpfile(),
+      helpLayout(),
       validate_input()
 {
     for (uint p = 0; p < NUM_PLANES; p++)
@@ -3060,6 +3062,63 @@ bool user_interface::transient_object(object_p obj)
 }
 
 
+static uint help_index_find(file &index, uint count, uint32_t hash,
+                            uint minlevel, uint *found, uint nfound, uint max)
+// ----------------------------------------------------------------------------
+//   Binary search the help index, add positions for the given hash
+// ----------------------------------------------------------------------------
+{
+    byte rec[HELP_INDEX_ENTRY];
+    uint lo = 0, hi = count;
+    while (lo < hi)
+    {
+        uint mid = (lo + hi) / 2;
+        index.seek(HELP_INDEX_HEADER + mid * HELP_INDEX_ENTRY);
+        if (!index.read((char *) rec, sizeof(rec)))
+            return nfound;
+        if (help_index_word(rec) < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    index.seek(HELP_INDEX_HEADER + lo * HELP_INDEX_ENTRY);
+    for (; lo < count && nfound < max; lo++)
+    {
+        if (!index.read((char *) rec, sizeof(rec)))
+            break;
+        if (help_index_word(rec) != hash)
+            break;
+        uint32_t position = help_index_word(rec + 4);
+        if ((position >> HELP_INDEX_LEVEL) >= minlevel)
+            found[nfound++] = position & HELP_INDEX_OFFSET;
+    }
+    return nfound;
+}
+
+
+static bool help_topic_matches(byte_p ref, size_t reflen, uint level,
+                               utf8 topic, size_t len, object::id cmd)
+// ----------------------------------------------------------------------------
+//   Check if a topic in the help file matches the one we look for
+// ----------------------------------------------------------------------------
+{
+    // For regular topics, just to a string comparison
+    // We match markdown hyperlink style, i.e. case independent
+    // and matching '-' in the topic to ' ' in the text
+    bool found = reflen == len;
+    for (uint i = 0; found && i < len; i++)
+        found = (tolower(ref[i]) == tolower(topic[i]) ||
+                 (ref[i] == ' ' && topic[i] == '-'));
+
+    // If we do not match a direct comparison, check all spellings
+    // We only do that for second and third level sections
+    if (!found && cmd && level >= 2)
+        found = command::lookup(ref, reflen) == cmd;
+    return found;
+}
+
+
 void user_interface::load_help(utf8 topic, size_t len)
 // ----------------------------------------------------------------------------
 //   Find the help message associated with the topic
@@ -3073,6 +3132,7 @@ void user_interface::load_help(utf8 topic, size_t len)
     follow    = false;
     dirtyHelp = true;
     dirtyMenu = true;
+    helpLayout.valid = false;
 
     if (!memcmp(topic, "http", 4))
     {
@@ -3091,7 +3151,7 @@ void user_interface::load_help(utf8 topic, size_t len)
     // alternate spellings as well
     size_t     cmdlen = len;
     object::id cmd = isvar ? object::id(0) : command::lookup(topic, cmdlen);
-    byte       ref[80];         // Length checked in the makefile
+    byte       ref[HELP_INDEX_TOPIC]; // Length checked by the index tool
     size_t     refidx   = 0;
     if (cmdlen != len)
         cmd = object::id(0);
@@ -3103,64 +3163,41 @@ void user_interface::load_help(utf8 topic, size_t len)
     bool       matching = false;
     uint       topicpos = 0;
     bool       found    = false;
-    uint       idxpos   = 0;
+    bool       indexed  = false;
+    uint       candidates[8];   // If full and no match, we scan the file
+    uint       ncandidates = 0;
+    const uint maxcandidates = sizeof(candidates) / sizeof(*candidates);
 
-    // Check if the index exists. If so, scan it
+    // Check if the index exists. If so, find candidate topics in it
     {
         file index(HELPINDEX_NAME, file::READING);
-        if (index.valid())
-        {
-            for (char c = index.getchar(); !found && c; c = index.getchar())
+        byte hdr[HELP_INDEX_HEADER];
+        if (index.valid() &&
+            index.read((char *) hdr, sizeof(hdr)) &&
+            help_index_word(hdr) == HELP_INDEX_MAGIC)
+        {
+            uint count = help_index_word(hdr + 4);
+            uint hash  = help_index_hash(topic, len);
+            indexed = true;
+            ncandidates = help_index_find(index, count, hash, 0,
+                                          candidates, 0, maxcandidates);
+
+            // Check alternate spellings for second and third level sections
+            if (cmd)
             {
-                if (c == '\n')
+                for (size_t i = 0; i < object::spelling_count; i++)
                 {
-                    uint filepos = atoi(cstring(ref));
-                    byte_p p = ref;
-                    byte_p end = ref + refidx;
-                    while (p < end && *p++ != ':')
-                        /* nop */;
-
-                    level = 0;
-                    while (p < end && *p++ == '#')
-                        level++;
-                    while (p < end && *p == ' ')
-                        p++;
-
-                    refidx = refidx - (p - ref);
-
-                    // For regular topics, just to a string comparison
-                    // We match markdown hyperlink style, i.e. case independent
-                    // and matching '-' in the topic to ' ' in the text
-                    found = refidx == len;
-                    for (uint i = 0; found && i < len; i++)
-                        found = (tolower(p[i]) == tolower(topic[i]) ||
-                                 (p[i] == ' ' && topic[i] == '-'));
-
-                    // If we do not match a direct comparison, check spellings
-                    // We only do that for second and third level sections
-                    if (!found && cmd && level >= 2)
-                        found = command::lookup(p, refidx) == cmd;
-
-                    if (found)
+                    if (object::spellings[i].type != cmd)
+                        continue;
+                    if (cstring name = object::spellings[i].name)
                     {
-                        idxpos = filepos;
-                        break;
+                        hash = help_index_hash(utf8(name), strlen(name));
+                        ncandidates = help_index_find(index, count, hash, 2,
+                                                      candidates, ncandidates,
+                                                      maxcandidates);
                     }
-                    refidx = 0;
-                }
-                else
-                {
-                    ref[refidx++] = c;
                 }
             }
-
-            // Not found in index, quit
-            if (!found)
-                goto notfound;
-            if (!isvar)
-                found = false;
-            else if (found)
-                topicpos = idxpos;
         }
     }
 
@@ -3177,54 +3214,91 @@ void user_interface::load_help(utf8 topic, size_t len)
         }
     }
 
-    helpfile.seek(idxpos);
-    for (char c = helpfile.getchar(); !found && c; c = helpfile.getchar())
+    // With an index, check the candidate topics in the help file
+    if (indexed)
     {
-        // Reset topic after newline
-        if (hadcr)
+        for (uint c = 0; !found && c < ncandidates; c++)
         {
-            if (c == '#')
-                topicpos = helpfile.position() - 1;
+            topicpos = candidates[c];
+            helpfile.seek(topicpos);
             refidx = level = 0;
-            matching = false;
+            char ch = helpfile.getchar();
+            if (ch == '#')
+            {
+                while (ch == '#')
+                {
+                    level++;
+                    ch = helpfile.getchar();
+                }
+                ch = helpfile.getchar();
+                while (ch == ' ')
+                    ch = helpfile.getchar();
+                while (ch && ch != '\n' && refidx < sizeof(ref) - 1)
+                {
+                    ref[refidx++] = ch;
+                    ch = helpfile.getchar();
+                }
+            }
+            else if (ch == '*')
+            {
+                ch = helpfile.getchar();
+                while (ch == ' ')
+                    ch = helpfile.getchar();
+                while (ch && ch != '\n' && refidx < sizeof(ref) - 1)
+                {
+                    ref[refidx++] = ch;
+                    if (ch == '`' && refidx > 1)
+                        break;
+                    ch = helpfile.getchar();
+                }
+            }
+            found = help_topic_matches(ref, refidx, level, topic, len, cmd);
         }
+    }
 
-        // Check if we start a line with # or ##, deduce topic level
-        if (c == '#' && (hadcr || !refidx))
-        {
-            level += c == '#';
-            matching = true;
-            refidx = 0;
-        }
-        else if (matching)
+    // Without an index, or if some candidates did not fit, scan the file
+    if (!found && (!indexed || ncandidates >= maxcandidates))
+    {
+        hadcr = true;
+        matching = false;
+        helpfile.seek(0);
+        for (char c = helpfile.getchar(); !found && c; c = helpfile.getchar())
         {
-            if (c != '\n')
+            // Reset topic after newline
+            if (hadcr)
             {
-                // Accumulate comparison topic
-                if (refidx < sizeof(ref) - 1)
-                    if (refidx || c != ' ')
-                        ref[refidx++] = c;
+                if (c == '#')
+                    topicpos = helpfile.position() - 1;
+                refidx = level = 0;
+                matching = false;
             }
-            else
+
+            // Check if we start a line with # or ##, deduce topic level
+            if (c == '#' && (hadcr || !refidx))
+            {
+                level += c == '#';
+                matching = true;
+                refidx = 0;
+            }
+            else if (matching)
             {
-                ref[refidx] = 0;
-                record(help_search, "Checking %u: %s", level, ref);
-
-                // For regular topics, just to a string comparison
-                // We match markdown hyperlink style, i.e. case independent
-                // and matching '-' in the topic to ' ' in the text
-                found = refidx == len;
-                for (uint i = 0; found && i < len; i++)
-                    found = (tolower(ref[i]) == tolower(topic[i]) ||
-                             (ref[i] == ' ' && topic[i] == '-'));
-
-                // If we do not match a direct comparison, check all spellings
-                // We only do that for second and third level sections
-                if (!found && cmd && level >= 2)
-                    found = command::lookup(ref, refidx) == cmd;
+                if (c != '\n')
+                {
+                    // Accumulate comparison topic
+                    if (refidx < sizeof(ref) - 1)
+                        if (refidx || c != ' ')
+                            ref[refidx++] = c;
+                }
+                else
+                {
+                    ref[refidx] = 0;
+                    record(help_search, "Checking %u: %s", level, ref);
+                    found = help_topic_matches(ref, refidx, level,
+                                               topic, len, cmd);
+                }
             }
+            hadcr = c == '\n';
         }
-        hadcr = c == '\n';
     }
 
     // Check if we found the topic
@@ -3250,7 +3324,6 @@ void user_interface::load_help(utf8 topic, size_t len)
     }
     else
     {
-    notfound:
         static char buffer[50];
         snprintf(buffer, sizeof(buffer), "No help for %.*s", int(len), topic);
         rt.command(object::static_object(object::ID_Help));
@@ -3374,6 +3447,29 @@ restart:
     // Pun not indented
     helpfile.seek(help);
 
+    // Resume from the layout recorded above the visible area if possible
+    coord       above = ytop - LCD_H;
+    help_layout mark  = helpLayout;
+    if (mark.valid && mark.help == help && mark.top == ytop)
+    {
+        coord my = mark.y + coord(mark.line) - coord(line);
+        if (my < above)
+        {
+            helpfile.seek(mark.position);
+            x         = mark.x;
+            y         = my;
+            xleft     = mark.xleft;
+            font      = mark.font;
+            height    = mark.height;
+            last      = mark.last;
+            lastTopic = mark.lastTopic;
+            codeStart = mark.codeStart;
+            style     = style_name(mark.style);
+            hadTitle  = mark.hadTitle;
+        }
+    }
+    mark.valid = false;
+
     // Display until end of help
     while (y < ybot)
     {
@@ -3385,6 +3481,23 @@ restart:
         bool       blue    = false;
         style_name restyle = style;
 
+        // Remember the last word that starts well above the visible area
+        if (y < above)
+        {
+            mark.position  = helpfile.position();
+            mark.x         = x;
+            mark.y         = y;
+            mark.xleft     = xleft;
+            mark.font      = font;
+            mark.height    = height;
+            mark.last      = last;
+            mark.lastTopic = lastTopic;
+            mark.codeStart = codeStart;
+            mark.style     = style;
+            mark.hadTitle  = hadTitle;
+            mark.valid     = true;
+        }
+
         if (!shown)
         {
             if (y >= ytop)
@@ -3985,6 +4098,12 @@ restart:
     if (helpfile.position() < topic)
         topic = lastTopic;
 
+    // Record where to resume layout for the next redraw, e.g. to scroll
+    mark.help  = help;
+    mark.line  = line;
+    mark.top   = ytop;
+    helpLayout = mark;
+
     Screen.clip(clip);
 
     if (follow && codeStart)
@@ -339,6 +339,27 @@ protected:
     uint16_t menuMarker[NUM_PLANES][NUM_SOFTKEYS];
     bool     menuMarkerAlign[NUM_PLANES][NUM_SOFTKEYS];
     file     helpfile;
+
+    struct help_layout
+    // ------------------------------------------------------------------------
+    //   Layout state at the start of a word above the visible help
+    // ------------------------------------------------------------------------
+    {
+        uint    help;           // Help topic being displayed
+        uint    line;           // Scroll offset when recorded
+        coord   top;            // Top of the help area
+        uint    position;       // Position of the word in the help file
+        coord   x, y;           // Position of the word on screen
+        coord   xleft;          // Left margin, e.g. for bullet lists
+        font_p  font;           // Font of the previous word
+        coord   height;         // Height of the previous word
+        unicode last;           // Last character read
+        uint    lastTopic;      // Last topic seen
+        uint    codeStart;      // Start of RPL code
+        byte    style;          // Current style
+        bool    hadTitle;       // Just had a title
+        bool    valid;          // Layout state was recorded
+    }        helpLayout;        // Resume the help layout from here
     bool     (*validate_input)(gcutf8 &src, size_t len);
     friend struct tests;
     friend struct runtime;
@@ -38,7 +38,9 @@
 #include "list.h"
 #include "locals.h"
 #include "parser.h"
+#include "plot.h"
 #include "renderer.h"
+#include "solve.h"
 #include "tag.h"
 
 RECORDER(directory,       16, "Directories");
@@ -207,8 +209,17 @@ object_p directory::store(object_g name, object_g value)
     if (object_p quoted = name->as_quoted(ID_object))
         name = quoted;
 
+    // Memoized symbolic results may depend on the previous value
+    expression::memo_forget(+name);
+    solver_cache_forget(+name);
+
     // Deal with all special cases
     id nty = name->type();
+
+    // Plot samples may depend on the previous value, but not on plot range
+    if (nty != ID_PlotParameters)
+        plot_cache_flush();
+
     switch (nty)
     {
     case ID_local:
@@ -277,6 +288,7 @@ object_p directory::store(object_g name, object_g value)
             rt.move_globals((object_p) evalue + vs, (object_p) evalue + es);
 
         // Copy new value into storage location
+        rt.uncache(evalue, es);
         memmove((byte *) evalue, (byte *) value, vs);
         value = evalue;
 
@@ -540,6 +552,9 @@ size_t directory::purge(object_p name)
 // ----------------------------------------------------------------------------
 {
     directory_g thisdir = this;
+    expression::memo_forget(name);
+    solver_cache_forget(name);
+    plot_cache_flush();
 
     // Deal with all special cases
     id nty = name->type();
@@ -802,6 +817,31 @@ COMMAND_BODY(Rcl)
 }
 
 
+COMMAND_BODY(RecallColumns)
+// ----------------------------------------------------------------------------
+//   Recall selected columns from a CSV file
+// ----------------------------------------------------------------------------
+{
+    object_p columns = rt.stack(0);
+    object_p name    = rt.stack(1);
+    if (!columns || !name)
+        return ERROR;
+    if (object_p quoted = name->as_quoted(ID_object))
+        name = quoted;
+    if (name->type() != ID_text)
+    {
+        rt.type_error();
+        return ERROR;
+    }
+
+    files_g disk = files::make("data");
+    if (list_p value = disk->recall_list(text_p(name), true, columns))
+        if (rt.drop() && rt.top(value))
+            return OK;
+    return ERROR;
+}
+
+
 
 COMMAND_BODY(Copy)
 // ----------------------------------------------------------------------------
@@ -188,6 +188,7 @@ private:
 
 COMMAND_DECLARE(Sto, 2);
 COMMAND_DECLARE(Rcl, 1);
+COMMAND_DECLARE(RecallColumns, 2);
 COMMAND_DECLARE(StoreAdd, 2);
 COMMAND_DECLARE(StoreSub, 2);
 COMMAND_DECLARE(StoreMul, 2);
@@ -0,0 +1,202 @@
+// ****************************************************************************
+//  helpindex.cpp                                                 DB48X project
+// ****************************************************************************
+//
+//   File Description:
+//
+//     Generate the binary index for the on-line help file
+//
+//     The index lists the headings (lines beginning with '#') and the
+//     solver variables (lines beginning with "* `name`") in the help file.
+//     Each entry records the hash of the topic and its offset in the file,
+//     and entries are sorted by hash so that the calculator can find a
+//     topic with a binary search. Sections are also indexed by their first
+//     word, which is how the calculator matches alternate command names.
+//     See src/help_index.h for the format.
+//
+//
+// ****************************************************************************
+//   (C) 2024 Christophe de Dinechin <christophe@dinechin.org>
+//   This software is licensed under the terms outlined in LICENSE.txt
+// ****************************************************************************
+//   This file is part of DB48X.
+//
+//   DB48X is free software: you can redistribute it and/or modify
+//   it under the terms outlined in the LICENSE.txt file
+//
+//   DB48X is distributed in the hope that it will be useful,
+//   but WITHOUT ANY WARRANTY; without even the implied warranty of
+//   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+// ****************************************************************************
+
+#include "help_index.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+typedef const char *cstring;
+typedef unsigned char byte;
+typedef unsigned uint;
+
+
+struct entry
+// ----------------------------------------------------------------------------
+//   An entry in the help index
+// ----------------------------------------------------------------------------
+{
+    uint32_t hash;
+    uint32_t position;
+
+    bool operator<(const entry &o) const
+    {
+        return hash < o.hash || (hash == o.hash && position < o.position);
+    }
+};
+
+
+static bool topic(const std::string &line, uint &level, std::string &name)
+// ----------------------------------------------------------------------------
+//   Extract the topic from a line of the help file, if there is one
+// ----------------------------------------------------------------------------
+//   This follows what the calculator does when it reads a heading:
+//   count the '#', skip the following character and any spaces, and
+//   keep the rest of the line. For "* `name`", keep "`name`".
+{
+    size_t p = 0;
+    size_t end = line.size();
+    level = 0;
+    if (line[0] == '#')
+    {
+        while (p < end && line[p++] == '#')
+            level++;
+    }
+    else if (line.compare(0, 3, "* `") == 0)
+    {
+        size_t close = line.find('`', 3);
+        if (close == std::string::npos)
+            return false;
+        p = 2;
+        end = close + 1;
+    }
+    else
+    {
+        return false;
+    }
+    while (p < end && line[p] == ' ')
+        p++;
+    name = line.substr(p, end - p);
+    return true;
+}
+
+
+static void put(FILE *out, uint32_t word)
+// ----------------------------------------------------------------------------
+//   Write a little-endian 32-bit word
+// ----------------------------------------------------------------------------
+{
+    for (uint i = 0; i < 4; i++)
+        fputc((word >> (8 * i)) & 0xFF, out);
+}
+
+
+int main(int argc, char *argv[])
+// ----------------------------------------------------------------------------
+//   Run the tool
+// ----------------------------------------------------------------------------
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <help.md> <help.idx>\n", argv[0]);
+        exit(1);
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (!in)
+    {
+        perror(argv[1]);
+        exit(1);
+    }
+
+    std::vector<entry> entries;
+    std::string        line;
+    std::string        name;
+    uint               offset = 0;
+    uint               start  = 0;
+    uint               level  = 0;
+    int                errors = 0;
+    int                c;
+
+    do
+    {
+        c = fgetc(in);
+        if (c == '\n' || c == EOF)
+        {
+            if (line.size() && topic(line, level, name))
+            {
+                if (name.size() >= HELP_INDEX_TOPIC)
+                {
+                    fprintf(stderr, "%s: Topic too long at offset %u: %s\n",
+                            argv[1], start, name.c_str());
+                    errors++;
+                }
+                if (start > HELP_INDEX_OFFSET || level > 15)
+                {
+                    fprintf(stderr, "%s: Cannot index offset %u level %u\n",
+                            argv[1], start, level);
+                    errors++;
+                }
+                entry e;
+                e.hash = help_index_hash((const uint8_t *) name.data(),
+                                         name.size());
+                e.position = start | (level << HELP_INDEX_LEVEL);
+                entries.push_back(e);
+
+                // Sections like "RecallΣ (RCLΣ)" also match the command
+                size_t word = name.find_first_of(" ,(");
+                if (level >= 2 && word != std::string::npos && word > 0)
+                {
+                    e.hash = help_index_hash((const uint8_t *) name.data(),
+                                             word);
+                    entries.push_back(e);
+                }
+            }
+            line.clear();
+            start = offset + 1;
+        }
+        else
+        {
+            line += char(c);
+        }
+        offset++;
+    } while (c != EOF);
+    fclose(in);
+
+    if (errors)
+        exit(1);
+
+    std::sort(entries.begin(), entries.end());
+
+    FILE *out = fopen(argv[2], "wb");
+    if (!out)
+    {
+        perror(argv[2]);
+        exit(1);
+    }
+    put(out, HELP_INDEX_MAGIC);
+    put(out, entries.size());
+    for (auto &e : entries)
+    {
+        put(out, e.hash);
+        put(out, e.position);
+    }
+    if (fclose(out))
+    {
+        perror(argv[2]);
+        exit(1);
+    }
+    return 0;
+}